@@ -1,4 +1,553 @@
 #include "Bytecode.hpp"
+#include <mutex>
+#include <map>
+#include <deque>
+#include <tuple>
+
+std::atomic<int> shared_heap_threads{0};
+
+#ifdef DEBUG_COUNT_COPIES
+long long value_copies = 0;
+long long ref_retains = 0;
+#endif
+
+void begin_shared_heap()
+{
+    shared_heap_threads.fetch_add(1, std::memory_order_acq_rel);
+}
+
+// Every reference count change the thread made happens before the
+// release here, so the main thread can go back to plain updates
+void end_shared_heap()
+{
+    shared_heap_threads.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+// Hook sets are immutable while any value carries their index, so values
+// share them by index and identical live sets map to the same index. Each
+// entry counts the values carrying it and goes back on a free list with
+// the last of them, which lets go of the hook functions and whatever they
+// capture. The table is only locked while other threads share the heap.
+struct HooksEntry
+{
+    ValueHooks hooks;
+    uint32_t refs = 0;
+};
+
+static std::mutex hooks_mutex;
+static std::deque<HooksEntry> hooks_table(1);
+static std::vector<uint32_t> free_hooks;
+static std::map<std::tuple<Value *, std::string, Value *, std::string>, uint32_t> hooks_index;
+
+static std::tuple<Value *, std::string, Value *, std::string> hooks_key(const ValueHooks &hooks)
+{
+    return std::make_tuple(hooks.onChangeHook.get(), hooks.onChangeHookName, hooks.onAccessHook.get(), hooks.onAccessHookName);
+}
+
+static std::unique_lock<std::mutex> lock_hooks()
+{
+    if (shared_heap_threads.load(std::memory_order_acquire))
+    {
+        return std::unique_lock<std::mutex>(hooks_mutex);
+    }
+    return std::unique_lock<std::mutex>();
+}
+
+uint32_t intern_hooks(const ValueHooks &hooks)
+{
+    if (!hooks.onChangeHook && !hooks.onAccessHook)
+    {
+        return 0;
+    }
+
+    auto key = hooks_key(hooks);
+
+    auto lock = lock_hooks();
+    auto it = hooks_index.find(key);
+    if (it != hooks_index.end())
+    {
+        hooks_table[it->second].refs++;
+        return it->second;
+    }
+
+    uint32_t hooks_id;
+    if (!free_hooks.empty())
+    {
+        hooks_id = free_hooks.back();
+        free_hooks.pop_back();
+    }
+    else
+    {
+        hooks_id = hooks_table.size();
+        hooks_table.emplace_back();
+    }
+    hooks_table[hooks_id].hooks = hooks;
+    hooks_table[hooks_id].refs = 1;
+    hooks_index[key] = hooks_id;
+    return hooks_id;
+}
+
+const ValueHooks &lookup_hooks(uint32_t hooks_id)
+{
+    auto lock = lock_hooks();
+    return hooks_table[hooks_id].hooks;
+}
+
+void retain_hooks(uint32_t hooks_id)
+{
+    auto lock = lock_hooks();
+    hooks_table[hooks_id].refs++;
+}
+
+void release_hooks(uint32_t hooks_id)
+{
+    // The hooks are freed after unlocking, as freeing them can release
+    // other hooked values
+    ValueHooks released;
+    {
+        auto lock = lock_hooks();
+        HooksEntry &entry = hooks_table[hooks_id];
+        if (--entry.refs)
+        {
+            return;
+        }
+        hooks_index.erase(hooks_key(entry.hooks));
+        released = std::move(entry.hooks);
+        entry.hooks = ValueHooks();
+        free_hooks.push_back(hooks_id);
+    }
+}
+
+// Global names get their slot the first time any chunk refers to them or
+// any VM defines them, so compiled code and every VM agree on the layout
+static std::mutex global_slots_mutex;
+static std::unordered_map<std::string, int> global_slots;
+static std::vector<std::string> global_slot_names;
+
+int global_slot(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(global_slots_mutex);
+    auto it = global_slots.find(name);
+    if (it != global_slots.end())
+    {
+        return it->second;
+    }
+
+    int slot = global_slot_names.size();
+    global_slot_names.push_back(name);
+    global_slots[name] = slot;
+    return slot;
+}
+
+int find_global_slot(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(global_slots_mutex);
+    auto it = global_slots.find(name);
+    return it == global_slots.end() ? -1 : it->second;
+}
+
+std::string global_slot_name(int slot)
+{
+    std::lock_guard<std::mutex> lock(global_slots_mutex);
+    if (slot < 0 || slot >= (int)global_slot_names.size())
+    {
+        return "";
+    }
+    return global_slot_names[slot];
+}
+
+static std::mutex shapes_mutex;
+
+Ref<Shape> empty_shape()
+{
+    static Ref<Shape> root = make_ref<Shape>();
+    return root;
+}
+
+static Ref<Shape> dictionary_with(Ref<Shape> &shape, const std::string &key)
+{
+    // A dictionary shape owned by this object alone can grow in place
+    if (shape->is_dictionary && shape->ref_count.load(std::memory_order_acquire) == 1)
+    {
+        shape->indexes[key] = shape->keys.size();
+        shape->keys.push_back(key);
+        return shape;
+    }
+    Ref<Shape> dictionary = make_ref<Shape>();
+    dictionary->is_dictionary = true;
+    dictionary->keys = shape->keys;
+    dictionary->indexes = shape->indexes;
+    dictionary->indexes[key] = dictionary->keys.size();
+    dictionary->keys.push_back(key);
+    return dictionary;
+}
+
+Ref<Shape> shape_with(Ref<Shape> &shape, const std::string &key)
+{
+    if (shape->is_dictionary || shape->keys.size() >= MAX_SHAPE_KEYS)
+    {
+        return dictionary_with(shape, key);
+    }
+
+    std::lock_guard<std::mutex> lock(shapes_mutex);
+    auto it = shape->transitions.find(key);
+    if (it != shape->transitions.end())
+    {
+        return it->second;
+    }
+
+    Ref<Shape> next = make_ref<Shape>();
+    next->keys = shape->keys;
+    next->indexes = shape->indexes;
+    next->indexes[key] = next->keys.size();
+    next->keys.push_back(key);
+    shape->transitions[key] = next;
+    return next;
+}
+
+Value &PropertyMap::operator[](const std::string &key)
+{
+    int slot = shape->find(key);
+    if (slot < 0)
+    {
+        shape = shape_with(shape, key);
+        slots.emplace_back();
+        slot = slots.size() - 1;
+    }
+    return slots[slot];
+}
+
+Value &PropertyMap::insert_computed(const std::string &key)
+{
+    int slot = shape->find(key);
+    if (slot < 0)
+    {
+        shape = dictionary_with(shape, key);
+        slots.emplace_back();
+        slot = slots.size() - 1;
+    }
+    return slots[slot];
+}
+
+void PropertyMap::erase(const std::string &key)
+{
+    int slot = shape->find(key);
+    if (slot < 0)
+    {
+        return;
+    }
+
+    Ref<Shape> dictionary = make_ref<Shape>();
+    dictionary->is_dictionary = true;
+    for (int i = 0; i < (int)shape->keys.size(); i++)
+    {
+        if (i != slot)
+        {
+            dictionary->indexes[shape->keys[i]] = dictionary->keys.size();
+            dictionary->keys.push_back(shape->keys[i]);
+        }
+    }
+    slots.erase(slots.begin() + slot);
+    shape = dictionary;
+}
+
+PropertyMap::Entry &PropertyMap::iterator::operator*()
+{
+    entry.emplace(Entry{map->shape->keys[index], map->slots[index]});
+    return *entry;
+}
+
+// Cycle collector. Every container is linked into one list, and a
+// collection finds the ones that are only referenced from each other by
+// trial deletion: each reference a tracked container holds to another is
+// subtracted from the target's count, so a container left with a positive
+// count is referenced from outside the heap (the stack, a frame, a global,
+// a native's locals) and survives along with everything it reaches. The
+// rest are garbage, and clearing them breaks their cycles so reference
+// counting frees them. Closures are shared through shared_ptr, so they
+// are counted the same way using their use count.
+static std::mutex collector_mutex;
+static Traced *tracked_head = nullptr;
+static CollectorStats stats;
+std::atomic<bool> collection_due{false};
+
+static const int GC_REACHABLE = -1;
+
+static void gc_untrack(Traced *object)
+{
+    std::lock_guard<std::mutex> lock(collector_mutex);
+    if (object->gc_prev)
+    {
+        object->gc_prev->gc_next = object->gc_next;
+    }
+    else
+    {
+        tracked_head = object->gc_next;
+    }
+    if (object->gc_next)
+    {
+        object->gc_next->gc_prev = object->gc_prev;
+    }
+    stats.tracked--;
+}
+
+void gc_track(Traced *object)
+{
+    std::lock_guard<std::mutex> lock(collector_mutex);
+    object->untrack = gc_untrack;
+    object->gc_next = tracked_head;
+    if (tracked_head)
+    {
+        tracked_head->gc_prev = object;
+    }
+    tracked_head = object;
+    stats.tracked++;
+    stats.allocated++;
+    if (stats.threshold > 0 && stats.allocated >= stats.threshold && stats.allocated >= stats.survivors * stats.growth)
+    {
+        collection_due.store(true, std::memory_order_relaxed);
+    }
+}
+
+// Containers native modules allocate are left to reference counting, so
+// references to them and from them count as coming from outside the heap
+static Traced *tracked(Traced *object)
+{
+    return object && object->untrack == gc_untrack ? object : nullptr;
+}
+
+static Traced *tracked(Value &value)
+{
+    switch (value.type)
+    {
+    case List:
+        return tracked(value.get_list().get());
+    case Type:
+        return tracked(value.get_type().get());
+    case Object:
+        return tracked(value.get_object().get());
+    case Function:
+        return tracked(value.get_function().get());
+    default:
+        return nullptr;
+    }
+}
+
+// Calls visit with every tracked container the object holds a reference
+// to, and visit_shared with each closure or bound object it shares,
+// its use count and the container that one holds
+template <typename Visit, typename VisitShared>
+static void for_each_reference(Traced *object, Visit visit, VisitShared visit_shared)
+{
+    switch (object->gc_kind)
+    {
+    case List:
+        for (Value &value : *static_cast<ListObj *>(object))
+        {
+            visit(tracked(value));
+        }
+        break;
+    case Type:
+    {
+        auto type = static_cast<TypeObj *>(object);
+        for (auto &entry : type->types)
+        {
+            visit(tracked(entry.second));
+        }
+        for (auto &entry : type->defaults)
+        {
+            visit(tracked(entry.second));
+        }
+        break;
+    }
+    case Object:
+    {
+        auto obj = static_cast<ObjectObj *>(object);
+        visit(tracked(obj->type.get()));
+        for (Value &value : obj->values.slots)
+        {
+            visit(tracked(value));
+        }
+        break;
+    }
+    case Function:
+    {
+        auto function = static_cast<FunctionObj *>(object);
+        for (Value &value : function->default_values)
+        {
+            visit(tracked(value));
+        }
+        for (auto &closure : function->closed_vars)
+        {
+            if (closure)
+            {
+                visit_shared(closure.get(), closure.use_count(), tracked(closure->closed));
+            }
+        }
+        if (function->coroutine)
+        {
+            for (Value &value : function->coroutine->slots)
+            {
+                visit(tracked(value));
+            }
+            visit(tracked(function->coroutine->delegate.get()));
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+// Drops every reference a garbage container holds
+static void clear_references(Traced *object)
+{
+    switch (object->gc_kind)
+    {
+    case List:
+        static_cast<ListObj *>(object)->clear();
+        break;
+    case Type:
+    {
+        auto type = static_cast<TypeObj *>(object);
+        type->types.clear();
+        type->defaults.clear();
+        break;
+    }
+    case Object:
+    {
+        auto obj = static_cast<ObjectObj *>(object);
+        obj->values = PropertyMap();
+        obj->keys.clear();
+        obj->type = nullptr;
+        break;
+    }
+    case Function:
+    {
+        auto function = static_cast<FunctionObj *>(object);
+        function->default_values.clear();
+        function->closed_vars.clear();
+        function->coroutine = nullptr;
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+int collect_cycles()
+{
+    collection_due.store(false, std::memory_order_relaxed);
+    if (shared_heap_threads.load(std::memory_order_acquire) > 0)
+    {
+        return 0;
+    }
+
+    std::vector<Value> garbage;
+    {
+        std::lock_guard<std::mutex> lock(collector_mutex);
+
+        for (Traced *object = tracked_head; object; object = object->gc_next)
+        {
+            object->gc_refs = object->ref_count.load(std::memory_order_relaxed);
+        }
+
+        // What is left of each shared closure or bound object's use count
+        // once the references from tracked containers are taken off
+        std::unordered_map<void *, std::pair<long, Traced *>> shared;
+
+        auto subtract = [](Traced *target)
+        {
+            if (target)
+            {
+                target->gc_refs--;
+            }
+        };
+        for (Traced *object = tracked_head; object; object = object->gc_next)
+        {
+            for_each_reference(object, subtract, [&](void *key, long use_count, Traced *target)
+                               {
+                auto entry = shared.emplace(key, std::make_pair(use_count, target));
+                if (entry.second)
+                {
+                    subtract(target);
+                }
+                entry.first->second.first--; });
+        }
+
+        std::vector<Traced *> work;
+        auto reach = [&](Traced *target)
+        {
+            if (target && target->gc_refs != GC_REACHABLE)
+            {
+                target->gc_refs = GC_REACHABLE;
+                work.push_back(target);
+            }
+        };
+        for (Traced *object = tracked_head; object; object = object->gc_next)
+        {
+            if (object->gc_refs > 0)
+            {
+                reach(object);
+            }
+        }
+        for (auto &entry : shared)
+        {
+            if (entry.second.first > 0)
+            {
+                reach(entry.second.second);
+            }
+        }
+        while (!work.empty())
+        {
+            Traced *object = work.back();
+            work.pop_back();
+            for_each_reference(object, reach, [&](void *, long, Traced *target)
+                               { reach(target); });
+        }
+
+        for (Traced *object = tracked_head; object; object = object->gc_next)
+        {
+            if (object->gc_refs != GC_REACHABLE)
+            {
+                Value value;
+                value.type = object->gc_kind;
+                value.as.object = object;
+                value.retain();
+                garbage.push_back(std::move(value));
+            }
+        }
+    }
+
+    // Holding every garbage container until all are cleared means none
+    // is freed while another still refers to it
+    for (Value &value : garbage)
+    {
+        clear_references(static_cast<Traced *>(value.as.object));
+    }
+    int collected = garbage.size();
+    garbage.clear();
+
+    std::lock_guard<std::mutex> lock(collector_mutex);
+    stats.collections++;
+    stats.collected += collected;
+    stats.allocated = 0;
+    stats.survivors = stats.tracked;
+    return collected;
+}
+
+CollectorStats collector_stats()
+{
+    std::lock_guard<std::mutex> lock(collector_mutex);
+    return stats;
+}
+
+void set_collector_threshold(int threshold, double growth)
+{
+    std::lock_guard<std::mutex> lock(collector_mutex);
+    stats.threshold = threshold;
+    stats.growth = growth;
+}
 
 uint8_t *int_to_bytes(int &integer)
 {
@@ -18,21 +567,41 @@ Value new_val()
 Value number_val(double value)
 {
     Value val(Number);
-    val.value = value;
+    val.as.number = value;
     return val;
 }
 
 Value string_val(std::string value)
 {
-    Value val(String);
-    val.value = value;
+    Value val;
+    val.type = String;
+    val.adopt(new StringObj(std::move(value)));
+    return val;
+}
+
+static std::mutex interned_strings_mutex;
+static std::unordered_map<std::string, Ref<StringObj>> interned_strings;
+
+Value interned_string_val(const std::string &value)
+{
+    std::lock_guard<std::mutex> lock(interned_strings_mutex);
+    Ref<StringObj> &string = interned_strings[value];
+    if (!string)
+    {
+        string = make_ref<StringObj>(value);
+        string->interned = true;
+    }
+    Value val;
+    val.type = String;
+    val.as.object = string.get();
+    val.retain();
     return val;
 }
 
 Value boolean_val(bool value)
 {
     Value val(Boolean);
-    val.value = value;
+    val.as.boolean = value;
     return val;
 }
 
@@ -61,6 +630,14 @@ Value function_val()
     return val;
 }
 
+Value function_val(Ref<FunctionProto> proto)
+{
+    Value val;
+    val.type = Function;
+    val.adopt(new FunctionObj(proto));
+    return val;
+}
+
 Value native_val()
 {
     Value val(Native);
@@ -79,6 +656,13 @@ Value none_val()
     return val;
 }
 
+Value range_val(int start, int end)
+{
+    Value val(Range);
+    val.as.bits = (uint64_t)(uint32_t)start | ((uint64_t)(uint32_t)end << 32);
+    return val;
+}
+
 std::string toString(Value value)
 {
     switch (value.type)
@@ -148,7 +732,7 @@ std::string toString(Value value)
     }
     case Function:
     {
-        return "Function: " + value.get_function()->name;
+        return "Function: " + value.get_function()->proto->name;
     }
     case Native:
     {
@@ -162,6 +746,10 @@ std::string toString(Value value)
     {
         return "None";
     }
+    case Range:
+    {
+        return std::to_string(value.range_start()) + ".." + std::to_string(value.range_end());
+    }
     default:
     {
         return "Undefined";
@@ -177,7 +765,86 @@ void printValue(Value value)
 void add_code(Chunk &chunk, uint8_t code, int line)
 {
     chunk.code.push_back(code);
-    chunk.lines.push_back(line);
+    if (chunk.lines.empty() || chunk.lines.back().line != line)
+    {
+        chunk.lines.push_back({(int)chunk.code.size() - 1, line});
+    }
+}
+
+int get_line(Chunk &chunk, int offset)
+{
+    int low = 0;
+    int high = chunk.lines.size() - 1;
+    int line = 0;
+
+    while (low <= high)
+    {
+        int mid = (low + high) / 2;
+        if (chunk.lines[mid].offset <= offset)
+        {
+            line = chunk.lines[mid].line;
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid - 1;
+        }
+    }
+
+    return line;
+}
+
+bool has_fixed_operand(uint8_t op)
+{
+    switch (op)
+    {
+    case OP_JUMP_IF_FALSE:
+    case OP_JUMP_IF_TRUE:
+    case OP_POP_JUMP_IF_FALSE:
+    case OP_POP_JUMP_IF_TRUE:
+    case OP_JUMP:
+    case OP_JUMP_BACK:
+        return true;
+    default:
+        return false;
+    }
+}
+
+int read_operand(Chunk &chunk, int offset, int &operand)
+{
+    uint8_t *code = chunk.code.data() + offset;
+    if (has_fixed_operand(code[-1]))
+    {
+        operand = bytes_to_int(code[0], code[1], code[2], code[3]);
+        return 4;
+    }
+    if (code[0] != OPERAND_WIDE)
+    {
+        operand = code[0];
+        return 1;
+    }
+    operand = bytes_to_int(code[1], code[2], code[3], code[4]);
+    return 5;
+}
+
+static void add_operand(Chunk &chunk, uint8_t op, int operand, int line)
+{
+    if (!has_fixed_operand(op) && operand >= 0 && operand < OPERAND_WIDE)
+    {
+        add_code(chunk, operand, line);
+        return;
+    }
+
+    if (!has_fixed_operand(op))
+    {
+        add_code(chunk, OPERAND_WIDE, line);
+    }
+
+    auto bytes = int_to_bytes(operand);
+    for (int i = 0; i < 4; i++)
+    {
+        add_code(chunk, bytes[i], line);
+    }
 }
 
 int add_constant(Chunk &chunk, Value value)
@@ -189,25 +856,21 @@ int add_constant(Chunk &chunk, Value value)
 void add_constant_code(Chunk &chunk, Value value, int line)
 {
     int constant = add_constant(chunk, value);
-    auto const_bytes = int_to_bytes(constant);
-
     add_code(chunk, OP_LOAD_CONST, line);
-    for (int i = 0; i < 4; i++)
-    {
-        add_code(chunk, const_bytes[i], line);
-    }
+    add_operand(chunk, OP_LOAD_CONST, constant, line);
+}
+
+int add_property_cache(Chunk &chunk, Value name)
+{
+    chunk.property_caches.push_back(PropertyCache(add_constant(chunk, name)));
+    return chunk.property_caches.size() - 1;
 }
 
 void add_bytes(Chunk &chunk, Value value, uint8_t op, int line)
 {
     int constant = add_constant(chunk, value);
-    auto const_bytes = int_to_bytes(constant);
-
     add_code(chunk, op, line);
-    for (int i = 0; i < 4; i++)
-    {
-        add_code(chunk, const_bytes[i], line);
-    }
+    add_operand(chunk, op, constant, line);
 }
 
 void patch_bytes(Chunk &chunk, int offset, uint8_t *bytes)
@@ -220,13 +883,8 @@ void patch_bytes(Chunk &chunk, int offset, uint8_t *bytes)
 
 void add_opcode(Chunk &chunk, uint8_t op, int operand, int line)
 {
-    auto bytes = int_to_bytes(operand);
-
     add_code(chunk, op, line);
-    for (int i = 0; i < 4; i++)
-    {
-        add_code(chunk, bytes[i], line);
-    }
+    add_operand(chunk, op, operand, line);
 }
 
 static int simple_instruction(std::string name, int offset)
@@ -237,35 +895,139 @@ static int simple_instruction(std::string name, int offset)
 
 static int constant_instruction(std::string name, Chunk &chunk, int offset)
 {
-    int constant = bytes_to_int(chunk.code[offset + 1], chunk.code[offset + 2], chunk.code[offset + 3], chunk.code[offset + 4]);
+    int constant;
+    int size = read_operand(chunk, offset + 1, constant);
     printf("%-16s %4d '", name.c_str(), constant);
     printValue(chunk.constants[constant]);
     printf("'\n");
-    return offset + 5;
+    return offset + 1 + size;
+}
+
+static int global_instruction(std::string name, Chunk &chunk, int offset)
+{
+    int slot;
+    int size = read_operand(chunk, offset + 1, slot);
+    printf("%-16s %4d '%s'\n", name.c_str(), slot, global_slot_name(slot).c_str());
+    return offset + 1 + size;
+}
+
+static int property_instruction(std::string name, Chunk &chunk, int offset)
+{
+    int cache;
+    int size = read_operand(chunk, offset + 1, cache);
+    printf("%-16s %4d '", name.c_str(), cache);
+    printValue(chunk.constants[chunk.property_caches[cache].name]);
+    printf("'\n");
+    return offset + 1 + size;
 }
 
 static int op_code_instruction(std::string name, Chunk &chunk, int offset)
 {
-    int operand = bytes_to_int(chunk.code[offset + 1], chunk.code[offset + 2], chunk.code[offset + 3], chunk.code[offset + 4]);
+    int operand;
+    int size = read_operand(chunk, offset + 1, operand);
     printf("%-16s %4d", name.c_str(), operand);
     printf("\n");
-    return offset + 5;
+    return offset + 1 + size;
+}
+
+// Superinstructions keep the bytes of the sequence they replace and only
+// overwrite its first opcode, so the VM can fall back to running the
+// original instructions one at a time
+struct Superinstruction
+{
+    const char *name;
+    uint8_t first;
+    int length;
+};
+
+static const Superinstruction superinstructions[] = {
+    {"OP_INCREMENT_LOCAL", OP_LOAD, 5},
+    {"OP_LOAD_LOAD", OP_LOAD, 2},
+    {"OP_SET_POP", OP_SET, 2},
+    {"OP_ADD_CONST", OP_LOAD_CONST, 2},
+    {"OP_SUBTRACT_CONST", OP_LOAD_CONST, 2},
+    {"OP_MULTIPLY_CONST", OP_LOAD_CONST, 2},
+    {"OP_LT_JUMP", OP_LT, 2},
+    {"OP_LT_EQ_JUMP", OP_LT_EQ, 2},
+    {"OP_GT_JUMP", OP_GT, 2},
+    {"OP_GT_EQ_JUMP", OP_GT_EQ, 2},
+    {"OP_LOAD_PROPERTY", OP_LOAD, 2},
+    {"OP_CALL_GLOBAL", OP_LOAD_GLOBAL, 2},
+};
+
+static_assert(sizeof(superinstructions) / sizeof(Superinstruction) == OP_COUNT - OP_INCREMENT_LOCAL,
+              "superinstructions must match the opcode enum");
+
+static int advance_instruction(Chunk &chunk, uint8_t instruction, int offset);
+
+static void superinstruction_operand(Chunk &chunk, uint8_t op, int offset)
+{
+    int operand;
+    read_operand(chunk, offset + 1, operand);
+    switch (op)
+    {
+    case OP_LOAD_CONST:
+        printf(" '");
+        printValue(chunk.constants[operand]);
+        printf("'");
+        break;
+    case OP_LOAD_GLOBAL:
+        printf(" '%s'", global_slot_name(operand).c_str());
+        break;
+    case OP_GET_PROPERTY:
+        printf(" '");
+        printValue(chunk.constants[chunk.property_caches[operand].name]);
+        printf("'");
+        break;
+    case OP_POP_JUMP_IF_FALSE:
+        printf(" if false -> %04d", offset + 5 + operand);
+        break;
+    case OP_POP_JUMP_IF_TRUE:
+        printf(" if true -> %04d", offset + 5 + operand);
+        break;
+    default:
+        printf(" %d", operand);
+    }
+}
+
+static int superinstruction(Chunk &chunk, int offset)
+{
+    const Superinstruction &super = superinstructions[chunk.code[offset] - OP_INCREMENT_LOCAL];
+    printf("%-16s", super.name);
+    for (int i = 0; i < super.length; i++)
+    {
+        uint8_t op = i == 0 ? super.first : chunk.code[offset];
+        int next = advance_instruction(chunk, op, offset);
+        if (next - offset > 1)
+        {
+            superinstruction_operand(chunk, op, offset);
+        }
+        offset = next;
+    }
+    printf("\n");
+    return offset;
 }
 
 int disassemble_instruction(Chunk &chunk, int offset)
 {
     printf("%04d ", offset);
 
-    if (offset > 0 && chunk.lines[offset] == chunk.lines[offset - 1])
+    int line = get_line(chunk, offset);
+    if (offset > 0 && line == get_line(chunk, offset - 1))
     {
         printf("   | ");
     }
     else
     {
-        printf("%4d ", chunk.lines[offset]);
+        printf("%4d ", line);
     }
 
     uint8_t instruction = chunk.code[offset];
+    if (instruction >= OP_INCREMENT_LOCAL && instruction < OP_COUNT)
+    {
+        return superinstruction(chunk, offset);
+    }
+
     switch (instruction)
     {
     case OP_EXIT:
@@ -278,18 +1040,26 @@ int disassemble_instruction(Chunk &chunk, int offset)
         return simple_instruction("OP_RETURN", offset);
     case OP_YIELD:
         return simple_instruction("OP_YIELD", offset);
-    case OP_TRY_BEGIN:
-        return op_code_instruction("OP_TRY_BEGIN", chunk, offset);
-    case OP_TRY_END:
-        return simple_instruction("OP_TRY_END", offset);
-    case OP_CATCH_BEGIN:
-        return simple_instruction("OP_CATCH_BEGIN", offset);
+    case OP_YIELD_FROM:
+        return simple_instruction("OP_YIELD_FROM", offset);
     case OP_LOAD_GLOBAL:
-        return op_code_instruction("OP_LOAD_GLOBAL", chunk, offset);
+        return global_instruction("OP_LOAD_GLOBAL", chunk, offset);
+    case OP_LOAD_GLOBAL_OPTIONAL:
+        return global_instruction("OP_LOAD_GLOBAL_OPTIONAL", chunk, offset);
+    case OP_GET_PROPERTY:
+        return property_instruction("OP_GET_PROPERTY", chunk, offset);
+    case OP_GET_METHOD:
+        return property_instruction("OP_GET_METHOD", chunk, offset);
+    case OP_SET_PROPERTY_NAMED:
+        return property_instruction("OP_SET_PROPERTY_NAMED", chunk, offset);
+    case OP_MAKE_SHAPED_OBJECT:
+        return property_instruction("OP_MAKE_SHAPED_OBJECT", chunk, offset);
+    case OP_GET_ITER:
+        return simple_instruction("OP_GET_ITER", offset);
+    case OP_FOR_ITER:
+        return op_code_instruction("OP_FOR_ITER", chunk, offset);
     case OP_LOAD_CONST:
         return constant_instruction("OP_LOAD_CONST", chunk, offset);
-    case OP_LOAD_THIS:
-        return simple_instruction("OP_LOAD_THIS", offset);
     case OP_STORE_VAR:
         return constant_instruction("OP_STORE_VAR", chunk, offset);
     case OP_LOAD:
@@ -340,22 +1110,20 @@ int disassemble_instruction(Chunk &chunk, int offset)
         return op_code_instruction("OP_JUMP", chunk, offset);
     case OP_JUMP_BACK:
         return op_code_instruction("OP_JUMP_BACK", chunk, offset);
-    case OP_LOOP:
-        return op_code_instruction("OP_LOOP", chunk, offset);
-    case OP_LOOP_END:
-        return simple_instruction("OP_LOOP_END", offset);
-    case OP_ITER:
-        return simple_instruction("OP_ITER", offset);
     case OP_BREAK:
-        return simple_instruction("OP_BREAK", offset);
+        return op_code_instruction("OP_BREAK", chunk, offset);
     case OP_CONTINUE:
-        return simple_instruction("OP_CONTINUE", offset);
+        return op_code_instruction("OP_CONTINUE", chunk, offset);
     case OP_BUILD_LIST:
         return op_code_instruction("OP_BUILD_LIST", chunk, offset);
     case OP_CALL:
         return op_code_instruction("OP_CALL", chunk, offset);
     case OP_CALL_METHOD:
         return op_code_instruction("OP_CALL_METHOD", chunk, offset);
+    case OP_TAIL_CALL:
+        return op_code_instruction("OP_TAIL_CALL", chunk, offset);
+    case OP_TAIL_CALL_METHOD:
+        return op_code_instruction("OP_TAIL_CALL_METHOD", chunk, offset);
     case OP_UNPACK:
         return simple_instruction("OP_UNPACK", offset);
     case OP_REMOVE_PUSH:
@@ -404,6 +1172,18 @@ int disassemble_instruction(Chunk &chunk, int offset)
         return op_code_instruction("OP_IMPORT", chunk, offset);
     case OP_LEN:
         return simple_instruction("OP_LEN", offset);
+    case OP_ADD_NUM_NUM:
+        return simple_instruction("OP_ADD_NUM_NUM", offset);
+    case OP_ADD_STR_STR:
+        return simple_instruction("OP_ADD_STR_STR", offset);
+    case OP_EQ_EQ_NUM_NUM:
+        return simple_instruction("OP_EQ_EQ_NUM_NUM", offset);
+    case OP_NOT_EQ_NUM_NUM:
+        return simple_instruction("OP_NOT_EQ_NUM_NUM", offset);
+    case OP_ACCESS_LIST_NUM:
+        return op_code_instruction("OP_ACCESS_LIST_NUM", chunk, offset);
+    case OP_ACCESS_RANGE_NUM:
+        return op_code_instruction("OP_ACCESS_RANGE_NUM", chunk, offset);
     default:
         printf("Unknown opcode %d\n", instruction);
         return offset + 1;
@@ -418,11 +1198,37 @@ void disassemble_chunk(Chunk &chunk, std::string name)
     {
         offset = disassemble_instruction(chunk, offset);
     }
+
+    for (ExceptionHandler &handler : chunk.handlers)
+    {
+        printf("try %04d-%04d -> %04d (depth %d%s)\n", handler.start, handler.end, handler.handler, handler.depth, handler.binds_error ? ", binds error" : "");
+    }
+}
+
+static int operand_size(Chunk &chunk, int offset)
+{
+    int operand;
+    return read_operand(chunk, offset, operand);
 }
 
 int advance(Chunk &chunk, int offset)
 {
     uint8_t instruction = chunk.code[offset];
+    if (instruction >= OP_INCREMENT_LOCAL && instruction < OP_COUNT)
+    {
+        const Superinstruction &super = superinstructions[instruction - OP_INCREMENT_LOCAL];
+        offset = advance_instruction(chunk, super.first, offset);
+        for (int i = 1; i < super.length; i++)
+        {
+            offset = advance_instruction(chunk, chunk.code[offset], offset);
+        }
+        return offset;
+    }
+    return advance_instruction(chunk, instruction, offset);
+}
+
+static int advance_instruction(Chunk &chunk, uint8_t instruction, int offset)
+{
     switch (instruction)
     {
     case OP_EXIT:
@@ -435,88 +1241,94 @@ int advance(Chunk &chunk, int offset)
         return offset + 1;
     case OP_YIELD:
         return offset + 1;
-    case OP_TRY_BEGIN:
-        return offset + 5;
-    case OP_TRY_END:
-        return offset + 1;
-    case OP_CATCH_BEGIN:
+    case OP_YIELD_FROM:
         return offset + 1;
     case OP_LOAD_GLOBAL:
-        return offset + 5;
-    case OP_LOAD_CONST:
-        return offset + 5;
-    case OP_LOAD_THIS:
+        return offset + 1 + operand_size(chunk, offset + 1);
+    case OP_LOAD_GLOBAL_OPTIONAL:
+        return offset + 1 + operand_size(chunk, offset + 1);
+    case OP_GET_PROPERTY:
+        return offset + 1 + operand_size(chunk, offset + 1);
+    case OP_GET_METHOD:
+        return offset + 1 + operand_size(chunk, offset + 1);
+    case OP_SET_PROPERTY_NAMED:
+        return offset + 1 + operand_size(chunk, offset + 1);
+    case OP_MAKE_SHAPED_OBJECT:
+        return offset + 1 + operand_size(chunk, offset + 1);
+    case OP_GET_ITER:
         return offset + 1;
+    case OP_FOR_ITER:
+        return offset + 1 + operand_size(chunk, offset + 1);
+    case OP_LOAD_CONST:
+        return offset + 1 + operand_size(chunk, offset + 1);
     case OP_STORE_VAR:
-        return offset + 5;
+        return offset + 1 + operand_size(chunk, offset + 1);
     case OP_LOAD:
-        return offset + 5;
+        return offset + 1 + operand_size(chunk, offset + 1);
     case OP_LOAD_CLOSURE:
-        return offset + 5;
+        return offset + 1 + operand_size(chunk, offset + 1);
     case OP_SET:
-        return offset + 5;
+        return offset + 1 + operand_size(chunk, offset + 1);
     case OP_SET_FORCE:
-        return offset + 5;
+        return offset + 1 + operand_size(chunk, offset + 1);
     case OP_SET_PROPERTY:
         return offset + 1;
     case OP_SET_CLOSURE:
-        return offset + 5;
+        return offset + 1 + operand_size(chunk, offset + 1);
     case OP_MAKE_CLOSURE:
-        return offset + 5;
+        return offset + 1 + operand_size(chunk, offset + 1);
     case OP_MAKE_TYPE:
-        return offset + 5;
+        return offset + 1 + operand_size(chunk, offset + 1);
     case OP_MAKE_TYPED:
         return offset + 1;
     case OP_MAKE_OBJECT:
-        return offset + 5;
+        return offset + 1 + operand_size(chunk, offset + 1);
     case OP_MAKE_FUNCTION:
-        return offset + 5;
+        return offset + 1 + operand_size(chunk, offset + 1);
     case OP_HOOK_ONCHANGE:
-        return offset + 5;
+        return offset + 1 + operand_size(chunk, offset + 1);
     case OP_HOOK_CLOSURE_ONCHANGE:
-        return offset + 5;
+        return offset + 1 + operand_size(chunk, offset + 1);
     case OP_HOOK_ONACCESS:
-        return offset + 5;
+        return offset + 1 + operand_size(chunk, offset + 1);
     case OP_HOOK_CLOSURE_ONACCESS:
-        return offset + 5;
+        return offset + 1 + operand_size(chunk, offset + 1);
     case OP_MAKE_CONST:
         return offset + 1;
     case OP_MAKE_NON_CONST:
         return offset + 1;
     case OP_TYPE_DEFAULTS:
-        return offset + 5;
+        return offset + 1 + operand_size(chunk, offset + 1);
     case OP_JUMP_IF_FALSE:
-        return offset + 5;
+        return offset + 1 + operand_size(chunk, offset + 1);
     case OP_JUMP_IF_TRUE:
-        return offset + 5;
+        return offset + 1 + operand_size(chunk, offset + 1);
     case OP_POP_JUMP_IF_FALSE:
-        return offset + 5;
+        return offset + 1 + operand_size(chunk, offset + 1);
     case OP_POP_JUMP_IF_TRUE:
-        return offset + 5;
+        return offset + 1 + operand_size(chunk, offset + 1);
     case OP_JUMP:
-        return offset + 5;
+        return offset + 1 + operand_size(chunk, offset + 1);
     case OP_JUMP_BACK:
-        return offset + 5;
-    case OP_LOOP:
-        return offset + 5;
-    case OP_LOOP_END:
-        return offset + 1;
-    case OP_ITER:
-        return offset + 1;
+        return offset + 1 + operand_size(chunk, offset + 1);
     case OP_BREAK:
-        return offset + 1;
+        return offset + 1 + operand_size(chunk, offset + 1);
     case OP_CONTINUE:
-        return offset + 1;
+        return offset + 1 + operand_size(chunk, offset + 1);
     case OP_BUILD_LIST:
-        return offset + 5;
+        return offset + 1 + operand_size(chunk, offset + 1);
     case OP_CALL:
-        return offset + 5;
+        return offset + 1 + operand_size(chunk, offset + 1);
     case OP_CALL_METHOD:
-        return offset + 5;
+        return offset + 1 + operand_size(chunk, offset + 1);
+    case OP_TAIL_CALL:
+        return offset + 1 + operand_size(chunk, offset + 1);
+    case OP_TAIL_CALL_METHOD:
+        return offset + 1 + operand_size(chunk, offset + 1);
     case OP_UNPACK:
         return offset + 1;
     case OP_REMOVE_PUSH:
-        return offset + 5;
+        return offset + 1 + operand_size(chunk, offset + 1);
     case OP_SWAP_TOS:
         return offset + 1;
     case OP_NEGATE:
@@ -556,11 +1368,23 @@ int advance(Chunk &chunk, int offset)
     case OP_DOT:
         return offset + 1;
     case OP_ACCESSOR:
-        return offset + 5;
+        return offset + 1 + operand_size(chunk, offset + 1);
     case OP_IMPORT:
-        return offset + 5;
+        return offset + 1 + operand_size(chunk, offset + 1);
     case OP_LEN:
         return offset + 1;
+    case OP_ADD_NUM_NUM:
+        return offset + 1;
+    case OP_ADD_STR_STR:
+        return offset + 1;
+    case OP_EQ_EQ_NUM_NUM:
+        return offset + 1;
+    case OP_NOT_EQ_NUM_NUM:
+        return offset + 1;
+    case OP_ACCESS_LIST_NUM:
+        return offset + 1 + operand_size(chunk, offset + 1);
+    case OP_ACCESS_RANGE_NUM:
+        return offset + 1 + operand_size(chunk, offset + 1);
     default:
         printf("Unknown opcode %d\n", instruction);
         return offset + 1;
@@ -578,4 +1402,334 @@ std::vector<int> instruction_offsets(Chunk &chunk)
     }
 
     return offsets;
-}
\ No newline at end of file
+}
+// Offset a jump instruction at `offset` lands on
+static int jump_target(Chunk &chunk, int offset)
+{
+    uint8_t *code = chunk.code.data() + offset;
+    int distance = bytes_to_int(code[1], code[2], code[3], code[4]);
+    return code[0] == OP_JUMP_BACK ? offset + 5 - distance : offset + 5 + distance;
+}
+
+// Offsets that control can arrive at other than by falling through, which
+// a fused sequence or a deleted instruction must not swallow
+static std::vector<bool> entry_points(Chunk &chunk, std::vector<int> &offsets)
+{
+    std::vector<bool> entries(chunk.code.size() + 1, false);
+    for (int i = 0; i < (int)offsets.size() - 1; i++)
+    {
+        if (has_fixed_operand(chunk.code[offsets[i]]))
+        {
+            entries[jump_target(chunk, offsets[i])] = true;
+        }
+    }
+    for (ExceptionHandler &handler : chunk.handlers)
+    {
+        entries[handler.start] = true;
+        entries[handler.end] = true;
+        entries[handler.handler] = true;
+    }
+    return entries;
+}
+
+// Only plain literals are shared; anything carrying hooks or const flags
+// keeps its own slot
+static bool constant_key(Value &value, std::string &key)
+{
+    if (value.hooks_id || value.meta.unpack || value.meta.packer || value.meta.is_const || value.meta.temp_non_const)
+    {
+        return false;
+    }
+    switch (value.type)
+    {
+    case Number:
+        key = "n" + std::string((char *)&value.as.number, sizeof(double));
+        return true;
+    case String:
+        key = "s" + value.get_string();
+        return true;
+    case Boolean:
+        key = value.as.boolean ? "t" : "f";
+        return true;
+    case None:
+        key = "z";
+        return true;
+    default:
+        return false;
+    }
+}
+
+static void merge_constants(Chunk &chunk)
+{
+    std::unordered_map<std::string, int> merged;
+    std::vector<int> remap(chunk.constants.size());
+    int kept = 0;
+
+    for (int i = 0; i < (int)chunk.constants.size(); i++)
+    {
+        std::string key;
+        if (constant_key(chunk.constants[i], key))
+        {
+            auto found = merged.find(key);
+            if (found != merged.end())
+            {
+                remap[i] = found->second;
+                continue;
+            }
+            merged[key] = kept;
+        }
+        remap[i] = kept;
+        if (kept != i)
+        {
+            chunk.constants[kept] = std::move(chunk.constants[i]);
+        }
+        kept++;
+    }
+
+    if (kept == (int)chunk.constants.size())
+    {
+        return;
+    }
+
+    chunk.constants.resize(kept);
+    for (PropertyCache &cache : chunk.property_caches)
+    {
+        cache.name = remap[cache.name];
+    }
+
+    // Indexes only shrink, so every operand keeps its encoded width
+    for (int offset = 0; offset < (int)chunk.code.size(); offset = advance(chunk, offset))
+    {
+        if (chunk.code[offset] != OP_LOAD_CONST)
+        {
+            continue;
+        }
+        int constant;
+        if (read_operand(chunk, offset + 1, constant) == 1)
+        {
+            chunk.code[offset + 1] = remap[constant];
+        }
+        else
+        {
+            int index = remap[constant];
+            patch_bytes(chunk, offset + 2, int_to_bytes(index));
+        }
+    }
+}
+
+static void remove_dead_code(Chunk &chunk)
+{
+    std::vector<int> offsets = instruction_offsets(chunk);
+    std::vector<bool> entries = entry_points(chunk, offsets);
+    std::vector<bool> dead(offsets.size(), false);
+    bool changed = false;
+
+    for (int i = 0; i < (int)offsets.size() - 1; i++)
+    {
+        uint8_t op = chunk.code[offsets[i]];
+        if (op == OP_JUMP && jump_target(chunk, offsets[i]) == offsets[i + 1])
+        {
+            dead[i] = changed = true;
+        }
+        else if (op == OP_LOAD_CONST && i + 2 < (int)offsets.size() && chunk.code[offsets[i + 1]] == OP_POP && !entries[offsets[i + 1]])
+        {
+            dead[i] = dead[i + 1] = changed = true;
+            i++;
+        }
+    }
+
+    if (!changed)
+    {
+        return;
+    }
+
+    // Every old byte offset maps to its new one; removed bytes map to
+    // whatever follows them
+    std::vector<int> moved(chunk.code.size() + 1);
+    std::vector<uint8_t> code;
+    for (int i = 0; i < (int)offsets.size() - 1; i++)
+    {
+        for (int offset = offsets[i]; offset < offsets[i + 1]; offset++)
+        {
+            moved[offset] = code.size();
+            if (!dead[i])
+            {
+                code.push_back(chunk.code[offset]);
+            }
+        }
+    }
+    moved[chunk.code.size()] = code.size();
+
+    for (int i = 0; i < (int)offsets.size() - 1; i++)
+    {
+        if (dead[i] || !has_fixed_operand(chunk.code[offsets[i]]))
+        {
+            continue;
+        }
+        int offset = moved[offsets[i]];
+        int target = moved[jump_target(chunk, offsets[i])];
+        int distance = chunk.code[offsets[i]] == OP_JUMP_BACK ? offset + 5 - target : target - (offset + 5);
+        uint8_t *bytes = int_to_bytes(distance);
+        for (int b = 0; b < 4; b++)
+        {
+            code[offset + 1 + b] = bytes[b];
+        }
+    }
+
+    for (ExceptionHandler &handler : chunk.handlers)
+    {
+        handler.start = moved[handler.start];
+        handler.end = moved[handler.end];
+        handler.handler = moved[handler.handler];
+    }
+
+    std::vector<LineStart> lines;
+    for (LineStart &start : chunk.lines)
+    {
+        int offset = moved[start.offset];
+        if (!lines.empty() && lines.back().offset == offset)
+        {
+            lines.pop_back();
+        }
+        if (lines.empty() || lines.back().line != start.line)
+        {
+            lines.push_back({offset, start.line});
+        }
+    }
+
+    chunk.code = std::move(code);
+    chunk.lines = std::move(lines);
+}
+
+static bool number_constant(Chunk &chunk, int offset)
+{
+    int constant;
+    read_operand(chunk, offset + 1, constant);
+    return chunk.constants[constant].is_number();
+}
+
+static int local_operand(Chunk &chunk, int offset)
+{
+    int slot;
+    read_operand(chunk, offset + 1, slot);
+    return slot;
+}
+
+static uint8_t compare_jump(uint8_t op)
+{
+    switch (op)
+    {
+    case OP_LT:
+        return OP_LT_JUMP;
+    case OP_LT_EQ:
+        return OP_LT_EQ_JUMP;
+    case OP_GT:
+        return OP_GT_JUMP;
+    default:
+        return OP_GT_EQ_JUMP;
+    }
+}
+
+// The fused set follows the most frequent opcode pairs measured over the
+// benchmark scripts
+static void fuse_instructions(Chunk &chunk)
+{
+    std::vector<int> offsets = instruction_offsets(chunk);
+    std::vector<bool> entries = entry_points(chunk, offsets);
+    int count = offsets.size() - 1;
+
+    for (int i = 0; i < count;)
+    {
+        auto op = [&](int k) -> uint8_t
+        { return i + k < count ? chunk.code[offsets[i + k]] : (uint8_t)OP_COUNT; };
+        // Only the first instruction of a sequence may be jumped to
+        auto joinable = [&](int length)
+        {
+            for (int k = 1; k < length; k++)
+            {
+                if (i + k >= count || entries[offsets[i + k]])
+                {
+                    return false;
+                }
+            }
+            return true;
+        };
+
+        uint8_t fused = 0;
+        int length = 2;
+        switch (op(0))
+        {
+        case OP_LOAD:
+            if (joinable(5) && op(1) == OP_LOAD_CONST && op(2) == OP_ADD && op(3) == OP_SET_FORCE && op(4) == OP_POP &&
+                number_constant(chunk, offsets[i + 1]) && local_operand(chunk, offsets[i]) == local_operand(chunk, offsets[i + 3]))
+            {
+                fused = OP_INCREMENT_LOCAL;
+                length = 5;
+            }
+            else if (joinable(2) && op(1) == OP_GET_PROPERTY)
+            {
+                fused = OP_LOAD_PROPERTY;
+            }
+            else if (joinable(2) && op(1) == OP_LOAD)
+            {
+                fused = OP_LOAD_LOAD;
+            }
+            break;
+        case OP_SET:
+            if (joinable(2) && op(1) == OP_POP)
+            {
+                fused = OP_SET_POP;
+            }
+            break;
+        case OP_LOAD_CONST:
+            if (joinable(2) && number_constant(chunk, offsets[i]))
+            {
+                if (op(1) == OP_ADD)
+                {
+                    fused = OP_ADD_CONST;
+                }
+                else if (op(1) == OP_SUBTRACT)
+                {
+                    fused = OP_SUBTRACT_CONST;
+                }
+                else if (op(1) == OP_MULTIPLY)
+                {
+                    fused = OP_MULTIPLY_CONST;
+                }
+            }
+            break;
+        case OP_LT:
+        case OP_LT_EQ:
+        case OP_GT:
+        case OP_GT_EQ:
+            if (joinable(2) && (op(1) == OP_POP_JUMP_IF_FALSE || op(1) == OP_POP_JUMP_IF_TRUE))
+            {
+                fused = compare_jump(op(0));
+            }
+            break;
+        case OP_LOAD_GLOBAL:
+            if (joinable(2) && op(1) == OP_CALL)
+            {
+                fused = OP_CALL_GLOBAL;
+            }
+            break;
+        }
+
+        if (fused)
+        {
+            chunk.code[offsets[i]] = fused;
+            i += length;
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+void optimize_chunk(Chunk &chunk)
+{
+    merge_constants(chunk);
+    remove_dead_code(chunk);
+    fuse_instructions(chunk);
+}
@@ -5,20 +5,37 @@
 #include <iomanip>
 #include <cmath>
 #include <string>
+#include <atomic>
+#include <optional>
 #include "../Node/Node.hpp"
 
 #define value_ptr std::shared_ptr<Value>
 
+// Counts Value copies and reference count retains per executed opcode,
+// printed when the program exits
+// #define DEBUG_COUNT_COPIES
+
+#ifdef DEBUG_COUNT_COPIES
+extern long long value_copies;
+extern long long ref_retains;
+#endif
+
 uint8_t *int_to_bytes(int &integer);
 
 int bytes_to_int(uint8_t a, uint8_t b, uint8_t c, uint8_t d);
 
+// Operands are a single byte when they fit in [0, 254]. Anything else
+// (large indexes, negative hook flags) is written as OPERAND_WIDE followed
+// by the full 4 byte int. Jumps, loops and try blocks always use the
+// 4 byte form since their operands are patched after emission.
+#define OPERAND_WIDE 0xFF
+
 enum OpCode
 {
     OP_RETURN,
     OP_YIELD,
+    OP_YIELD_FROM,
     OP_LOAD_CONST,
-    OP_LOAD_THIS,
     OP_NEGATE,
     OP_ADD,
     OP_SUBTRACT,
@@ -69,23 +86,49 @@ enum OpCode
     OP_LEN,
     OP_CALL,
     OP_CALL_METHOD,
+    OP_TAIL_CALL,
+    OP_TAIL_CALL_METHOD,
     OP_IMPORT,
     OP_UNPACK,
     OP_REMOVE_PUSH,
     OP_SWAP_TOS,
-    OP_LOOP,
-    OP_LOOP_END,
-    OP_ITER,
     OP_HOOK_ONCHANGE,
     OP_HOOK_CLOSURE_ONCHANGE,
     OP_HOOK_ONACCESS,
     OP_HOOK_CLOSURE_ONACCESS,
-    OP_TRY_BEGIN,
-    OP_TRY_END,
-    OP_CATCH_BEGIN
+    OP_LOAD_GLOBAL_OPTIONAL,
+    OP_GET_PROPERTY,
+    OP_GET_METHOD,
+    OP_SET_PROPERTY_NAMED,
+    OP_MAKE_SHAPED_OBJECT,
+    OP_GET_ITER,
+    OP_FOR_ITER,
+    // Quickened forms the VM rewrites a generic instruction to once it has
+    // seen its operand types
+    OP_ADD_NUM_NUM,
+    OP_ADD_STR_STR,
+    OP_EQ_EQ_NUM_NUM,
+    OP_NOT_EQ_NUM_NUM,
+    OP_ACCESS_LIST_NUM,
+    OP_ACCESS_RANGE_NUM,
+    // Superinstructions, written over the first opcode of a sequence by
+    // optimize_chunk
+    OP_INCREMENT_LOCAL,
+    OP_LOAD_LOAD,
+    OP_SET_POP,
+    OP_ADD_CONST,
+    OP_SUBTRACT_CONST,
+    OP_MULTIPLY_CONST,
+    OP_LT_JUMP,
+    OP_LT_EQ_JUMP,
+    OP_GT_JUMP,
+    OP_GT_EQ_JUMP,
+    OP_LOAD_PROPERTY,
+    OP_CALL_GLOBAL,
+    OP_COUNT
 };
 
-enum ValueType
+enum ValueType : uint8_t
 {
     Number,
     String,
@@ -96,7 +139,10 @@ enum ValueType
     Function,
     Native,
     Pointer,
-    None
+    None,
+    // The integers from start up to end, kept as the two bounds rather
+    // than a list
+    Range
 };
 
 struct Value;
@@ -104,14 +150,235 @@ struct Closure;
 
 std::string toString(Value value);
 
+// Threads running VM code besides the main one. Heap objects can only be
+// shared between threads while this is above zero, so until then
+// reference counts are updated with plain loads and stores.
+extern std::atomic<int> shared_heap_threads;
+
+// Marks the start and end of a thread that runs VM code alongside the
+// main one
+void begin_shared_heap();
+void end_shared_heap();
+
+// Heap objects carry their own reference count, so a Value only needs a
+// single pointer to them. Copying a RefCounted never copies the count.
+struct RefCounted
+{
+    std::atomic<int> ref_count{0};
+
+    RefCounted() {}
+    RefCounted(const RefCounted &) {}
+    RefCounted &operator=(const RefCounted &)
+    {
+        return *this;
+    }
+
+    void retain_ref()
+    {
+#ifdef DEBUG_COUNT_COPIES
+        ref_retains++;
+#endif
+        if (shared_heap_threads.load(std::memory_order_acquire))
+        {
+            ref_count.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            ref_count.store(ref_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+    }
+
+    // True when the last reference was released
+    bool release_ref()
+    {
+        if (shared_heap_threads.load(std::memory_order_acquire))
+        {
+            return ref_count.fetch_sub(1, std::memory_order_acq_rel) == 1;
+        }
+        int count = ref_count.load(std::memory_order_relaxed) - 1;
+        ref_count.store(count, std::memory_order_relaxed);
+        return count == 0;
+    }
+};
+
+template <typename T>
+struct Ref
+{
+    T *ptr = nullptr;
+
+    Ref() {}
+    Ref(std::nullptr_t) {}
+    explicit Ref(T *ptr) : ptr(ptr)
+    {
+        retain();
+    }
+    Ref(const Ref &other) : ptr(other.ptr)
+    {
+        retain();
+    }
+    Ref(Ref &&other) noexcept : ptr(other.ptr)
+    {
+        other.ptr = nullptr;
+    }
+    ~Ref()
+    {
+        release();
+    }
+
+    Ref &operator=(Ref other)
+    {
+        std::swap(ptr, other.ptr);
+        return *this;
+    }
+
+    void retain()
+    {
+        if (ptr)
+        {
+            ptr->retain_ref();
+        }
+    }
+
+    void release()
+    {
+        if (ptr && ptr->release_ref())
+        {
+            delete ptr;
+        }
+        ptr = nullptr;
+    }
+
+    T *get() const
+    {
+        return ptr;
+    }
+    T *operator->() const
+    {
+        return ptr;
+    }
+    T &operator*() const
+    {
+        return *ptr;
+    }
+    explicit operator bool() const
+    {
+        return ptr != nullptr;
+    }
+    bool operator==(const Ref &other) const
+    {
+        return ptr == other.ptr;
+    }
+    bool operator!=(const Ref &other) const
+    {
+        return ptr != other.ptr;
+    }
+};
+
+template <typename T, typename... Args>
+Ref<T> make_ref(Args &&...args)
+{
+    return Ref<T>(new T(std::forward<Args>(args)...));
+}
+
+// Objects that gain the same keys in the same order share a Shape, which
+// maps each key to a slot in the object's value array. Shapes reached by
+// adding keys form a tree rooted at the empty shape and are never freed,
+// so property access sites can cache them by address. An object that
+// outgrows MAX_SHAPE_KEYS, loses a key or gains one computed at runtime
+// gets a dictionary shape of its own instead, which is never cached.
+#define MAX_SHAPE_KEYS 64
+
+struct Shape : RefCounted
+{
+    std::vector<std::string> keys;
+    std::unordered_map<std::string, int> indexes;
+    std::unordered_map<std::string, Ref<Shape>> transitions;
+    bool is_dictionary = false;
+
+    int find(const std::string &key) const
+    {
+        auto it = indexes.find(key);
+        return it == indexes.end() ? -1 : it->second;
+    }
+};
+
+Ref<Shape> empty_shape();
+Ref<Shape> shape_with(Ref<Shape> &shape, const std::string &key);
+
+// Inline cache for one property access site. Each entry packs the address
+// of a tree shape, shifted up 16 bits, with the slot that shape keeps the
+// site's key in, so threads sharing the bytecode never see a torn entry.
+// Object literal sites keep the shape their keys build in the first entry.
+// Method call sites also record where to find the function a call falls
+// back to when the receiver has no such method: the load opcode the name
+// resolved to and its operand.
+#define PROPERTY_CACHE_SIZE 4
+
+struct PropertyCache
+{
+    int name;
+    std::atomic<uint64_t> entries[PROPERTY_CACHE_SIZE];
+    uint8_t fallback_op = 0;
+    int fallback = 0;
+
+    PropertyCache(int name) : name(name)
+    {
+        for (auto &entry : entries)
+        {
+            entry.store(0, std::memory_order_relaxed);
+        }
+    }
+    PropertyCache(const PropertyCache &other) : name(other.name), fallback_op(other.fallback_op), fallback(other.fallback)
+    {
+        for (int i = 0; i < PROPERTY_CACHE_SIZE; i++)
+        {
+            entries[i].store(other.entries[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+    }
+    PropertyCache &operator=(const PropertyCache &other)
+    {
+        name = other.name;
+        fallback_op = other.fallback_op;
+        fallback = other.fallback;
+        for (int i = 0; i < PROPERTY_CACHE_SIZE; i++)
+        {
+            entries[i].store(other.entries[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        return *this;
+    }
+};
+
+// Run-length encoded line info: each entry marks the first byte
+// offset that belongs to a new source line
+struct LineStart
+{
+    int offset;
+    int line;
+};
+
+// A compiled try block. An error raised while a frame's pc is in
+// [start, end) resumes that frame at handler, with its stack cut back to
+// depth locals and the error object pushed on top if the catch binds it.
+struct ExceptionHandler
+{
+    int start;
+    int end;
+    int handler;
+    int depth;
+    bool binds_error;
+};
+
 struct Chunk
 {
     std::vector<uint8_t> code;
-    std::vector<int> lines;
+    std::vector<LineStart> lines;
     std::vector<Value> constants;
     std::vector<std::string> variables;
     std::vector<std::string> public_variables;
     std::string import_path;
+    std::vector<PropertyCache> property_caches;
+    /* Innermost try blocks come first */
+    std::vector<ExceptionHandler> handlers;
 };
 
 struct ClosedVar
@@ -121,48 +388,216 @@ struct ClosedVar
     bool is_local;
 };
 
-struct FunctionObj
+// Everything about a function that is fixed once it is compiled. All
+// closures created from the same function literal share one prototype.
+struct FunctionProto : RefCounted
 {
     std::string name;
-    int arity;
-    int defaults;
+    int arity = 0;
+    int defaults = 0;
     Chunk chunk;
     std::vector<int> instruction_offsets;
     std::vector<ClosedVar> closed_var_indexes;
-    std::vector<std::shared_ptr<Closure>> closed_vars;
-    std::vector<Value> default_values;
-    std::shared_ptr<Value> object;
     std::vector<std::string> params;
     bool is_generator = false;
-    bool generator_init = false;
-    bool generator_done = false;
     bool is_type_generator = false;
+    bool has_capture = false;
     std::string import_path;
 };
 
-struct TypeObj
+struct Traced;
+
+// Links a container into the cycle collector's list as it is created
+void gc_track(Traced *object);
+
+// Containers (lists, objects, types and functions) can hold references
+// to each other, so reference counting alone never frees a cycle of them.
+// Each one is linked into the list of the collector that tracks it and
+// unlinks itself through untrack when freed, whichever code frees it.
+struct Traced : RefCounted
+{
+    ValueType gc_kind;
+    int gc_refs = 0;
+    Traced *gc_prev = nullptr;
+    Traced *gc_next = nullptr;
+    void (*untrack)(Traced *) = nullptr;
+
+    Traced(ValueType kind) : gc_kind(kind)
+    {
+        gc_track(this);
+    }
+    Traced(const Traced &other) : RefCounted(other), gc_kind(other.gc_kind)
+    {
+        gc_track(this);
+    }
+    Traced &operator=(const Traced &)
+    {
+        return *this;
+    }
+    ~Traced()
+    {
+        if (untrack)
+        {
+            untrack(this);
+        }
+    }
+};
+
+struct FunctionObj;
+
+// A suspended generator instance: the stack slots its frame had live at
+// the last yield and the instruction it resumes at
+struct Coroutine
+{
+    std::vector<Value> slots;
+    uint8_t *ip = nullptr;
+    bool running = false;
+    /* The generator a yield from is waiting on */
+    Ref<FunctionObj> delegate;
+    /* Set while an OP_FOR_ITER waits for what the generator gives back */
+    bool loop_waiting = false;
+};
+
+// A function value: its prototype plus what each closure owns
+struct FunctionObj : Traced
+{
+    Ref<FunctionProto> proto;
+    std::vector<std::shared_ptr<Closure>> closed_vars;
+    std::vector<Value> default_values;
+    bool generator_init = false;
+    bool generator_done = false;
+    std::unique_ptr<Coroutine> coroutine;
+
+    FunctionObj() : Traced(Function), proto(make_ref<FunctionProto>()) {}
+    FunctionObj(Ref<FunctionProto> proto) : Traced(Function), proto(proto) {}
+};
+
+// Strings never change once created, so values share one buffer and its
+// hash is computed at most once. Strings the generator emits are
+// interned, so equal ones share a buffer and compare by address.
+struct StringObj : RefCounted
+{
+    const std::string value;
+    std::atomic<size_t> hash{0};
+    bool interned = false;
+
+    StringObj() {}
+    StringObj(std::string value) : value(std::move(value)) {}
+
+    size_t get_hash()
+    {
+        size_t cached = hash.load(std::memory_order_relaxed);
+        if (!cached)
+        {
+            // Never 0, which marks the hash as not computed yet
+            cached = std::hash<std::string>()(value) | 1;
+            hash.store(cached, std::memory_order_relaxed);
+        }
+        return cached;
+    }
+};
+
+struct ListObj : Traced, std::vector<Value>
+{
+    ListObj() : Traced(List) {}
+    using std::vector<Value>::operator=;
+};
+
+struct TypeObj : Traced
 {
     std::string name;
     std::unordered_map<std::string, Value> types;
     std::unordered_map<std::string, Value> defaults;
+
+    TypeObj() : Traced(Type) {}
+};
+
+// An object's properties: its shape plus one value per slot. It reads
+// like the map it replaced, so operator[] adds a missing key and
+// iteration yields entries with first and second, in insertion order.
+struct PropertyMap
+{
+    Ref<Shape> shape;
+    std::vector<Value> slots;
+
+    struct Entry
+    {
+        const std::string &first;
+        Value &second;
+    };
+
+    struct iterator
+    {
+        PropertyMap *map;
+        int index;
+        std::optional<Entry> entry;
+
+        iterator(PropertyMap *map, int index) : map(map), index(index) {}
+
+        Entry &operator*();
+        Entry *operator->()
+        {
+            return &**this;
+        }
+        iterator &operator++()
+        {
+            index++;
+            return *this;
+        }
+        bool operator!=(const iterator &other) const
+        {
+            return index != other.index;
+        }
+    };
+
+    PropertyMap() : shape(empty_shape()) {}
+
+    Value &operator[](const std::string &key);
+    // Adds a key computed at runtime, which seldom recurs, by moving to a
+    // dictionary shape rather than growing the shape tree for good
+    Value &insert_computed(const std::string &key);
+    void erase(const std::string &key);
+
+    int find(const std::string &key) const
+    {
+        return shape->find(key);
+    }
+    size_t count(const std::string &key) const
+    {
+        return shape->find(key) >= 0;
+    }
+    size_t size() const
+    {
+        return shape->keys.size();
+    }
+    iterator begin()
+    {
+        return {this, 0};
+    }
+    iterator end()
+    {
+        return {this, (int)size()};
+    }
 };
 
-struct ObjectObj
+struct ObjectObj : Traced
 {
-    std::shared_ptr<TypeObj> type;
-    std::unordered_map<std::string, Value> values;
+    Ref<TypeObj> type;
+    PropertyMap values;
     std::vector<std::string> keys;
     std::string type_name;
+
+    ObjectObj() : Traced(Object) {}
 };
 
-struct PointerObj
+struct PointerObj : RefCounted
 {
     void *value;
 };
 
 typedef Value (*NativeFunction)(std::vector<Value> &args);
 
-struct NativeFunctionObj
+struct NativeFunctionObj : RefCounted
 {
     std::string name;
     NativeFunction function = nullptr;
@@ -170,10 +605,12 @@ struct NativeFunctionObj
 
 struct Meta
 {
-    bool unpack = false;
-    bool packer = false;
-    bool is_const = false;
-    bool temp_non_const = false;
+    bool unpack : 1;
+    bool packer : 1;
+    bool is_const : 1;
+    bool temp_non_const : 1;
+
+    Meta() : unpack(false), packer(false), is_const(false), temp_non_const(false) {}
 };
 
 struct ValueHooks
@@ -184,110 +621,282 @@ struct ValueHooks
     std::string onAccessHookName;
 };
 
-std::string toString(Value value);
-
-static long long int v_counter = 0;
+// Hooks are rare, so values only carry an index into a shared table of
+// hook sets. Index 0 means the value has no hooks. Each entry counts the
+// values carrying its index and is reused once the last of them is gone;
+// intern_hooks returns an index that already holds one of those counts.
+uint32_t intern_hooks(const ValueHooks &hooks);
+const ValueHooks &lookup_hooks(uint32_t hooks_id);
+void retain_hooks(uint32_t hooks_id);
+void release_hooks(uint32_t hooks_id);
 
+// 16 bytes: the type tag, meta flags and hook index share one word and the
+// payload (a double, a bool or a pointer to a refcounted heap object)
+// lives in the other
 struct Value
 {
     ValueType type;
     Meta meta;
-    ValueHooks hooks;
-    long long int id;
-    std::variant<
-        double,
-        std::string,
-        bool,
-        std::shared_ptr<std::vector<Value>>,
-        std::shared_ptr<FunctionObj>,
-        std::shared_ptr<TypeObj>,
-        std::shared_ptr<ObjectObj>,
-        std::shared_ptr<NativeFunctionObj>,
-        std::shared_ptr<PointerObj>>
-        value;
-
-    Value() : type(None)
-    {
-        id = ++v_counter;
-    }
+    uint32_t hooks_id = 0;
+    union Payload
+    {
+        uint64_t bits;
+        double number;
+        bool boolean;
+        RefCounted *object;
+        Ref<StringObj> string;
+        Ref<ListObj> list;
+        Ref<TypeObj> type_obj;
+        Ref<ObjectObj> object_obj;
+        Ref<FunctionObj> function;
+        Ref<NativeFunctionObj> native;
+        Ref<PointerObj> pointer;
+
+        Payload() : bits(0) {}
+        ~Payload() {}
+    } as;
+
+    Value() : type(None) {}
     Value(ValueType type) : type(type)
     {
-        id = ++v_counter;
         switch (type)
         {
-        case Number:
-            value = 0.0f;
-            break;
         case String:
-            value = "";
+            adopt(new StringObj());
             break;
-        case Boolean:
-            value = false;
+        case List:
+            adopt(new ListObj());
+            break;
+        case Type:
+            adopt(new TypeObj());
+            break;
+        case Object:
+            adopt(new ObjectObj());
+            break;
+        case Function:
+            adopt(new FunctionObj());
+            break;
+        case Native:
+            adopt(new NativeFunctionObj());
+            break;
+        case Pointer:
+            adopt(new PointerObj());
+            break;
+        default:
+            break;
+        }
+    }
+    Value(const Value &other) : type(other.type), meta(other.meta), hooks_id(other.hooks_id)
+    {
+#ifdef DEBUG_COUNT_COPIES
+        value_copies++;
+#endif
+        as.bits = other.as.bits;
+        retain();
+        if (hooks_id)
+        {
+            retain_hooks(hooks_id);
+        }
+    }
+    Value(Value &&other) noexcept : type(other.type), meta(other.meta), hooks_id(other.hooks_id)
+    {
+        as.bits = other.as.bits;
+        other.type = None;
+        other.hooks_id = 0;
+    }
+    ~Value()
+    {
+        release();
+        if (hooks_id)
+        {
+            release_hooks(hooks_id);
+        }
+    }
+
+    Value &operator=(const Value &other)
+    {
+#ifdef DEBUG_COUNT_COPIES
+        value_copies++;
+#endif
+        other.retain();
+        release();
+        set_hooks_id(other.hooks_id);
+        type = other.type;
+        meta = other.meta;
+        as.bits = other.as.bits;
+        return *this;
+    }
+    Value &operator=(Value &&other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            if (hooks_id)
+            {
+                release_hooks(hooks_id);
+            }
+            type = other.type;
+            meta = other.meta;
+            hooks_id = other.hooks_id;
+            as.bits = other.as.bits;
+            other.type = None;
+            other.hooks_id = 0;
+        }
+        return *this;
+    }
+
+    bool is_heap() const
+    {
+        return type != Number && type != Boolean && type != None && type != Range;
+    }
+
+    void adopt(RefCounted *object)
+    {
+        object->ref_count.store(1, std::memory_order_relaxed);
+        as.object = object;
+    }
+
+    void retain() const
+    {
+        if (is_heap())
+        {
+            as.object->retain_ref();
+        }
+    }
+
+    void release()
+    {
+        if (is_heap() && as.object->release_ref())
+        {
+            destroy();
+        }
+    }
+
+    void destroy()
+    {
+        switch (type)
+        {
+        case String:
+            delete static_cast<StringObj *>(as.object);
             break;
         case List:
-            value = std::make_shared<std::vector<Value>>();
+            delete static_cast<ListObj *>(as.object);
             break;
         case Type:
-            value = std::make_shared<TypeObj>();
+            delete static_cast<TypeObj *>(as.object);
             break;
         case Object:
-            value = std::make_shared<ObjectObj>();
+            delete static_cast<ObjectObj *>(as.object);
             break;
         case Function:
-            value = std::make_shared<FunctionObj>();
+            delete static_cast<FunctionObj *>(as.object);
             break;
         case Native:
-            value = std::make_shared<NativeFunctionObj>();
+            delete static_cast<NativeFunctionObj *>(as.object);
             break;
         case Pointer:
-            value = std::make_shared<PointerObj>();
+            delete static_cast<PointerObj *>(as.object);
             break;
         default:
             break;
         }
     }
 
+    // Identity is the heap address for reference types and the payload
+    // itself for numbers, booleans and None
+    long long int get_id()
+    {
+        if (is_heap())
+        {
+            return (long long int)(uintptr_t)as.object;
+        }
+        return (long long int)(as.bits ^ ((uint64_t)type << 56));
+    }
+
+    const ValueHooks &get_hooks()
+    {
+        return lookup_hooks(hooks_id);
+    }
+
+    void set_hooks(const ValueHooks &hooks)
+    {
+        uint32_t interned = intern_hooks(hooks);
+        if (hooks_id)
+        {
+            release_hooks(hooks_id);
+        }
+        hooks_id = interned;
+    }
+
+    // Gives the value another value's hooks, or none for 0
+    void set_hooks_id(uint32_t id)
+    {
+        if (id)
+        {
+            retain_hooks(id);
+        }
+        if (hooks_id)
+        {
+            release_hooks(hooks_id);
+        }
+        hooks_id = id;
+    }
+
     double &get_number()
     {
-        return std::get<double>(this->value);
+        return as.number;
     }
-    std::string &get_string()
+    const std::string &get_string()
     {
-        return std::get<std::string>(this->value);
+        return as.string->value;
     }
     bool &get_boolean()
     {
-        return std::get<bool>(this->value);
+        return as.boolean;
+    }
+
+    Ref<ListObj> &get_list()
+    {
+        return as.list;
     }
 
-    std::shared_ptr<std::vector<Value>> &get_list()
+    Ref<TypeObj> &get_type()
     {
-        return std::get<std::shared_ptr<std::vector<Value>>>(this->value);
+        return as.type_obj;
     }
 
-    std::shared_ptr<TypeObj> &get_type()
+    Ref<ObjectObj> &get_object()
     {
-        return std::get<std::shared_ptr<TypeObj>>(this->value);
+        return as.object_obj;
     }
 
-    std::shared_ptr<ObjectObj> &get_object()
+    Ref<FunctionObj> &get_function()
     {
-        return std::get<std::shared_ptr<ObjectObj>>(this->value);
+        return as.function;
     }
 
-    std::shared_ptr<FunctionObj> &get_function()
+    Ref<NativeFunctionObj> &get_native()
     {
-        return std::get<std::shared_ptr<FunctionObj>>(this->value);
+        return as.native;
     }
 
-    std::shared_ptr<NativeFunctionObj> &get_native()
+    Ref<PointerObj> &get_pointer()
     {
-        return std::get<std::shared_ptr<NativeFunctionObj>>(this->value);
+        return as.pointer;
     }
 
-    std::shared_ptr<PointerObj> &get_pointer()
+    // A range keeps its bounds in the two halves of the payload
+    int range_start()
     {
-        return std::get<std::shared_ptr<PointerObj>>(this->value);
+        return (int32_t)(uint32_t)as.bits;
+    }
+    int range_end()
+    {
+        return (int32_t)(uint32_t)(as.bits >> 32);
+    }
+    int range_length()
+    {
+        return std::max<int64_t>((int64_t)range_end() - range_start(), 0);
     }
 
     bool is_number()
@@ -330,6 +939,10 @@ struct Value
     {
         return type == None;
     }
+    bool is_range()
+    {
+        return type == Range;
+    }
     std::string type_repr()
     {
         switch (type)
@@ -354,6 +967,8 @@ struct Value
             return "Type";
         case None:
             return "None";
+        case Range:
+            return "Range";
         default:
             return "Unknown";
         }
@@ -376,32 +991,77 @@ struct Closure
     Value *initial_location;
 };
 
+// Cycle collector counters and tuning. A collection is due once
+// threshold containers were allocated since the last one, and at least
+// growth times as many as survived it, so the cost of collecting stays
+// proportional to allocation. A threshold of 0 only collects on request.
+struct CollectorStats
+{
+    int threshold = 10000;
+    double growth = 1.0;
+    long long collections = 0;
+    long long collected = 0;
+    long long tracked = 0;
+    long long allocated = 0;
+    long long survivors = 0;
+};
+
+// Set when a collection is due; the VM collects at its next safe point
+extern std::atomic<bool> collection_due;
+
+// Frees unreachable cycles of containers and returns how many it freed.
+// Nothing else may touch the heap meanwhile, so it does nothing while
+// another thread runs VM code.
+int collect_cycles();
+CollectorStats collector_stats();
+void set_collector_threshold(int threshold, double growth);
+
 Value new_val();
 Value number_val(double value);
 Value string_val(std::string value);
+Value interned_string_val(const std::string &value);
 Value boolean_val(bool value);
 Value list_val();
 Value type_val(std::string name);
 Value object_val();
 Value function_val();
+Value function_val(Ref<FunctionProto> proto);
 Value native_val();
 Value pointer_val();
 Value none_val();
+Value range_val(int start, int end);
 
 void printValue(Value value);
 
 void add_code(Chunk &chunk, uint8_t code, int line = 0);
 
+int get_line(Chunk &chunk, int offset);
+
+bool has_fixed_operand(uint8_t op);
+
+int read_operand(Chunk &chunk, int offset, int &operand);
+
 void add_opcode(Chunk &chunk, uint8_t op, int operand, int line = 0);
 
 int add_constant(Chunk &chunk, Value value);
 
 void add_constant_code(Chunk &chunk, Value value, int line = 0);
 
+// Adds the constant a property access site names and an empty inline
+// cache for the site, returning the cache index
+int add_property_cache(Chunk &chunk, Value name);
+
 void add_bytes(Chunk &chunk, Value value, uint8_t op, int line = 0);
 
 void patch_bytes(Chunk &chunk, int offset, uint8_t *bytes);
 
+// Global names are numbered process-wide. OP_LOAD_GLOBAL carries the slot
+// and every VM stores its globals at the same slots.
+int global_slot(const std::string &name);
+// The slot of a name that has one, or -1, without giving it one
+int find_global_slot(const std::string &name);
+std::string global_slot_name(int slot);
+
 static int simple_instruction(std::string name, int offset);
 
 static int constant_instruction(std::string name, Chunk &chunk, int offset);
@@ -413,4 +1073,9 @@ void disassemble_chunk(Chunk &chunk, std::string name);
 
 int advance(Chunk &chunk, int offset);
 
-std::vector<int> instruction_offsets(Chunk &chunk);
\ No newline at end of file
+std::vector<int> instruction_offsets(Chunk &chunk);
+
+// Peephole pass over a finished chunk: merges duplicate constants, drops
+// constants that are popped straight away and jumps to the next
+// instruction, and fuses common sequences into superinstructions
+void optimize_chunk(Chunk &chunk);
\ No newline at end of file
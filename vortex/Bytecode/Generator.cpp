@@ -15,7 +15,7 @@ void gen_literal(Chunk &chunk, node_ptr node)
     }
     case NodeType::STRING:
     {
-        add_constant_code(chunk, string_val(node->_Node.String().value), node->line);
+        add_constant_code(chunk, interned_string_val(node->_Node.String().value), node->line);
         break;
     }
     case NodeType::BOOLEAN:
@@ -225,7 +225,17 @@ void gen_eq(Chunk &chunk, node_ptr node)
             }
         }
         generate(left->_Node.Accessor().container, chunk);
-        generate(left->_Node.Accessor().accessor->_Node.List().elements[0], chunk);
+        node_ptr &key = left->_Node.Accessor().accessor->_Node.List().elements[0];
+        // A literal key is set like a dot access, which keeps computed keys
+        // apart for OP_SET_PROPERTY
+        if (key->type == NodeType::STRING)
+        {
+            generate(node->_Node.Op().right, chunk);
+            int cache = add_property_cache(chunk, interned_string_val(key->_Node.String().value));
+            add_opcode(chunk, OP_SET_PROPERTY_NAMED, cache, node->line);
+            return;
+        }
+        generate(key, chunk);
         generate(node->_Node.Op().right, chunk);
         add_code(chunk, OP_SET_PROPERTY, node->line);
     }
@@ -246,9 +256,9 @@ void gen_eq(Chunk &chunk, node_ptr node)
         if (left->_Node.Op().right->type == NodeType::ID)
         {
             generate(left->_Node.Op().left, chunk);
-            add_constant_code(chunk, string_val(left->_Node.Op().right->_Node.ID().value), node->line);
             generate(node->_Node.Op().right, chunk);
-            add_code(chunk, OP_SET_PROPERTY, node->line);
+            int cache = add_property_cache(chunk, interned_string_val(left->_Node.Op().right->_Node.ID().value));
+            add_opcode(chunk, OP_SET_PROPERTY_NAMED, cache, node->line);
             return;
         }
 
@@ -355,7 +365,22 @@ void gen_id(Chunk &chunk, node_ptr node, int global_flag)
         {
             error("Cannot use 'this' in outer scope", chunk, node);
         }
-        add_code(chunk, OP_LOAD_THIS, node->line);
+        // Methods keep their receiver in a slot after their own; other
+        // functions close over the receiver of the method around them, and
+        // outside of one there is none
+        int index = resolve_variable("this");
+        if (index != -1)
+        {
+            add_opcode(chunk, OP_LOAD, index, node->line);
+            return;
+        }
+        index = resolve_closure_nested("this");
+        if (index == -1)
+        {
+            add_constant_code(chunk, none_val(), node->line);
+            return;
+        }
+        add_opcode(chunk, OP_LOAD_CLOSURE, index, node->line);
         return;
     }
     int index = resolve_variable(node->_Node.ID().value);
@@ -367,8 +392,7 @@ void gen_id(Chunk &chunk, node_ptr node, int global_flag)
     index = resolve_closure_nested(node->_Node.ID().value);
     if (index == -1)
     {
-        add_constant_code(chunk, string_val(node->_Node.ID().value), node->line);
-        add_opcode(chunk, OP_LOAD_GLOBAL, global_flag, node->line);
+        add_opcode(chunk, global_flag == 1 ? OP_LOAD_GLOBAL_OPTIONAL : OP_LOAD_GLOBAL, global_slot(node->_Node.ID().value), node->line);
     }
     else
     {
@@ -378,42 +402,37 @@ void gen_id(Chunk &chunk, node_ptr node, int global_flag)
 
 int gen_try_catch(Chunk &chunk, node_ptr node)
 {
-    int try_begin_instruction = chunk.code.size() + 1;
-    add_opcode(chunk, OP_TRY_BEGIN, 0, node->line);
+    // The try body costs nothing to enter; the VM finds the handler in
+    // chunk.handlers when an error is raised inside [start, end)
+    ExceptionHandler handler;
+    handler.start = chunk.code.size();
     // begin_scope();
     generate_bytecode(node->_Node.TryCatch().try_body->_Node.Object().elements, chunk);
     // end_scope(chunk);
-    add_code(chunk, OP_TRY_END, node->line);
+    handler.end = chunk.code.size();
     int jump_instruction = chunk.code.size() + 1;
     add_opcode(chunk, OP_JUMP, 0, node->line);
 
-    int catch_offset = chunk.code.size() - try_begin_instruction - 4;
-    // int catch_offset = chunk.code.size();
-    uint8_t *catch_bytes = int_to_bytes(catch_offset);
-    patch_bytes(chunk, try_begin_instruction, catch_bytes);
+    handler.handler = chunk.code.size();
+    handler.depth = current->variableCount;
 
     begin_scope();
 
-    add_code(chunk, OP_CATCH_BEGIN, node->line);
-
     // error object
     if (node->_Node.TryCatch().catch_keyword->_Node.FunctionCall().args.size() > 1)
     {
         error("Catch keyword expects 0 or 1 arguments", chunk, node);
     }
-    if (node->_Node.TryCatch().catch_keyword->_Node.FunctionCall().args.size() == 1)
+    handler.binds_error = node->_Node.TryCatch().catch_keyword->_Node.FunctionCall().args.size() == 1;
+    if (handler.binds_error)
     {
+        // The VM pushes the error object straight into this slot
         std::string error_var_name = node->_Node.TryCatch().catch_keyword->_Node.FunctionCall().args[0]->_Node.ID().value;
-        add_constant_code(chunk, object_val());
         declareVariable(error_var_name, false, true, chunk, node);
-        add_code(chunk, OP_SWAP_TOS, node->line);
-        add_opcode(chunk, OP_SET_FORCE, resolve_variable(error_var_name), node->line);
-        // add_code(chunk, OP_POP, node->line); // pop the error object off the stack
-        // add_code(chunk, OP_POP, node->line); // pop the original empty object off the stack
     }
+    chunk.handlers.push_back(handler);
 
     generate_bytecode(node->_Node.TryCatch().catch_body->_Node.Object().elements, chunk);
-    add_code(chunk, OP_POP, node->line); // pop the error object off the stack
 
     end_scope(chunk);
 
@@ -468,9 +487,27 @@ void gen_if_block(Chunk &chunk, node_ptr node)
     }
 }
 
+static void begin_loop()
+{
+    LoopTargets loop;
+    loop.depth = current->variableCount;
+    current->loops.push_back(loop);
+}
+
+// Points every forward jump in `jumps` at the current end of the chunk
+static void patch_jumps(Chunk &chunk, std::vector<int> &jumps)
+{
+    for (int jump : jumps)
+    {
+        int offset = chunk.code.size() - jump - 4;
+        uint8_t *bytes = int_to_bytes(offset);
+        patch_bytes(chunk, jump, bytes);
+    }
+}
+
 void gen_while_loop(Chunk &chunk, node_ptr node)
 {
-    add_opcode(chunk, OP_LOOP, 0, node->line);
+    begin_loop();
     int start_index = chunk.code.size() - 1;
     generate(node->_Node.WhileLoop().condition, chunk);
     int jump_instruction = chunk.code.size() + 1;
@@ -482,11 +519,13 @@ void gen_while_loop(Chunk &chunk, node_ptr node)
     end_scope(chunk);
     // current->in_loop = false;
     current->nested_loop_count--;
+    patch_jumps(chunk, current->loops.back().continue_jumps);
     add_opcode(chunk, OP_JUMP_BACK, chunk.code.size() - start_index + 4, node->line);
     int offset = chunk.code.size() - jump_instruction - 4;
     uint8_t *bytes = int_to_bytes(offset);
     patch_bytes(chunk, jump_instruction, bytes);
-    add_code(chunk, OP_LOOP_END, node->line);
+    patch_jumps(chunk, current->loops.back().break_jumps);
+    current->loops.pop_back();
 }
 
 void gen_for_loop(Chunk &chunk, node_ptr node)
@@ -517,17 +556,24 @@ void gen_for_loop(Chunk &chunk, node_ptr node)
         add_code(chunk, OP_SUBTRACT, node->line);
         declareVariable("___size___", false, true, chunk, node);
 
-        int loop_start = chunk.code.size() - 1;
+        // An empty or reversed range runs the body no times
+        add_opcode(chunk, OP_LOAD, resolve_variable("___size___"), node->line);
+        add_constant_code(chunk, number_val(0), node->line);
+        add_code(chunk, OP_LT_EQ, node->line);
+
+        std::vector<int> jump_if_empty = {(int)chunk.code.size() + 1};
+        add_opcode(chunk, OP_POP_JUMP_IF_TRUE, 0, node->line);
 
-        add_opcode(chunk, OP_LOOP, 0, node->line);
+        int loop_start = chunk.code.size() - 1;
 
+        begin_loop();
         begin_scope();
 
         generate_bytecode(node->_Node.ForLoop().body->_Node.Object().elements, chunk);
 
         end_scope(chunk);
 
-        add_code(chunk, OP_ITER, node->line);
+        patch_jumps(chunk, current->loops.back().continue_jumps);
         add_opcode(chunk, OP_LOAD, resolve_variable(node->_Node.ForLoop().index_name->_Node.ID().value), node->line);
         add_constant_code(chunk, number_val(1), node->line);
         add_code(chunk, OP_ADD, node->line);
@@ -543,13 +589,15 @@ void gen_for_loop(Chunk &chunk, node_ptr node)
             add_code(chunk, OP_POP, node->line);
         }
 
-        add_code(chunk, OP_ITER, node->line);
         add_opcode(chunk, OP_LOAD, resolve_variable(node->_Node.ForLoop().index_name->_Node.ID().value), node->line);
         add_opcode(chunk, OP_LOAD, resolve_variable("___size___"));
         add_code(chunk, OP_GT_EQ, node->line);
         add_opcode(chunk, OP_POP_JUMP_IF_TRUE, 5, node->line);
 
         add_opcode(chunk, OP_JUMP_BACK, chunk.code.size() - loop_start + 4, node->line);
+        patch_jumps(chunk, current->loops.back().break_jumps);
+        patch_jumps(chunk, jump_if_empty);
+        current->loops.pop_back();
 
         end_scope(chunk);
     }
@@ -563,71 +611,47 @@ void gen_for_loop(Chunk &chunk, node_ptr node)
 
         begin_scope();
 
-        add_constant_code(chunk, number_val(0));
-        declareVariable(node->_Node.ForLoop().index_name->_Node.ID().value, false, true, chunk, node);
-
+        // The iterable, the index and the value sit in consecutive locals,
+        // which OP_FOR_ITER advances in one step
         generate(node->_Node.ForLoop().iterator, chunk);
+        add_code(chunk, OP_GET_ITER, node->line);
         declareVariable("___iter___", false, true, chunk, node);
+        int iter_slot = resolve_variable("___iter___");
+
+        add_constant_code(chunk, number_val(-1), node->line);
+        declareVariable(node->_Node.ForLoop().index_name->_Node.ID().value, false, true, chunk, node);
 
+        add_constant_code(chunk, none_val(), node->line);
         if (node->_Node.ForLoop().value_name)
         {
-            add_opcode(chunk, OP_LOAD, resolve_variable("___iter___"), node->line);
-            add_constant_code(chunk, number_val(0));
-            add_opcode(chunk, OP_ACCESSOR, 0, node->line);
             declareVariable(node->_Node.ForLoop().value_name->_Node.ID().value, false, true, chunk, node);
         }
+        else
+        {
+            declareVariable("___value___", false, true, chunk, node);
+        }
 
-        add_opcode(chunk, OP_LOAD, resolve_variable("___iter___"), node->line);
-        add_code(chunk, OP_LEN, node->line);
-        declareVariable("___size___", false, true, chunk, node);
-
-        add_opcode(chunk, OP_LOAD, resolve_variable("___size___"));
-        add_constant_code(chunk, number_val(0), node->line);
-        add_code(chunk, OP_EQ_EQ, node->line);
-
-        int jump_if_empty = chunk.code.size() + 1;
-        add_opcode(chunk, OP_POP_JUMP_IF_TRUE, 0, node->line);
-
-        int loop_start = chunk.code.size() - 1;
+        std::vector<int> jump_to_next = {(int)chunk.code.size() + 1};
+        add_opcode(chunk, OP_JUMP, 0, node->line);
 
-        add_opcode(chunk, OP_LOOP, 0, node->line);
+        int loop_start = chunk.code.size();
 
+        begin_loop();
         begin_scope();
 
         generate_bytecode(node->_Node.ForLoop().body->_Node.Object().elements, chunk);
 
         end_scope(chunk);
 
-        add_code(chunk, OP_ITER, node->line);
-        add_opcode(chunk, OP_LOAD, resolve_variable(node->_Node.ForLoop().index_name->_Node.ID().value), node->line);
-        add_constant_code(chunk, number_val(1), node->line);
-        add_code(chunk, OP_ADD, node->line);
-        add_opcode(chunk, OP_SET_FORCE, resolve_variable(node->_Node.ForLoop().index_name->_Node.ID().value), node->line);
-        add_code(chunk, OP_POP, node->line);
-
-        if (node->_Node.ForLoop().value_name)
-        {
-            add_opcode(chunk, OP_LOAD, resolve_variable("___iter___"), node->line);
-            add_opcode(chunk, OP_LOAD, resolve_variable(node->_Node.ForLoop().index_name->_Node.ID().value), node->line);
-            add_opcode(chunk, OP_ACCESSOR, 0, node->line);
-            add_opcode(chunk, OP_SET_FORCE, resolve_variable(node->_Node.ForLoop().value_name->_Node.ID().value), node->line);
-            add_code(chunk, OP_POP, node->line);
-        }
-
-        add_opcode(chunk, OP_LOAD, resolve_variable(node->_Node.ForLoop().index_name->_Node.ID().value), node->line);
-        add_opcode(chunk, OP_LOAD, resolve_variable("___size___"));
-        add_code(chunk, OP_GT_EQ, node->line);
-        add_opcode(chunk, OP_POP_JUMP_IF_TRUE, 5, node->line);
-
-        int offset = chunk.code.size() - jump_if_empty + 1;
-        uint8_t *bytes = int_to_bytes(offset);
-        patch_bytes(chunk, jump_if_empty, bytes);
-
-        add_opcode(chunk, OP_JUMP_BACK, chunk.code.size() - loop_start + 4, node->line);
+        patch_jumps(chunk, current->loops.back().continue_jumps);
+        patch_jumps(chunk, jump_to_next);
+        add_opcode(chunk, OP_FOR_ITER, iter_slot, node->line);
+        add_opcode(chunk, OP_JUMP_BACK, chunk.code.size() - loop_start + 5, node->line);
+        patch_jumps(chunk, current->loops.back().break_jumps);
+        current->loops.pop_back();
 
         end_scope(chunk);
     }
-    add_code(chunk, OP_LOOP_END, node->line);
     // current->in_loop = false;
     current->nested_loop_count--;
 }
@@ -635,16 +659,27 @@ void gen_for_loop(Chunk &chunk, node_ptr node)
 void gen_accessor(Chunk &chunk, node_ptr node)
 {
     generate(node->_Node.Accessor().container, chunk);
-    generate(node->_Node.Accessor().accessor->_Node.List().elements[0], chunk);
+    node_ptr &key = node->_Node.Accessor().accessor->_Node.List().elements[0];
+    // A literal key reads the same as a dot access, so it gets a property
+    // cache too
+    if (key->type == NodeType::STRING)
+    {
+        int cache = add_property_cache(chunk, interned_string_val(key->_Node.String().value));
+        add_opcode(chunk, OP_GET_PROPERTY, cache, node->line);
+        return;
+    }
+    generate(key, chunk);
     add_opcode(chunk, OP_ACCESSOR, 0, node->line);
 }
 
-void gen_dot(Chunk &chunk, node_ptr node)
+void gen_dot(Chunk &chunk, node_ptr node, bool tail)
 {
     if (node->_Node.Op().right->type == NodeType::ID)
     {
         generate(node->_Node.Op().left, chunk);
-        add_constant_code(chunk, string_val(node->_Node.Op().right->_Node.ID().value), node->line);
+        int cache = add_property_cache(chunk, interned_string_val(node->_Node.Op().right->_Node.ID().value));
+        add_opcode(chunk, OP_GET_PROPERTY, cache, node->line);
+        return;
     }
     else if (node->_Node.Op().right->type == NodeType::FUNC_CALL)
     {
@@ -663,12 +698,28 @@ void gen_dot(Chunk &chunk, node_ptr node)
             }
         }
         generate(node->_Node.Op().left, chunk);
-        add_constant_code(chunk, string_val(node->_Node.Op().right->_Node.FunctionCall().name), node->line);
-        add_opcode(chunk, OP_ACCESSOR, 1, node->line);
-        node_ptr backup_function_node = std::make_shared<Node>(NodeType::ID);
-        backup_function_node->_Node.ID().value = node->_Node.Op().right->_Node.FunctionCall().name;
-        gen_id(chunk, backup_function_node, 1);
-        add_opcode(chunk, OP_CALL_METHOD, node->_Node.Op().right->_Node.FunctionCall().args.size(), node->line);
+        std::string name = node->_Node.Op().right->_Node.FunctionCall().name;
+        // A receiver without the method hands itself to the function of the
+        // same name instead; the site records where gen_id would load that
+        // from, so it is only looked up when needed. Method names are not
+        // given global slots, so a global defined later is found by name.
+        uint8_t fallback_op = OP_LOAD;
+        int fallback = resolve_variable(name);
+        if (fallback == -1)
+        {
+            fallback_op = OP_LOAD_CLOSURE;
+            fallback = resolve_closure_nested(name);
+        }
+        if (fallback == -1)
+        {
+            fallback_op = OP_LOAD_GLOBAL_OPTIONAL;
+            fallback = find_global_slot(name);
+        }
+        int cache = add_property_cache(chunk, interned_string_val(name));
+        chunk.property_caches[cache].fallback_op = fallback_op;
+        chunk.property_caches[cache].fallback = fallback;
+        add_opcode(chunk, OP_GET_METHOD, cache, node->line);
+        add_opcode(chunk, tail ? OP_TAIL_CALL_METHOD : OP_CALL_METHOD, node->_Node.Op().right->_Node.FunctionCall().args.size(), node->line);
         return;
     }
     else if (node->_Node.Op().right->type == NodeType::ACCESSOR)
@@ -734,7 +785,7 @@ void gen_hook(Chunk &chunk, node_ptr node)
         }
         else
         {
-            add_constant_code(chunk, string_val(name), node->line);
+            add_constant_code(chunk, interned_string_val(name), node->line);
         }
 
         if (hook_name == "onChange")
@@ -779,7 +830,7 @@ void gen_hook(Chunk &chunk, node_ptr node)
         else if (left->type == NodeType::OP && left->_Node.Op().value == ".")
         {
             generate(left->_Node.Op().left, chunk);
-            add_constant_code(chunk, string_val(left->_Node.Op().right->_Node.ID().value), node->line);
+            add_constant_code(chunk, interned_string_val(left->_Node.Op().right->_Node.ID().value), node->line);
             index = -2;
         }
         else
@@ -816,7 +867,7 @@ void gen_hook(Chunk &chunk, node_ptr node)
         }
         else
         {
-            add_constant_code(chunk, string_val(""), node->line);
+            add_constant_code(chunk, interned_string_val(""), node->line);
         }
 
         if (hook_name == "onChange")
@@ -838,23 +889,29 @@ void gen_hook(Chunk &chunk, node_ptr node)
 void gen_break(Chunk &chunk, node_ptr node)
 {
     // if (!current->in_loop)
-    if (current->nested_loop_count == 0)
+    if (current->loops.empty())
     {
         error("Cannot use 'break' outside of a loop", chunk, node);
     }
 
-    add_code(chunk, OP_BREAK, node->line);
+    LoopTargets &loop = current->loops.back();
+    add_opcode(chunk, OP_BREAK, loop.depth, node->line);
+    loop.break_jumps.push_back(chunk.code.size() + 1);
+    add_opcode(chunk, OP_JUMP, 0, node->line);
 }
 
 void gen_continue(Chunk &chunk, node_ptr node)
 {
     // if (!current->in_loop)
-    if (current->nested_loop_count == 0)
+    if (current->loops.empty())
     {
         error("Cannot use 'continue' outside of a loop", chunk, node);
     }
 
-    add_code(chunk, OP_CONTINUE, node->line);
+    LoopTargets &loop = current->loops.back();
+    add_opcode(chunk, OP_CONTINUE, loop.depth, node->line);
+    loop.continue_jumps.push_back(chunk.code.size() + 1);
+    add_opcode(chunk, OP_JUMP, 0, node->line);
 }
 
 void gen_return(Chunk &chunk, node_ptr node)
@@ -865,9 +922,20 @@ void gen_return(Chunk &chunk, node_ptr node)
         error("Cannot use 'return' at the top level", chunk, node);
     }
 
-    if (node->_Node.Return().value)
+    // A call in tail position may hand this frame over to its callee. The
+    // OP_RETURN after it still runs when the VM makes an ordinary call.
+    node_ptr &value = node->_Node.Return().value;
+    if (value && value->type == NodeType::FUNC_CALL)
     {
-        generate(node->_Node.Return().value, chunk);
+        gen_function_call(chunk, value, true);
+    }
+    else if (value && value->type == NodeType::OP && value->_Node.Op().value == "." && value->_Node.Op().right->type == NodeType::FUNC_CALL)
+    {
+        gen_dot(chunk, value, true);
+    }
+    else if (value)
+    {
+        generate(value, chunk);
     }
     else
     {
@@ -892,7 +960,7 @@ void gen_yield(Chunk &chunk, node_ptr node)
     {
         add_constant_code(chunk, none_val(), node->line);
     }
-    add_code(chunk, OP_YIELD, node->line);
+    add_code(chunk, node->_Node.Yield().delegate ? OP_YIELD_FROM : OP_YIELD, node->line);
 }
 
 void gen_function(Chunk &chunk, node_ptr node)
@@ -907,22 +975,26 @@ void gen_function(Chunk &chunk, node_ptr node)
     current->nested_object_count = prev_compiler->nested_object_count;
     current->nested_function_count = prev_compiler->nested_function_count;
     current->nested_loop_count = prev_compiler->nested_loop_count;
+    current->function_object_count = current->nested_object_count;
 
     // current->in_function = true;
     current->nested_function_count++;
 
-    std::shared_ptr<FunctionObj> function = std::make_shared<FunctionObj>();
-    function->name = node->_Node.Function().name;
-    function->arity = node->_Node.Function().params.size();
-    function->chunk = Chunk();
-    function->chunk.import_path = chunk.import_path;
+    Ref<FunctionObj> function = make_ref<FunctionObj>();
+    function->proto->name = node->_Node.Function().name;
+    function->proto->arity = node->_Node.Function().params.size();
+    function->proto->chunk = Chunk();
+    function->proto->chunk.import_path = chunk.import_path;
 
     Value function_value = function_val();
-    function_value.value = function;
+    function_value.get_function() = function;
 
-    function->is_generator = node->_Node.Function().is_generator;
-    function->is_type_generator = node->_Node.Function().is_type_generator;
+    function->proto->is_generator = node->_Node.Function().is_generator;
+    function->proto->is_type_generator = node->_Node.Function().is_type_generator;
 
+    // Parameters, the function itself, its receiver and a generator's
+    // _value occupy the first slots of the callee's frame; call_function
+    // fills them in
     for (auto &param : node->_Node.Function().params)
     {
         std::string param_name = param->_Node.ID().value;
@@ -930,11 +1002,9 @@ void gen_function(Chunk &chunk, node_ptr node)
         if (is_capture)
         {
             node->_Node.Function().default_values[param_name] = std::make_shared<Node>(NodeType::LIST);
+            function->proto->has_capture = true;
         }
-        function->params.push_back(param_name);
-
-        Value placeholder = list_val();
-        placeholder.meta.packer = true;
+        function->proto->params.push_back(param_name);
 
         if (node->_Node.Function().default_values.count(param_name))
         {
@@ -942,69 +1012,66 @@ void gen_function(Chunk &chunk, node_ptr node)
             {
                 error("Capture param (...) cannot have a default value", chunk, node);
             }
-            function->defaults++;
+            function->proto->defaults++;
             auto temp = current;
             current = prev_compiler;
             generate(node->_Node.Function().default_values[param_name], chunk);
             current = temp;
-            add_constant_code(function->chunk, is_capture ? placeholder : none_val(), param->line);
-        }
-        else
-        {
-            is_capture ? add_constant_code(function->chunk, placeholder, param->line) : add_constant_code(function->chunk, none_val(), param->line);
         }
 
         declareVariable(param->_Node.ID().value, false, false, chunk, node);
     }
 
-    add_constant_code(function->chunk, function_value, node->line);
-    declareVariable(function->name, false, false, chunk, node);
+    declareVariable(function->proto->name, false, false, chunk, node);
+    // Only a function written in an object literal is a method; the others
+    // leave their receiver unnamed so 'this' means the enclosing method's
+    bool is_method = prev_compiler->nested_object_count > prev_compiler->function_object_count;
+    declareVariable(is_method ? "this" : "___this___", false, !is_method, chunk, node);
 
-    if (function->is_generator)
+    if (function->proto->is_generator)
     {
-        Value none = none_val();
-        add_constant_code(function->chunk, none, node->line);
         declareVariable("_value", false, false, chunk, node);
     }
 
     if (node->_Node.Function().body->type == NodeType::OBJECT)
     {
-        generate_bytecode(node->_Node.Function().body->_Node.Object().elements, function->chunk);
-        add_constant_code(function->chunk, none_val(), node->line);
-        add_code(function->chunk, OP_RETURN, node->line);
+        generate_bytecode(node->_Node.Function().body->_Node.Object().elements, function->proto->chunk);
+        add_constant_code(function->proto->chunk, none_val(), node->line);
+        add_code(function->proto->chunk, OP_RETURN, node->line);
     }
     else
     {
-        generate(node->_Node.Function().body, function->chunk);
-        add_code(function->chunk, OP_RETURN, node->line);
+        generate(node->_Node.Function().body, function->proto->chunk);
+        add_code(function->proto->chunk, OP_RETURN, node->line);
     }
 
     // current->in_function = false;
     current->nested_function_count++;
-    function->closed_var_indexes = current->closed_vars;
+    function->proto->closed_var_indexes = current->closed_vars;
 
     current = prev_compiler;
     add_constant_code(chunk, function_value, node->line);
 
-    if (function->closed_var_indexes.size() > 0)
+    if (function->proto->closed_var_indexes.size() > 0)
     {
         add_opcode(chunk, OP_MAKE_CLOSURE, 0, node->line);
     }
 
-    add_opcode(chunk, OP_MAKE_FUNCTION, function->defaults, node->line);
+    add_opcode(chunk, OP_MAKE_FUNCTION, function->proto->defaults, node->line);
 
     // if (function->defaults > 0)
     // {
     //     add_opcode(chunk, OP_MAKE_FUNCTION, function->defaults, node->line);
     // }
 
-    auto offsets = instruction_offsets(function->chunk);
-    function->instruction_offsets = offsets;
+    optimize_chunk(function->proto->chunk);
+    auto offsets = instruction_offsets(function->proto->chunk);
+    function->proto->instruction_offsets = offsets;
 
     // disassemble_chunk(function->chunk, function->name);
 }
 
-void gen_function_call(Chunk &chunk, node_ptr node)
+void gen_function_call(Chunk &chunk, node_ptr node, bool tail)
 {
     for (int i = node->_Node.FunctionCall().args.size() - 1; i >= 0; i--)
     {
@@ -1022,7 +1089,7 @@ void gen_function_call(Chunk &chunk, node_ptr node)
     node_ptr id = std::make_shared<Node>(NodeType::ID);
     id->_Node.ID().value = node->_Node.FunctionCall().name;
     gen_id(chunk, id);
-    add_opcode(chunk, OP_CALL, node->_Node.FunctionCall().args.size(), node->line);
+    add_opcode(chunk, tail ? OP_TAIL_CALL : OP_CALL, node->_Node.FunctionCall().args.size(), node->line);
 }
 
 void gen_type(Chunk &chunk, node_ptr node)
@@ -1042,7 +1109,7 @@ void gen_type(Chunk &chunk, node_ptr node)
     }
 
     std::vector<node_ptr> elements;
-    add_constant_code(chunk, string_val(type_node.name), node->line);
+    add_constant_code(chunk, interned_string_val(type_node.name), node->line);
     if (
         !type_node.body ||
         (type_node.body->type == NodeType::OBJECT && type_node.body->_Node.Object().elements.size() == 0))
@@ -1073,7 +1140,7 @@ void gen_type(Chunk &chunk, node_ptr node)
         {
         case NodeType::ID:
         {
-            add_constant_code(chunk, string_val(elem->_Node.ID().value), node->line);
+            add_constant_code(chunk, interned_string_val(elem->_Node.ID().value), node->line);
             add_constant_code(chunk, type_val("None"), node->line);
             break;
         }
@@ -1092,7 +1159,7 @@ void gen_type(Chunk &chunk, node_ptr node)
                 type_elem = elem;
             }
 
-            add_constant_code(chunk, string_val(type_elem->_Node.Op().left->_Node.ID().value), node->line);
+            add_constant_code(chunk, interned_string_val(type_elem->_Node.Op().left->_Node.ID().value), node->line);
             // Due to how the parser is set up for built-in types, we need to do a conversion here
             NodeType right_type = type_elem->_Node.Op().right->type;
             switch (right_type)
@@ -1152,7 +1219,7 @@ void gen_type(Chunk &chunk, node_ptr node)
     {
         for (auto &def : defaults)
         {
-            add_constant_code(chunk, string_val(def.first), node->line);
+            add_constant_code(chunk, interned_string_val(def.first), node->line);
             generate(def.second, chunk);
         }
         add_opcode(chunk, OP_TYPE_DEFAULTS, defaults.size(), node->line);
@@ -1179,6 +1246,7 @@ void gen_object(Chunk &chunk, node_ptr node)
     if (object_node.elements.size() == 0)
     {
         add_opcode(chunk, OP_MAKE_OBJECT, 0, node->line);
+        current->nested_object_count--;
         return;
     }
 
@@ -1191,6 +1259,37 @@ void gen_object(Chunk &chunk, node_ptr node)
         elements.push_back(object_node.elements[0]);
     }
 
+    // Literals with fixed, distinct keys only push their values and are
+    // built from a shape cached at the site
+    Value shape_keys = list_val();
+    for (auto &elem : elements)
+    {
+        if (elem->type != NodeType::OP || elem->_Node.Op().value != ":" || elem->_Node.Op().left->type != NodeType::ID)
+        {
+            shape_keys.get_list()->clear();
+            break;
+        }
+        std::string key = elem->_Node.Op().left->_Node.ID().value;
+        auto &keys = *shape_keys.get_list();
+        if (std::find_if(keys.begin(), keys.end(), [&](Value &k) { return k.get_string() == key; }) != keys.end())
+        {
+            shape_keys.get_list()->clear();
+            break;
+        }
+        keys.push_back(interned_string_val(key));
+    }
+
+    if (!shape_keys.get_list()->empty() && shape_keys.get_list()->size() <= MAX_SHAPE_KEYS)
+    {
+        for (int i = elements.size() - 1; i >= 0; i--)
+        {
+            generate(elements[i]->_Node.Op().right, chunk);
+        }
+        add_opcode(chunk, OP_MAKE_SHAPED_OBJECT, add_property_cache(chunk, shape_keys), node->line);
+        current->nested_object_count--;
+        return;
+    }
+
     // for (auto &elem : elements)
     for (int i = elements.size() - 1; i >= 0; i--)
     {
@@ -1207,7 +1306,7 @@ void gen_object(Chunk &chunk, node_ptr node)
         }
         if (elem->_Node.Op().left->type == NodeType::ID)
         {
-            add_constant_code(chunk, string_val(elem->_Node.Op().left->_Node.ID().value), node->line);
+            add_constant_code(chunk, interned_string_val(elem->_Node.Op().left->_Node.ID().value), node->line);
         }
         else
         {
@@ -1291,7 +1390,7 @@ void gen_import(Chunk &chunk, node_ptr node)
 #endif
 #endif
 
-        add_constant_code(chunk, string_val(path), node->line);
+        add_constant_code(chunk, interned_string_val(path), node->line);
     }
     else
     {
@@ -1301,7 +1400,7 @@ void gen_import(Chunk &chunk, node_ptr node)
     if (node->_Node.Import().module->type == NodeType::ID)
     {
         // import x : x
-        add_constant_code(chunk, string_val(node->_Node.Import().module->_Node.ID().value), node->line);
+        add_constant_code(chunk, interned_string_val(node->_Node.Import().module->_Node.ID().value), node->line);
         declareVariable(node->_Node.Import().module->_Node.ID().value, true, false, chunk, node);
         add_opcode(chunk, OP_IMPORT, 0, node->line);
     }
@@ -1336,7 +1435,7 @@ void gen_import(Chunk &chunk, node_ptr node)
             {
                 error("Import variables must be identifiers", chunk, node);
             }
-            add_constant_code(chunk, string_val(elem->_Node.ID().value), node->line);
+            add_constant_code(chunk, interned_string_val(elem->_Node.ID().value), node->line);
             declareVariable(elem->_Node.ID().value, false, false, chunk, node);
         }
         add_opcode(chunk, OP_IMPORT, elements.size(), node->line);
@@ -13,6 +13,16 @@ struct Variable
     bool is_internal = false;
 };
 
+// A loop being compiled. break and continue drop the stack back to the
+// `depth` locals that were live when the loop started, then jump to the
+// targets patched in once the loop's end is known
+struct LoopTargets
+{
+    int depth = 0;
+    std::vector<int> break_jumps;
+    std::vector<int> continue_jumps;
+};
+
 struct Compiler
 {
     std::string name;
@@ -26,6 +36,9 @@ struct Compiler
     int nested_object_count = 0;
     int nested_loop_count = 0;
     int nested_function_count = 0;
+    /* nested_object_count when the function began */
+    int function_object_count = 0;
+    std::vector<LoopTargets> loops;
     // std::vector<int> closed_vars;
     std::vector<ClosedVar> closed_vars;
     std::shared_ptr<Compiler> prev;
@@ -66,11 +79,11 @@ void gen_or(Chunk &chunk, node_ptr node);
 void gen_break(Chunk &chunk, node_ptr node);
 void gen_continue(Chunk &chunk, node_ptr node);
 void gen_function(Chunk &chunk, node_ptr node);
-void gen_function_call(Chunk &chunk, node_ptr node);
+void gen_function_call(Chunk &chunk, node_ptr node, bool tail = false);
 void gen_type(Chunk &chunk, node_ptr node);
 void gen_typed_object(Chunk &chunk, node_ptr node);
 void gen_object(Chunk &chunk, node_ptr node);
-void gen_dot(Chunk &chunk, node_ptr node);
+void gen_dot(Chunk &chunk, node_ptr node, bool tail = false);
 void gen_hook(Chunk &chunk, node_ptr node);
 void gen_import(Chunk &chunk, node_ptr node);
 
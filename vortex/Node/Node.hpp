@@ -236,6 +236,7 @@ struct ReturnNode {
 
 struct YieldNode {
 	node_ptr value;
+	bool delegate = false;
 };
 
 struct MetaInformation {
@@ -1,5 +1,7 @@
 #include "Parser.hpp"
 
+bool Parser::legacy = false;
+
 void Parser::advance(int n)
 {
     index += n;
@@ -195,18 +197,7 @@ void Parser::parse_equals(std::string end)
             current_node->_Node.Op().right = right;
             erase_next();
             erase_prev();
-
-            if (current_node->_Node.Op().right->type == NodeType::FUNC)
-            {
-                if (left->type == NodeType::ID)
-                {
-                    current_node->_Node.Op().right->_Node.Function().name = left->_Node.ID().value;
-                }
-                else if (left->type == NodeType::OP && left->_Node.Op().value == ".")
-                {
-                    current_node->_Node.Op().right->_Node.Function().name = left->_Node.Op().right->_Node.ID().value;
-                }
-            }
+            name_function(current_node);
         }
         advance();
     }
@@ -228,18 +219,7 @@ void Parser::parse_colon(std::string end)
             current_node->_Node.Op().right = right;
             erase_next();
             erase_prev();
-
-            if (current_node->_Node.Op().right->type == NodeType::FUNC)
-            {
-                if (left->type == NodeType::ID)
-                {
-                    current_node->_Node.Op().right->_Node.Function().name = left->_Node.ID().value;
-                }
-                else
-                {
-                    current_node->_Node.Op().right->_Node.Function().name = left->_Node.String().value;
-                }
-            }
+            name_function(current_node);
         }
         advance();
     }
@@ -260,7 +240,7 @@ void Parser::parse_list(std::string end)
             int curr_idx = index;
             int closing_index = find_closing_index(index, "[", "]");
             advance();
-            parse(index, "]");
+            parse_passes(index, "]");
             advance(-1);
             while (true)
             {
@@ -298,7 +278,7 @@ void Parser::parse_object(std::string end)
             int curr_idx = index;
             int closing_index = find_closing_index(index, "{", "}");
             advance();
-            parse(index, "}");
+            parse_passes(index, "}");
             advance(-1);
             while (true)
             {
@@ -374,76 +354,8 @@ void Parser::parse_type(std::string end)
 
         if (current_node->type == NodeType::ID && current_node->_Node.ID().value == "type")
         {
-            node_ptr next = peek();
-            if (next->type == NodeType::OP && next->_Node.Op().value == "=")
-            {
-                current_node->type = NodeType::TYPE;
-                current_node->_Node = TypeNode();
-
-                node_ptr name;
-                node_ptr parametric_list;
-
-                if (next->_Node.Op().left->type == NodeType::ACCESSOR)
-                {
-                    name = next->_Node.Op().left->_Node.Accessor().container;
-                    parametric_list = next->_Node.Op().left->_Node.Accessor().accessor;
-                }
-                else if (next->_Node.Op().left->type == NodeType::ID)
-                {
-                    name = next->_Node.Op().left;
-                }
-                else
-                {
-                    error_and_exit("Malformed type definition");
-                }
-
-                current_node->_Node.Type().name = name->_Node.ID().value;
-                current_node->_Node.Type().body = next->_Node.Op().right;
-                erase_next();
-
-                if (parametric_list)
-                {
-                    current_node->_Node.Type().parametric_type = true;
-                    if (parametric_list->_Node.List().elements.size() == 1 && parametric_list->_Node.List().elements[0]->type == NodeType::COMMA_LIST)
-                    {
-                        parametric_list = parametric_list->_Node.List().elements[0];
-                    }
-                    for (node_ptr &param : parametric_list->_Node.List().elements)
-                    {
-                        if (param->type == NodeType::OP && param->_Node.Op().value == ":")
-                        {
-                            node_ptr param_name = param->_Node.Op().left;
-                            if (param_name->type != NodeType::ID)
-                            {
-                                error_and_exit("Parametric type must be an identifier");
-                            }
-                            current_node->_Node.Type().params.push_back(param_name);
-                            current_node->_Node.Type().param_types[param_name->_Node.ID().value] = param->_Node.Op().right;
-                        }
-                        else if (param->type == NodeType::ID)
-                        {
-                            current_node->_Node.Type().params.push_back(param);
-                        }
-                        else
-                        {
-                            error_and_exit("Malformed parametric type definition");
-                        }
-                    }
-                }
-            }
-            else
-            {
-                current_node->type = NodeType::TYPE;
-                current_node->_Node = TypeNode();
-                node_ptr name = peek();
-                if (name->type != NodeType::ID)
-                {
-                    error_and_exit("Type definition expects a name");
-                }
-                current_node->_Node.Type().name = name->_Node.ID().value;
-                current_node->TypeInfo.is_decl = true;
-                erase_next();
-            }
+            build_type(current_node, peek());
+            erase_next();
         }
         advance();
     }
@@ -481,15 +393,13 @@ void Parser::parse_func_def(std::string end)
         }
         if (current_node->type == NodeType::OP && current_node->_Node.Op().value == "=>" && peek()->type != NodeType::END_OF_FILE)
         {
-            current_node->type = NodeType::FUNC;
-            current_node->_Node = FuncNode();
-
             node_ptr params_node;
+            node_ptr return_type;
 
             if (peek(-2)->type == NodeType::OP && peek(-2)->_Node.Op().value == ":" && peek(-3)->type == NodeType::PAREN)
             {
                 params_node = peek(-3);
-                current_node->_Node.Function().return_type = peek(-1);
+                return_type = peek(-1);
                 erase_prev();
                 erase_prev();
                 erase_prev();
@@ -500,147 +410,9 @@ void Parser::parse_func_def(std::string end)
                 erase_prev();
             }
 
-            current_node->_Node.Function().body = peek(1);
+            node_ptr body = peek(1);
             erase_next();
-
-            if (current_node->_Node.Function().body->type == NodeType::OBJECT && current_node->_Node.Function().body->_Node.Object().contains_yield)
-            {
-                current_node->_Node.Function().is_generator = true;
-            }
-
-            if (params_node->type == NodeType::PAREN)
-            {
-                node_ptr params = params_node;
-
-                if (params->type == NodeType::PAREN && params->_Node.Paren().elements.size() == 0)
-                {
-                    node_ptr list = new_node(NodeType::LIST);
-                    list->_Node = ListNode();
-                    list->type = NodeType::COMMA_LIST;
-                    params->_Node.Paren().elements.push_back(list);
-                }
-
-                else if (params->type == NodeType::PAREN && params->_Node.Paren().elements.size() == 1 && params->_Node.Paren().elements[0]->type != NodeType::COMMA_LIST)
-                {
-                    node_ptr list = new_node(NodeType::LIST);
-                    list->_Node = ListNode();
-                    list->type = NodeType::COMMA_LIST;
-                    list->_Node.List().elements.push_back(params->_Node.Paren().elements[0]);
-                    params->_Node.Paren().elements[0] = list;
-                }
-
-                int elem_count = -1;
-
-                for (node_ptr &elem : params->_Node.Paren().elements[0]->_Node.List().elements)
-                {
-
-                    elem_count++;
-
-                    // ...args
-                    if (elem->type == NodeType::OP && elem->_Node.Op().value == "...")
-                    {
-                        if (elem_count < params->_Node.Paren().elements[0]->_Node.List().elements.size() - 1)
-                        {
-                            error_and_exit("Argument captures (...) must be defined last");
-                        }
-                        node_ptr param_name = elem->_Node.Op().right;
-                        param_name->Meta.tags.push_back("capture");
-                        elem = param_name;
-                    }
-                    // x: String
-                    if (elem->type == NodeType::OP && elem->_Node.Op().value == ":")
-                    {
-
-                        // Check if we already have defaults, if we do, we raise an error
-                        // Because we can't have non-default params after default params
-
-                        if (current_node->_Node.Function().default_values.size() > 0)
-                        {
-                            error_and_exit("Cannot define non-default parameters after default parameters");
-                        }
-
-                        node_ptr param_name = elem->_Node.Op().left;
-                        node_ptr param_type = elem->_Node.Op().right;
-
-                        if (param_name->type != NodeType::ID)
-                        {
-                            error_and_exit("Parameter names must be identifiers");
-                        }
-
-                        current_node->_Node.Function().params.push_back(param_name);
-
-                        current_node->_Node.Function().param_types[param_name->_Node.ID().value] = param_type;
-                    }
-                    // x: String = "hi"
-                    else if (elem->type == NodeType::OP && elem->_Node.Op().value == "=")
-                    {
-                        node_ptr left = elem->_Node.Op().left;
-                        node_ptr param_name;
-                        node_ptr param_type;
-                        node_ptr default_value = elem->_Node.Op().right;
-
-                        if (left->type == NodeType::ID)
-                        {
-                            param_name = left;
-                        }
-                        else if (left->type == NodeType::OP && left->_Node.Op().value == ":")
-                        {
-                            param_name = left->_Node.Op().left;
-                            param_type = left->_Node.Op().right;
-                        }
-
-                        if (param_name->type != NodeType::ID)
-                        {
-                            error_and_exit("Parameter names must be identifiers");
-                        }
-
-                        current_node->_Node.Function().params.push_back(param_name);
-
-                        if (param_type)
-                        {
-                            current_node->_Node.Function().param_types[param_name->_Node.ID().value] = param_type;
-                        }
-                        else
-                        {
-                            current_node->_Node.Function().param_types[param_name->_Node.ID().value] = new_node(NodeType::ANY);
-                        }
-
-                        current_node->_Node.Function().default_values[param_name->_Node.ID().value] = default_value;
-                        current_node->_Node.Function().default_values_ordered.push_back(default_value);
-                    }
-                    else if (elem->type == NodeType::ID)
-                    {
-
-                        // Check if we already have defaults, if we do, we raise an error
-                        // Because we can't have non-default params after default params
-
-                        if (current_node->_Node.Function().default_values.size() > 0)
-                        {
-                            error_and_exit("Cannot define non-default parameters after default parameters");
-                        }
-
-                        node_ptr param_name = elem;
-                        node_ptr param_type = new_node(NodeType::ANY);
-
-                        current_node->_Node.Function().params.push_back(param_name);
-                        current_node->_Node.Function().param_types[param_name->_Node.ID().value] = param_type;
-                    }
-
-                    current_node->_Node.Function().args.push_back(nullptr);
-                }
-            }
-
-            if (current_node->type == NodeType::FUNC && current_node->_Node.Function().body->type == NodeType::OBJECT)
-            {
-                for (int i = 0; i < current_node->_Node.Function().body->_Node.Object().elements.size(); i++)
-                {
-                    auto &elem = current_node->_Node.Function().body->_Node.Object().elements[i];
-                    if (elem->type == NodeType::OP && elem->_Node.Op().value == ";")
-                    {
-                        current_node->_Node.Function().body->_Node.Object().elements.erase(current_node->_Node.Function().body->_Node.Object().elements.begin() + i);
-                    }
-                }
-            }
+            build_func_def(current_node, params_node, return_type, body);
         }
         advance();
     }
@@ -661,7 +433,7 @@ void Parser::parse_paren(std::string end)
             int curr_idx = index;
             int closing_index = find_closing_index(index, "(", ")");
             advance();
-            parse(index, ")");
+            parse_passes(index, ")");
             advance(-1);
             while (true)
             {
@@ -702,15 +474,7 @@ void Parser::parse_func_call(std::string end)
             current_node->type = NodeType::FUNC_CALL;
             current_node->_Node = FuncCallNode();
             current_node->_Node.FunctionCall().name = name;
-            node_ptr argsList = peek();
-            if (argsList->_Node.Paren().elements.size() == 1 && argsList->_Node.Paren().elements[0]->type == NodeType::COMMA_LIST)
-            {
-                current_node->_Node.FunctionCall().args = argsList->_Node.Paren().elements[0]->_Node.List().elements;
-            }
-            else if (argsList->_Node.Paren().elements.size() == 1)
-            {
-                current_node->_Node.FunctionCall().args.push_back(argsList->_Node.Paren().elements[0]);
-            }
+            build_func_call_args(current_node, peek());
             erase_next();
         }
         else if (current_node->type == NodeType::PAREN && current_node->_Node.Paren().elements.size() == 1 && peek()->type == NodeType::PAREN)
@@ -719,15 +483,7 @@ void Parser::parse_func_call(std::string end)
             current_node->type = NodeType::FUNC_CALL;
             current_node->_Node = FuncCallNode();
             current_node->_Node.FunctionCall().inline_func = func;
-            node_ptr argsList = peek();
-            if (argsList->_Node.Paren().elements.size() == 1 && argsList->_Node.Paren().elements[0]->type == NodeType::COMMA_LIST)
-            {
-                current_node->_Node.FunctionCall().args = argsList->_Node.Paren().elements[0]->_Node.List().elements;
-            }
-            else if (argsList->_Node.Paren().elements.size() == 1)
-            {
-                current_node->_Node.FunctionCall().args.push_back(argsList->_Node.Paren().elements[0]);
-            }
+            build_func_call_args(current_node, peek());
             erase_next();
         }
         advance();
@@ -806,60 +562,9 @@ void Parser::parse_var(std::string end)
             break;
         }
 
-        if (current_node->type == NodeType::ID && current_node->_Node.ID().value == "var")
+        if (current_node->type == NodeType::ID && current_node->_Node.ID().value == "var" && build_var(current_node, peek()))
         {
-            node_ptr next = peek();
-            if (next->type == NodeType::ID)
-            {
-                current_node->type = NodeType::VARIABLE_DECLARATION;
-                current_node->_Node = VariableDeclatationNode();
-                current_node->_Node.VariableDeclaration().name = next->_Node.ID().value;
-                current_node->_Node.VariableDeclaration().value = new_node(NodeType::NONE);
-                erase_next();
-            }
-            else if (next->type == NodeType::OP && next->_Node.Op().value == "=")
-            {
-                current_node->type = NodeType::VARIABLE_DECLARATION;
-                current_node->_Node = VariableDeclatationNode();
-                if (next->_Node.Op().left->type == NodeType::OP && next->_Node.Op().left->_Node.Op().value == ":")
-                {
-                    node_ptr typed_var = next->_Node.Op().left;
-                    if (typed_var->_Node.Op().left->type != NodeType::ID)
-                    {
-                        error_and_exit("Malformed declaration");
-                    }
-                    current_node->_Node.VariableDeclaration().name = typed_var->_Node.Op().left->_Node.ID().value;
-                    current_node->_Node.VariableDeclaration().value = next->_Node.Op().right;
-                    current_node->_Node.VariableDeclaration().type = typed_var->_Node.Op().right;
-                }
-                else
-                {
-                    if (next->_Node.Op().left->type != NodeType::ID)
-                    {
-                        error_and_exit("Malformed declaration");
-                    }
-                    current_node->_Node.VariableDeclaration().name = next->_Node.Op().left->_Node.ID().value;
-                    current_node->_Node.VariableDeclaration().value = next->_Node.Op().right;
-                }
-                erase_next();
-            }
-            else if (next->type == NodeType::OP && next->_Node.Op().value == ":")
-            {
-                current_node->type = NodeType::VARIABLE_DECLARATION;
-                current_node->_Node = VariableDeclatationNode();
-                current_node->_Node.VariableDeclaration().name = next->_Node.Op().left->_Node.ID().value;
-                current_node->_Node.VariableDeclaration().type = next->_Node.Op().right;
-
-                if (current_node->_Node.VariableDeclaration().type->type == NodeType::ANY)
-                {
-                    current_node->_Node.VariableDeclaration().value = new_node(NodeType::ANY);
-                }
-                else
-                {
-                    current_node->_Node.VariableDeclaration().value = new_node(NodeType::NONE);
-                }
-                erase_next();
-            }
+            erase_next();
         }
         advance();
     }
@@ -876,37 +581,8 @@ void Parser::parse_const(std::string end)
 
         if (current_node->type == NodeType::ID && current_node->_Node.ID().value == "const")
         {
-            node_ptr next = peek();
-            if (next->type == NodeType::OP && next->_Node.Op().value == "=")
-            {
-                current_node->type = NodeType::CONSTANT_DECLARATION;
-                current_node->_Node = ConstantDeclatationNode();
-                if (next->_Node.Op().left->type == NodeType::OP && next->_Node.Op().left->_Node.Op().value == ":")
-                {
-                    node_ptr typed_var = next->_Node.Op().left;
-                    if (typed_var->_Node.Op().left->type != NodeType::ID)
-                    {
-                        error_and_exit("Malformed declaration");
-                    }
-                    current_node->_Node.ConstantDeclatation().name = typed_var->_Node.Op().left->_Node.ID().value;
-                    current_node->_Node.ConstantDeclatation().value = next->_Node.Op().right;
-                    current_node->_Node.ConstantDeclatation().type = typed_var->_Node.Op().right;
-                }
-                else
-                {
-                    if (next->_Node.Op().left->type != NodeType::ID)
-                    {
-                        error_and_exit("Malformed declaration");
-                    }
-                    current_node->_Node.ConstantDeclatation().name = next->_Node.Op().left->_Node.ID().value;
-                    current_node->_Node.ConstantDeclatation().value = next->_Node.Op().right;
-                }
-                erase_next();
-            }
-            else
-            {
-                error_and_exit("Const declaration expects a value");
-            }
+            build_const(current_node, peek());
+            erase_next();
         }
         advance();
     }
@@ -923,24 +599,8 @@ void Parser::parse_import(std::string end)
 
         if (current_node->type == NodeType::ID && current_node->_Node.ID().value == "import")
         {
-            current_node->type = NodeType::IMPORT;
-            current_node->_Node = ImportNode();
-            if (peek()->type == NodeType::OP && peek()->_Node.Op().value == ":")
-            {
-                current_node->_Node.Import().module = peek()->_Node.Op().left;
-                current_node->_Node.Import().target = peek()->_Node.Op().right;
-                erase_next();
-            }
-            else if (peek()->type == NodeType::ID)
-            {
-                current_node->_Node.Import().module = peek();
-                current_node->_Node.Import().is_default = true;
-                erase_next();
-            }
-            else
-            {
-                error_and_exit("Malformed import statement");
-            }
+            build_import(current_node, peek());
+            erase_next();
         }
         advance();
     }
@@ -957,96 +617,7 @@ void Parser::parse_tag(std::string end)
 
         if (current_node->type == NodeType::OP && current_node->_Node.Op().value == "@")
         {
-            // node_ptr tag = current_node->_Node.Op().right;
-            // std::vector<std::string> tags;
-            // if (tag->type == NodeType::ID) {
-            //     tags.push_back(tag->_Node.ID().value);
-            // } else if (tag->type == NodeType::LIST) {
-            //     if (tag->_Node.List().elements.size() == 1 && tag->_Node.List().elements[0]->type == NodeType::COMMA_LIST) {
-            //         tag = tag->_Node.List().elements[0];
-            //     }
-            //     for (node_ptr& t : tag->_Node.List().elements) {
-            //         if (t->type != NodeType::ID) {
-            //             error_and_exit("Tags must be identifiers");
-            //         }
-            //         tags.push_back(t->_Node.ID().value);
-            //     }
-            // } else {
-            //     error_and_exit("Tag must be an identifier");
-            // }
-
-            node_ptr tag = current_node->_Node.Op().right;
-            std::vector<node_ptr> tags;
-            if (tag->type == NodeType::LIST)
-            {
-                if (tag->_Node.List().elements.size() == 1 && tag->_Node.List().elements[0]->type == NodeType::COMMA_LIST)
-                {
-                    tag = tag->_Node.List().elements[0];
-                }
-                for (node_ptr &t : tag->_Node.List().elements)
-                {
-                    tags.push_back(t);
-                }
-            }
-            else
-            {
-                tags.push_back(tag);
-            }
-
-            node_ptr next = peek();
-
-            // if (next->type == NodeType::CONSTANT_DECLARATION) {
-            //     for (std::string tag : tags) {
-            //         next->_Node.ConstantDeclatation().value->Meta.tags.push_back(tag);
-            //     }
-            // } else if (next->type == NodeType::VARIABLE_DECLARATION) {
-            //     if (next->_Node.VariableDeclaration().value) {
-            //         for (std::string tag : tags) {
-            //             next->_Node.VariableDeclaration().value->Meta.tags.push_back(tag);
-            //         }
-            //     }
-            // } else if (next->type == NodeType::OP && (next->_Node.Op().value == "." || next->_Node.Op().value == ":")) {
-            //     for (std::string tag : tags) {
-            //         next->_Node.Op().right->Meta.tags.push_back(tag);
-            //     }
-            // } else {
-            //     for (std::string tag : tags) {
-            //         next->Meta.tags.push_back(tag);
-            //     }
-            // }
-
-            if (next->type == NodeType::CONSTANT_DECLARATION)
-            {
-                for (node_ptr &tag : tags)
-                {
-                    next->_Node.ConstantDeclatation().value->Meta.decorators.push_back(tag);
-                }
-            }
-            else if (next->type == NodeType::VARIABLE_DECLARATION)
-            {
-                if (next->_Node.VariableDeclaration().value)
-                {
-                    for (node_ptr &tag : tags)
-                    {
-                        next->_Node.VariableDeclaration().value->Meta.decorators.push_back(tag);
-                    }
-                }
-            }
-            else if (next->type == NodeType::OP && (next->_Node.Op().value == "." || next->_Node.Op().value == ":"))
-            {
-                for (node_ptr &tag : tags)
-                {
-                    next->_Node.Op().right->Meta.decorators.push_back(tag);
-                }
-            }
-            else
-            {
-                for (node_ptr &tag : tags)
-                {
-                    next->Meta.decorators.push_back(tag);
-                }
-            }
-
+            build_tags(current_node, peek());
             erase_curr();
         }
         advance();
@@ -1064,64 +635,7 @@ void Parser::parse_for_loop(std::string end)
 
         if (current_node->type == NodeType::ID && current_node->_Node.ID().value == "for")
         {
-            current_node->type = NodeType::FOR_LOOP;
-            current_node->_Node = ForLoopNode();
-            if (peek()->type != NodeType::PAREN && peek(2)->type != NodeType::OBJECT)
-            {
-                error_and_exit("Malformed for loop");
-            }
-
-            node_ptr for_loop_config = peek();
-
-            if (for_loop_config->_Node.Paren().elements.size() == 0 || for_loop_config->_Node.Paren().elements.size() > 3)
-            {
-                error_and_exit("For loop constructor expects 1, 2 or 3 elements");
-            }
-
-            if (for_loop_config->_Node.Paren().elements[0]->type == NodeType::COMMA_LIST)
-            {
-                for_loop_config->_Node.Paren().elements = for_loop_config->_Node.Paren().elements[0]->_Node.List().elements;
-            }
-
-            if (for_loop_config->_Node.Paren().elements.size() > 0)
-            {
-                if (for_loop_config->_Node.Paren().elements[0]->type == NodeType::NUMBER)
-                {
-                    current_node->_Node.ForLoop().start = new_number_node(0);
-                    current_node->_Node.ForLoop().end = for_loop_config->_Node.Paren().elements[0];
-                }
-                else if (for_loop_config->_Node.Paren().elements[0]->type == NodeType::OP && for_loop_config->_Node.Paren().elements[0]->_Node.Op().value == "..")
-                {
-                    current_node->_Node.ForLoop().start = for_loop_config->_Node.Paren().elements[0]->_Node.Op().left;
-                    current_node->_Node.ForLoop().end = for_loop_config->_Node.Paren().elements[0]->_Node.Op().right;
-                }
-                else
-                {
-                    current_node->_Node.ForLoop().iterator = for_loop_config->_Node.Paren().elements[0];
-                }
-            }
-
-            if (for_loop_config->_Node.Paren().elements.size() > 1)
-            {
-                if (for_loop_config->_Node.Paren().elements[1]->type != NodeType::ID)
-                {
-                    error_and_exit("Index variable in for loop must be an identifier");
-                }
-
-                current_node->_Node.ForLoop().index_name = for_loop_config->_Node.Paren().elements[1];
-            }
-
-            if (for_loop_config->_Node.Paren().elements.size() > 2)
-            {
-                if (for_loop_config->_Node.Paren().elements[2]->type != NodeType::ID)
-                {
-                    error_and_exit("Value variable in for loop must be an identifier");
-                }
-
-                current_node->_Node.ForLoop().value_name = for_loop_config->_Node.Paren().elements[2];
-            }
-
-            current_node->_Node.ForLoop().body = peek(2);
+            build_for_loop(current_node, peek(), peek(2));
             erase_next();
             erase_next();
         }
@@ -1140,22 +654,7 @@ void Parser::parse_while_loop(std::string end)
 
         if (current_node->type == NodeType::ID && current_node->_Node.ID().value == "while")
         {
-            current_node->type = NodeType::WHILE_LOOP;
-            current_node->_Node = WhileLoopNode();
-            if (peek()->type != NodeType::PAREN && peek(2)->type != NodeType::OBJECT)
-            {
-                error_and_exit("Malformed while loop");
-            }
-
-            node_ptr while_loop_config = peek();
-
-            if (while_loop_config->_Node.Paren().elements.size() != 1)
-            {
-                error_and_exit("While loop constructor expects 1 element");
-            }
-
-            current_node->_Node.WhileLoop().condition = while_loop_config->_Node.Paren().elements[0];
-            current_node->_Node.WhileLoop().body = peek(2);
+            build_while_loop(current_node, peek(), peek(2));
             erase_next();
             erase_next();
         }
@@ -1174,22 +673,7 @@ void Parser::parse_if_statement(std::string end)
 
         if (current_node->type == NodeType::ID && current_node->_Node.ID().value == "if")
         {
-            current_node->type = NodeType::IF_STATEMENT;
-            current_node->_Node = IfStatementNode();
-            if (peek()->type != NodeType::PAREN && peek(2)->type != NodeType::OBJECT)
-            {
-                error_and_exit("Malformed if statement");
-            }
-
-            node_ptr conditional = peek();
-
-            if (conditional->_Node.Paren().elements.size() != 1)
-            {
-                error_and_exit("If statement expects 1 conditional statement");
-            }
-
-            current_node->_Node.IfStatement().condition = conditional->_Node.Paren().elements[0];
-            current_node->_Node.IfStatement().body = peek(2);
+            build_if_statement(current_node, peek(), peek(2));
             erase_next();
             erase_next();
         }
@@ -1208,34 +692,7 @@ void Parser::parse_try_catch(std::string end)
 
         if (current_node->type == NodeType::ID && current_node->_Node.ID().value == "try")
         {
-            node_ptr try_block = peek();
-            if (try_block->type != NodeType::OBJECT)
-            {
-                error_and_exit("Malformed try-catch expression - missing 'try' block");
-            }
-            node_ptr catch_keyword = peek(2);
-            if (catch_keyword->type != NodeType::FUNC_CALL || catch_keyword->_Node.FunctionCall().name != "catch")
-            {
-                error_and_exit("Malformed try-catch expression - missing 'catch' block");
-            }
-            if (catch_keyword->_Node.FunctionCall().args.size() != 1)
-            {
-                error_and_exit("Malformed try-catch expression - 'catch' expects one argument");
-            }
-            if (catch_keyword->_Node.FunctionCall().args[0]->type != NodeType::ID)
-            {
-                error_and_exit("Malformed try-catch expression - 'catch' expects argument to be an identifier");
-            }
-            node_ptr catch_block = peek(3);
-            if (catch_block->type != NodeType::OBJECT)
-            {
-                error_and_exit("Malformed try-catch expression - missing 'catch' block");
-            }
-            current_node->type = NodeType::TRY_CATCH;
-            current_node->_Node = TryCatchNode();
-            current_node->_Node.TryCatch().try_body = try_block;
-            current_node->_Node.TryCatch().catch_keyword = catch_keyword;
-            current_node->_Node.TryCatch().catch_body = catch_block;
+            build_try_catch(current_node, peek(), peek(2), peek(3));
             erase_next();
             erase_next();
             erase_next();
@@ -1255,33 +712,7 @@ void Parser::parse_if_block(std::string end)
 
         if (current_node->type == NodeType::ID && current_node->_Node.ID().value == "else")
         {
-            current_node->type = NodeType::IF_BLOCK;
-            current_node->_Node = IfBlockNode();
-            node_ptr prev = peek(-1);
-            node_ptr next = peek();
-            if (prev->type != NodeType::IF_STATEMENT && prev->type != NodeType::IF_BLOCK)
-            {
-                error_and_exit("Malformed if block");
-            }
-            else if (next->type != NodeType::IF_STATEMENT && next->type != NodeType::OBJECT)
-            {
-                error_and_exit("Malformed if block");
-            }
-
-            if (prev->type == NodeType::IF_BLOCK)
-            {
-                for (node_ptr &statement : prev->_Node.IfBlock().statements)
-                {
-                    current_node->_Node.IfBlock().statements.push_back(statement);
-                }
-            }
-            else
-            {
-                current_node->_Node.IfBlock().statements.push_back(prev);
-            }
-
-            current_node->_Node.IfBlock().statements.push_back(next);
-
+            build_if_block(current_node, peek(-1), peek());
             erase_prev();
             erase_next();
         }
@@ -1326,10 +757,12 @@ void Parser::parse_yield(std::string end)
             break;
         }
 
-        if (current_node->type == NodeType::ID && current_node->_Node.ID().value == "yield")
+        bool delegate = current_node->type == NodeType::YIELD && current_node->_Node.Yield().delegate && !current_node->_Node.Yield().value;
+        if (delegate || (current_node->type == NodeType::ID && current_node->_Node.ID().value == "yield"))
         {
             current_node->type = NodeType::YIELD;
             current_node->_Node = YieldNode();
+            current_node->_Node.Yield().delegate = delegate;
             for (auto &object : nested_objects)
             {
                 object->_Node.Object().contains_yield = true;
@@ -1349,7 +782,33 @@ void Parser::parse_yield(std::string end)
     }
 }
 
-void Parser::parse_keywords(std::string end)
+static bool starts_operand(const node_ptr &node);
+
+// 'yield from gen' delegates to gen, unless 'from' is a variable. The
+// from goes before the later passes can take it for an operand, and
+// parse_yield gives the marked yield its value.
+void Parser::parse_yield_from(std::string end)
+{
+    while (current_node->type != NodeType::END_OF_FILE)
+    {
+        if (current_node->type == NodeType::OP && current_node->_Node.Op().value == end)
+        {
+            break;
+        }
+        if (current_node->type == NodeType::ID && current_node->_Node.ID().value == "yield" &&
+            peek()->type == NodeType::ID && peek()->_Node.ID().value == "from" &&
+            peek(2)->line == peek()->line && starts_operand(peek(2)))
+        {
+            current_node->type = NodeType::YIELD;
+            current_node->_Node = YieldNode();
+            current_node->_Node.Yield().delegate = true;
+            erase_next();
+        }
+        advance();
+    }
+}
+
+void Parser::parse_keywords(std::string end)
 {
     while (current_node->type != NodeType::END_OF_FILE)
     {
@@ -1360,117 +819,7 @@ void Parser::parse_keywords(std::string end)
 
         if (current_node->type == NodeType::ID)
         {
-            if (current_node->_Node.ID().value == "break")
-            {
-                current_node->type = NodeType::BREAK;
-            }
-            else if (current_node->_Node.ID().value == "continue")
-            {
-                current_node->type = NodeType::CONTINUE;
-            }
-            else if (current_node->_Node.ID().value == "Number")
-            {
-                current_node->type = NodeType::STRING;
-                current_node->_Node = StringNode();
-                current_node->_Node.String().value = "Number";
-                current_node->TypeInfo.is_type = true;
-                // current_node->type = NodeType::NUMBER;
-                // current_node->_Node = NumberNode();
-                // current_node->TypeInfo.is_type = true;
-            }
-            else if (current_node->_Node.ID().value == "String")
-            {
-                current_node->type = NodeType::STRING;
-                current_node->_Node = StringNode();
-                current_node->_Node.String().value = "String";
-                current_node->TypeInfo.is_type = true;
-                // current_node->type = NodeType::STRING;
-                // current_node->_Node = StringNode();
-                // current_node->TypeInfo.is_type = true;
-            }
-            else if (current_node->_Node.ID().value == "Boolean")
-            {
-                current_node->type = NodeType::STRING;
-                current_node->_Node = StringNode();
-                current_node->_Node.String().value = "Boolean";
-                current_node->TypeInfo.is_type = true;
-                // current_node->type = NodeType::BOOLEAN;
-                // current_node->_Node = BooleanNode();
-                // current_node->TypeInfo.is_type = true;
-            }
-            else if (current_node->_Node.ID().value == "List")
-            {
-                current_node->type = NodeType::STRING;
-                current_node->_Node = StringNode();
-                current_node->_Node.String().value = "List";
-                current_node->TypeInfo.is_type = true;
-                // current_node->type = NodeType::LIST;
-                // current_node->_Node = ListNode();
-                // current_node->TypeInfo.is_type = true;
-                // current_node->TypeInfo.is_general_type = true;
-            }
-            else if (current_node->_Node.ID().value == "Object")
-            {
-                current_node->type = NodeType::STRING;
-                current_node->_Node = StringNode();
-                current_node->_Node.String().value = "Object";
-                current_node->TypeInfo.is_type = true;
-                // current_node->type = NodeType::OBJECT;
-                // current_node->_Node = ObjectNode();
-                // current_node->TypeInfo.is_type = true;
-                // current_node->TypeInfo.is_general_type = true;
-            }
-            else if (current_node->_Node.ID().value == "Function")
-            {
-                current_node->type = NodeType::STRING;
-                current_node->_Node = StringNode();
-                current_node->_Node.String().value = "Function";
-                current_node->TypeInfo.is_type = true;
-                // current_node->type = NodeType::FUNC;
-                // current_node->_Node = FuncNode();
-                // current_node->TypeInfo.is_type = true;
-                // current_node->TypeInfo.is_general_type = true;
-                // current_node->_Node.Function().return_type = new_node(NodeType::ANY);
-            }
-            else if (current_node->_Node.ID().value == "Pointer")
-            {
-                current_node->type = NodeType::STRING;
-                current_node->_Node = StringNode();
-                current_node->_Node.String().value = "Pointer";
-                current_node->TypeInfo.is_type = true;
-                // current_node->type = NodeType::POINTER;
-                // current_node->_Node = PointerNode();
-                // current_node->TypeInfo.is_type = true;
-            }
-            else if (current_node->_Node.ID().value == "Library")
-            {
-                current_node->type = NodeType::STRING;
-                current_node->_Node = StringNode();
-                current_node->_Node.String().value = "Library";
-                current_node->TypeInfo.is_type = true;
-                // current_node->type = NodeType::LIB;
-                // current_node->_Node = LibNode();
-                // current_node->TypeInfo.is_type = true;
-            }
-            else if (current_node->_Node.ID().value == "Any")
-            {
-                current_node->type = NodeType::STRING;
-                current_node->_Node = StringNode();
-                current_node->_Node.String().value = "Any";
-                current_node->TypeInfo.is_type = true;
-                // current_node->type = NodeType::ANY;
-                // current_node->TypeInfo.is_type = true;
-            }
-            // else if (current_node->_Node.ID().value == "Error")
-            // {
-            //     current_node->type = NodeType::STRING;
-            //     current_node->_Node = StringNode();
-            //     current_node->_Node.String().value = "Error";
-            //     current_node->TypeInfo.is_type = true;
-            //     // current_node->type = NodeType::_ERROR;
-            //     // current_node->_Node = ErrorNode();
-            //     // current_node->TypeInfo.is_type = true;
-            // }
+            convert_keyword(current_node);
         }
         advance();
     }
@@ -1508,7 +857,7 @@ void Parser::flatten_pipes(std::string end)
     }
 }
 
-void Parser::parse(int start, std::string end)
+void Parser::parse_passes(int start, std::string end)
 {
     parse_paren(end);
     reset(start);
@@ -1520,6 +869,8 @@ void Parser::parse(int start, std::string end)
     reset(start);
     parse_list(end);
     reset(start);
+    parse_yield_from(end);
+    reset(start);
     parse_keywords(end);
     reset(start);
     parse_for_loop(end);
@@ -1606,130 +957,1608 @@ void Parser::parse(int start, std::string end)
     reset(start);
 }
 
-int Parser::find_closing_index(int start, std::string opening_symbol, std::string closing_symbol)
+void Parser::parse(int start, std::string end)
 {
-    int count = 0;
+    if (legacy)
+    {
+        parse_passes(start, end);
+        return;
+    }
 
-    for (int i = start; i < nodes.size(); i++)
+    reset(start);
+    node_ptr end_of_file = nodes.back();
+    std::vector<node_ptr> ast;
+
+    if (current_node->type == NodeType::START_OF_FILE)
     {
-        if (nodes[i]->type == NodeType::OP && nodes[i]->_Node.Op().value == opening_symbol)
-        {
-            count++;
-        }
-        else if (nodes[i]->type == NodeType::OP && nodes[i]->_Node.Op().value == closing_symbol)
+        ast.push_back(current_node);
+        advance();
+    }
+
+    for (node_ptr &element : parse_sequence(""))
+    {
+        ast.push_back(element);
+    }
+
+    ast.push_back(end_of_file);
+    nodes = ast;
+    reset(start);
+}
+
+// Binding power of each infix operator. The order mirrors the order
+// parse_passes() reduces them in, so both parsers build the same tree;
+// operators of equal power group to the left, as a pass would.
+enum Precedence
+{
+    PREC_NONE,
+    PREC_COMMA,       // ,
+    PREC_ASSIGNMENT,  // =
+    PREC_COLON,       // :
+    PREC_HOOK,        // ::
+    PREC_TEST,        // as is in
+    PREC_FUNC,        // =>
+    PREC_DECONSTRUCT, // Name { ... }
+    PREC_RANGE,       // ..
+    PREC_WORD,        // and or
+    PREC_BITWISE,     // & |
+    PREC_LOGIC,       // && ||
+    PREC_COMPARISON,  // == != <= >= < >
+    PREC_COMPOUND,    // += -=
+    PREC_TERM,        // + -
+    PREC_FACTOR,      // * / %
+    PREC_POWER,       // ^
+    PREC_COALESCE,    // ??
+    PREC_UNARY,       // ! ... @ - + &
+    PREC_DOT          // .
+};
+
+static std::unordered_map<std::string, int> infix_precedences = {
+    {",", PREC_COMMA},
+    {"=", PREC_ASSIGNMENT},
+    {":", PREC_COLON},
+    {"::", PREC_HOOK},
+    {"as", PREC_TEST},
+    {"is", PREC_TEST},
+    {"in", PREC_TEST},
+    {"=>", PREC_FUNC},
+    {"..", PREC_RANGE},
+    {"and", PREC_WORD},
+    {"or", PREC_WORD},
+    {"&", PREC_BITWISE},
+    {"|", PREC_BITWISE},
+    {"&&", PREC_LOGIC},
+    {"||", PREC_LOGIC},
+    {"==", PREC_COMPARISON},
+    {"!=", PREC_COMPARISON},
+    {"<=", PREC_COMPARISON},
+    {">=", PREC_COMPARISON},
+    {"<", PREC_COMPARISON},
+    {">", PREC_COMPARISON},
+    {"+=", PREC_COMPOUND},
+    {"-=", PREC_COMPOUND},
+    {"+", PREC_TERM},
+    {"-", PREC_TERM},
+    {"*", PREC_FACTOR},
+    {"/", PREC_FACTOR},
+    {"%", PREC_FACTOR},
+    {"^", PREC_POWER},
+    {"??", PREC_COALESCE},
+    {".", PREC_DOT},
+};
+
+static bool is_op(const node_ptr &node, const std::string &value)
+{
+    return node->type == NodeType::OP && node->_Node.Op().value == value;
+}
+
+static bool is_opening(const node_ptr &node)
+{
+    return is_op(node, "(") || is_op(node, "[") || is_op(node, "{");
+}
+
+static bool is_closing(const node_ptr &node)
+{
+    return is_op(node, ")") || is_op(node, "]") || is_op(node, "}");
+}
+
+static bool is_prefix_op(const node_ptr &node)
+{
+    return is_op(node, "!") || is_op(node, "...") || is_op(node, "@") || is_op(node, "-") || is_op(node, "+") || is_op(node, "&");
+}
+
+// Whether the token can start an operand, as opposed to being an operator
+// or punctuation the passes would leave without children
+static bool starts_operand(const node_ptr &node)
+{
+    if (node->type == NodeType::END_OF_FILE)
+    {
+        return false;
+    }
+    return node->type != NodeType::OP || is_opening(node) || is_prefix_op(node);
+}
+
+static bool is_id(const node_ptr &node, const std::string &value)
+{
+    return node->type == NodeType::ID && node->_Node.ID().value == value;
+}
+
+std::vector<node_ptr> Parser::parse_sequence(std::string closing)
+{
+    std::vector<node_ptr> elements;
+
+    while (true)
+    {
+        if (pending.empty())
         {
-            count--;
+            if (current_node->type == NodeType::END_OF_FILE)
+            {
+                if (closing != "")
+                {
+                    error_and_exit("Missing end '" + closing + "'");
+                }
+                break;
+            }
+            if (is_op(current_node, closing))
+            {
+                advance();
+                break;
+            }
         }
 
-        if (nodes[i]->type == NodeType::OP && nodes[i]->_Node.Op().value == closing_symbol && count == 0)
+        node_ptr element = parse_element();
+        if (element)
         {
-            return i;
+            elements.push_back(element);
         }
     }
 
-    return 0;
+    return elements;
 }
 
-node_ptr Parser::flatten_comma_node(node_ptr node)
+node_ptr Parser::parse_element()
 {
-    // node->type = NodeType::COMMA_LIST;
-    node_ptr comma_list = new_node(NodeType::LIST);
-    comma_list->type = NodeType::COMMA_LIST;
-
-    if (node->type == NodeType::OP && node->_Node.Op().left->type == NodeType::OP && node->_Node.Op().left->_Node.Op().value == ",")
-    {
-        node->_Node.Op().left = flatten_comma_node(node->_Node.Op().left);
-    }
-    else
+    if (!pending.empty())
     {
-        comma_list->_Node.List().elements.push_back(node->_Node.Op().left);
+        node_ptr node = pending.front();
+        pending.erase(pending.begin());
+        return pending.empty() ? parse_infix(node, PREC_NONE) : node;
     }
 
-    if (node->type == NodeType::OP && node->_Node.Op().left->type == NodeType::COMMA_LIST)
+    node_ptr node = current_node;
+
+    // Tags decorate whatever element follows them
+    if (is_op(node, "@"))
     {
-        for (auto &child_node : node->_Node.Op().left->_Node.List().elements)
+        advance();
+        node->_Node.Op().right = parse_expression(PREC_UNARY);
+        if (pending.empty() && (current_node->type == NodeType::END_OF_FILE || is_closing(current_node)))
         {
-            comma_list->_Node.List().elements.push_back(child_node);
+            return nullptr;
+        }
+        node_ptr next = parse_element();
+        if (next)
+        {
+            build_tags(node, next);
         }
+        return next;
     }
 
-    if (node->type == NodeType::OP && node->_Node.Op().right->type == NodeType::OP && node->_Node.Op().right->_Node.Op().value == ",")
+    // Operators with nothing to apply to stay in the tree as they are
+    if (node->type == NodeType::OP && !starts_operand(node))
     {
-        node->_Node.Op().right = flatten_comma_node(node->_Node.Op().right);
+        advance();
+        return node;
     }
-    else
+
+    return parse_expression(PREC_NONE);
+}
+
+node_ptr Parser::parse_expression(int precedence)
+{
+    node_ptr left = parse_prefix(precedence);
+
+    if (left->type == NodeType::OP && !has_children(left))
     {
-        comma_list->_Node.List().elements.push_back(node->_Node.Op().right);
+        return left;
     }
 
-    if (node->type == NodeType::OP && node->_Node.Op().right->type == NodeType::COMMA_LIST)
+    return parse_infix(left, precedence);
+}
+
+node_ptr Parser::parse_prefix(int precedence)
+{
+    node_ptr node = current_node;
+
+    if (is_prefix_op(node))
     {
-        for (auto &child_node : node->_Node.Op().right->_Node.List().elements)
+        advance();
+        node_ptr right = parse_expression(PREC_UNARY);
+        if (is_op(node, "&"))
         {
-            comma_list->_Node.List().elements.push_back(child_node);
+            node->type = NodeType::REF;
+            node->_Node = RefNode();
+            node->_Node.Ref().value = right;
+        }
+        else
+        {
+            node->_Node.Op().right = right;
         }
+        return node;
     }
 
-    *node = *comma_list;
+    if (precedence == PREC_NONE && node->type == NodeType::ID)
+    {
+        std::string name = node->_Node.ID().value;
 
-    return node;
+        if (name == "return" || name == "yield")
+        {
+            return parse_return(node);
+        }
+
+        if (name == "var" || name == "const" || name == "type" || name == "import")
+        {
+            // Anything the keyword is an operand of comes first, e.g. 'type: "span"'
+            node_ptr next = peek();
+            bool is_operand = next->type == NodeType::OP &&
+                              (infix_precedences.count(next->_Node.Op().value) || is_op(next, "(") || is_op(next, "{") || (name != "import" && is_op(next, "[")));
+            if (!is_operand)
+            {
+                return parse_declaration(node);
+            }
+        }
+    }
+
+    return parse_primary();
 }
 
-node_ptr Parser::flatten_pipe_node(node_ptr node)
+node_ptr Parser::parse_primary()
 {
-    node_ptr pipe_list = new_node(NodeType::LIST);
-    pipe_list->type = NodeType::PIPE_LIST;
+    node_ptr node = current_node;
 
-    if (node->type == NodeType::OP && node->_Node.Op().left->type == NodeType::OP && node->_Node.Op().left->_Node.Op().value == "|")
+    if (node->type == NodeType::END_OF_FILE)
     {
-        node->_Node.Op().left = flatten_pipe_node(node->_Node.Op().left);
+        error_and_exit("Unexpected end of file");
     }
-    else
+
+    if (node->type == NodeType::OP)
     {
-        pipe_list->_Node.List().elements.push_back(node->_Node.Op().left);
+        if (is_op(node, "("))
+        {
+            node = parse_group(NodeType::PAREN, ")");
+            node = parse_postfix(node);
+            if (node->type == NodeType::PAREN && is_op(current_node, ":"))
+            {
+                node = parse_typed_func(node);
+            }
+            return node;
+        }
+        if (is_op(node, "{"))
+        {
+            return parse_postfix(parse_group(NodeType::OBJECT, "}"));
+        }
+        if (is_op(node, "["))
+        {
+            return parse_postfix(parse_group(NodeType::LIST, "]"));
+        }
+        if (is_closing(node))
+        {
+            error_and_exit("Unexpected token '" + node->_Node.Op().value + "'");
+        }
+        advance();
+        return node;
     }
 
-    if (node->type == NodeType::OP && node->_Node.Op().left->type == NodeType::PIPE_LIST)
+    if (node->type == NodeType::ID)
     {
-        for (auto &child_node : node->_Node.Op().left->_Node.List().elements)
+        std::string name = node->_Node.ID().value;
+
+        if ((name == "enum" || name == "union") && peek()->type == NodeType::ID && is_op(peek(2), "{"))
         {
-            pipe_list->_Node.List().elements.push_back(child_node);
+            advance();
+            std::string type_name = current_node->_Node.ID().value;
+            advance();
+            node_ptr body = parse_group(NodeType::OBJECT, "}");
+            if (name == "enum")
+            {
+                node->type = NodeType::ENUM;
+                node->_Node = EnumNode();
+                node->_Node.Enum().name = type_name;
+                node->_Node.Enum().body = body;
+            }
+            else
+            {
+                node->type = NodeType::UNION;
+                node->_Node = UnionNode();
+                node->_Node.Union().name = type_name;
+                node->_Node.Union().body = body;
+            }
+            return node;
+        }
+        if (name == "for" || name == "while")
+        {
+            return parse_loop(node);
+        }
+        if (name == "if")
+        {
+            return parse_if();
         }
+        if (name == "try")
+        {
+            return parse_try_catch(node);
+        }
+        if (name == "else")
+        {
+            error_and_exit("Malformed if block");
+        }
+
+        convert_keyword(node);
     }
 
-    if (node->type == NodeType::OP && node->_Node.Op().right->type == NodeType::OP && node->_Node.Op().right->_Node.Op().value == "|")
+    advance();
+    return parse_postfix(node);
+}
+
+node_ptr Parser::parse_postfix(node_ptr node)
+{
+    bool callable = node->type == NodeType::ID && !is_id(node, "return") && !is_id(node, "yield");
+    bool inline_callable = node->type == NodeType::PAREN && node->_Node.Paren().elements.size() == 1;
+
+    if ((callable || inline_callable) && is_op(current_node, "("))
     {
-        node->_Node.Op().right = flatten_comma_node(node->_Node.Op().right);
+        node_ptr args_list = parse_group(NodeType::PAREN, ")");
+        if (callable)
+        {
+            std::string name = node->_Node.ID().value;
+            node->type = NodeType::FUNC_CALL;
+            node->_Node = FuncCallNode();
+            node->_Node.FunctionCall().name = name;
+        }
+        else
+        {
+            node_ptr func = node->_Node.Paren().elements[0];
+            node->type = NodeType::FUNC_CALL;
+            node->_Node = FuncCallNode();
+            node->_Node.FunctionCall().inline_func = func;
+        }
+        build_func_call_args(node, args_list);
     }
-    else
+
+    while (is_op(current_node, "?") && (peek()->type == NodeType::END_OF_FILE || (peek()->type == NodeType::OP && !is_opening(peek()))))
     {
-        pipe_list->_Node.List().elements.push_back(node->_Node.Op().right);
+        node_ptr op = current_node;
+        advance();
+        op->_Node.Op().right = node;
+        node = op;
     }
 
-    if (node->type == NodeType::OP && node->_Node.Op().right->type == NodeType::PIPE_LIST)
+    while (is_op(current_node, "["))
     {
-        for (auto &child_node : node->_Node.Op().right->_Node.List().elements)
+        bool accessible = node->type == NodeType::LIST ||
+                          node->type == NodeType::FUNC_CALL ||
+                          node->type == NodeType::ACCESSOR ||
+                          node->type == NodeType::NUMBER ||
+                          node->type == NodeType::STRING ||
+                          node->type == NodeType::BOOLEAN ||
+                          node->type == NodeType::OBJECT ||
+                          node->type == NodeType::PAREN ||
+                          (node->type == NodeType::ID && !is_id(node, "import") && !is_id(node, "return") && !is_id(node, "yield"));
+        if (!accessible)
         {
-            pipe_list->_Node.List().elements.push_back(child_node);
+            break;
         }
+        line = node->line;
+        column = node->column;
+        node_ptr accessor = new_accessor_node();
+        accessor->_Node.Accessor().container = node;
+        accessor->_Node.Accessor().accessor = parse_group(NodeType::LIST, "]");
+        node = accessor;
     }
 
-    *node = *pipe_list;
-
     return node;
 }
 
-void Parser::remove_op_node(std::string type)
+node_ptr Parser::parse_infix(node_ptr left, int precedence)
 {
-    while (current_node->type != NodeType::END_OF_FILE)
+    while (true)
     {
-        if (current_node->type == NodeType::OP && current_node->_Node.Op().value == type)
+        int op_precedence = PREC_NONE;
+        bool deconstruct = false;
+
+        if (pending.empty())
         {
-            erase_curr();
+            if (left->type == NodeType::ID && is_op(current_node, "{") && !is_id(left, "return") && !is_id(left, "yield"))
+            {
+                op_precedence = PREC_DECONSTRUCT;
+                deconstruct = true;
+            }
+            else if (current_node->type == NodeType::OP && (!is_op(current_node, "=>") || peek()->type != NodeType::END_OF_FILE))
+            {
+                auto it = infix_precedences.find(current_node->_Node.Op().value);
+                if (it != infix_precedences.end())
+                {
+                    op_precedence = it->second;
+                }
+            }
+        }
+
+        // Pipes become a single list once everything binding tighter
+        // than 'and'/'or' has been applied to them
+        if (precedence <= PREC_WORD && op_precedence < PREC_WORD && is_op(left, "|") && has_children(left))
+        {
+            line = left->line;
+            column = left->column;
+            left = flatten_pipe_node(left);
+        }
+
+        if (op_precedence == PREC_NONE || op_precedence < precedence)
+        {
+            break;
+        }
+
+        if (deconstruct)
+        {
+            node_ptr body = parse_expression(PREC_DECONSTRUCT + 1);
+            if (body->type != NodeType::OBJECT)
+            {
+                pending.push_back(body);
+                break;
+            }
+            std::string name = left->_Node.ID().value;
+            left->type = NodeType::OBJECT_DECONSTRUCT;
+            left->_Node = ObjectDeconstructNode();
+            left->_Node.ObjectDeconstruct().name = name;
+            left->_Node.ObjectDeconstruct().body = body;
+            continue;
         }
 
+        node_ptr op = current_node;
+        std::string value = op->_Node.Op().value;
         advance();
+
+        if (value == ".")
+        {
+            node_ptr right = parse_primary();
+            op->_Node.Op().left = left;
+            if (right->type == NodeType::ACCESSOR)
+            {
+                op->_Node.Op().right = right->_Node.Accessor().container;
+                right->_Node.Accessor().container = op;
+                left = right;
+            }
+            else
+            {
+                op->_Node.Op().right = right;
+                left = op;
+            }
+            continue;
+        }
+
+        if (value == "=>")
+        {
+            node_ptr body = parse_expression(PREC_FUNC + 1);
+            line = op->line;
+            column = op->column;
+            build_func_def(op, left, nullptr, body);
+            left = op;
+            continue;
+        }
+
+        // A trailing comma is dropped
+        if (value == "," && !starts_operand(current_node))
+        {
+            continue;
+        }
+
+        op->_Node.Op().left = left;
+        op->_Node.Op().right = parse_expression(op_precedence + 1);
+
+        if (value == "=" || value == ":")
+        {
+            name_function(op);
+        }
+
+        left = op;
     }
+
+    if (is_op(left, ",") && has_children(left))
+    {
+        line = left->line;
+        column = left->column;
+        left = flatten_comma_node(left);
+    }
+
+    return left;
+}
+
+// (params): ReturnType => body
+node_ptr Parser::parse_typed_func(node_ptr params)
+{
+    node_ptr colon = current_node;
+    advance();
+    node_ptr return_type = parse_expression(PREC_FUNC + 1);
+
+    if (pending.empty() && is_op(current_node, "=>") && peek()->type != NodeType::END_OF_FILE)
+    {
+        node_ptr func = current_node;
+        advance();
+        node_ptr body = parse_expression(PREC_FUNC + 1);
+        line = func->line;
+        column = func->column;
+        build_func_def(func, params, return_type, body);
+        return func;
+    }
+
+    colon->_Node.Op().left = params;
+    colon->_Node.Op().right = parse_infix(return_type, PREC_COLON + 1);
+    return colon;
+}
+
+node_ptr Parser::parse_group(NodeType type, std::string closing)
+{
+    node_ptr node = current_node;
+    std::vector<node_ptr> enclosing_objects;
+
+    node->type = type;
+    if (type == NodeType::OBJECT)
+    {
+        node->_Node = ObjectNode();
+        nested_objects.push_back(node);
+    }
+    else if (type == NodeType::PAREN)
+    {
+        node->_Node = ParenNode();
+        enclosing_objects.swap(nested_objects);
+    }
+    else
+    {
+        node->_Node = ListNode();
+    }
+
+    advance();
+    std::vector<node_ptr> elements = parse_sequence(closing);
+
+    if (type == NodeType::OBJECT)
+    {
+        node->_Node.Object().elements = elements;
+        nested_objects.pop_back();
+    }
+    else if (type == NodeType::PAREN)
+    {
+        node->_Node.Paren().elements = elements;
+        nested_objects.swap(enclosing_objects);
+    }
+    else
+    {
+        node->_Node.List().elements = elements;
+    }
+
+    return node;
+}
+
+// The body of a loop or if statement, or the blocks of a try-catch
+node_ptr Parser::parse_block()
+{
+    if (is_op(current_node, "{"))
+    {
+        return parse_group(NodeType::OBJECT, "}");
+    }
+    return parse_primary();
+}
+
+node_ptr Parser::parse_loop(node_ptr node)
+{
+    bool is_for = is_id(node, "for");
+    advance();
+
+    node_ptr config = current_node;
+    if (!is_op(config, "("))
+    {
+        line = node->line;
+        column = node->column;
+        error_and_exit(is_for ? "Malformed for loop" : "Malformed while loop");
+    }
+
+    config = parse_group(NodeType::PAREN, ")");
+    node_ptr body = parse_block();
+    line = node->line;
+    column = node->column;
+
+    if (is_for)
+    {
+        build_for_loop(node, config, body);
+    }
+    else
+    {
+        build_while_loop(node, config, body);
+    }
+    return node;
+}
+
+node_ptr Parser::parse_if_statement()
+{
+    node_ptr node = current_node;
+    advance();
+
+    if (!is_op(current_node, "("))
+    {
+        line = node->line;
+        column = node->column;
+        error_and_exit("Malformed if statement");
+    }
+
+    node_ptr conditional = parse_group(NodeType::PAREN, ")");
+    node_ptr body = parse_block();
+    line = node->line;
+    column = node->column;
+    build_if_statement(node, conditional, body);
+    return node;
+}
+
+node_ptr Parser::parse_if()
+{
+    node_ptr node = parse_if_statement();
+
+    while (is_id(current_node, "else"))
+    {
+        node_ptr block = current_node;
+        advance();
+
+        node_ptr next;
+        if (is_id(current_node, "if"))
+        {
+            next = parse_if_statement();
+        }
+        else if (is_op(current_node, "{"))
+        {
+            next = parse_group(NodeType::OBJECT, "}");
+        }
+        else
+        {
+            line = block->line;
+            column = block->column;
+            error_and_exit("Malformed if block");
+        }
+
+        build_if_block(block, node, next);
+        node = block;
+    }
+
+    return node;
+}
+
+node_ptr Parser::parse_try_catch(node_ptr node)
+{
+    advance();
+    node_ptr try_block = is_op(current_node, "{") ? parse_group(NodeType::OBJECT, "}") : current_node;
+    node_ptr catch_keyword = is_id(current_node, "catch") && is_op(peek(), "(") ? parse_primary() : current_node;
+    node_ptr catch_block = is_op(current_node, "{") ? parse_group(NodeType::OBJECT, "}") : current_node;
+    line = node->line;
+    column = node->column;
+    build_try_catch(node, try_block, catch_keyword, catch_block);
+    return node;
+}
+
+node_ptr Parser::parse_return(node_ptr node)
+{
+    bool is_yield = is_id(node, "yield");
+    advance();
+
+    // 'yield from gen' delegates to gen, unless 'from' is a variable
+    bool delegate = is_yield && is_id(current_node, "from") && peek()->line == current_node->line && starts_operand(peek());
+    if (delegate)
+    {
+        advance();
+    }
+
+    node_ptr value;
+    if (current_node->type != NodeType::END_OF_FILE && !is_closing(current_node) && !is_op(current_node, ";"))
+    {
+        value = parse_expression(PREC_NONE);
+    }
+
+    if (is_yield)
+    {
+        node->type = NodeType::YIELD;
+        node->_Node = YieldNode();
+        node->_Node.Yield().value = value;
+        node->_Node.Yield().delegate = delegate;
+        for (auto &object : nested_objects)
+        {
+            object->_Node.Object().contains_yield = true;
+        }
+    }
+    else
+    {
+        node->type = NodeType::RETURN;
+        node->_Node = ReturnNode();
+        node->_Node.Return().value = value;
+    }
+
+    return node;
+}
+
+// var, const, type and import statements. A 'var' that does not declare
+// anything is left as a plain identifier followed by its operand.
+node_ptr Parser::parse_declaration(node_ptr node)
+{
+    std::string name = node->_Node.ID().value;
+    advance();
+
+    bool parsed = current_node->type != NodeType::END_OF_FILE && !is_closing(current_node);
+    node_ptr next = parsed ? parse_expression(PREC_NONE) : current_node;
+    line = node->line;
+    column = node->column;
+
+    if (name == "var")
+    {
+        if (!build_var(node, next) && parsed)
+        {
+            pending.insert(pending.begin(), next);
+        }
+    }
+    else if (name == "const")
+    {
+        build_const(node, next);
+    }
+    else if (name == "type")
+    {
+        build_type(node, next);
+    }
+    else
+    {
+        build_import(node, next);
+    }
+
+    return node;
+}
+
+void Parser::build_func_def(node_ptr node, node_ptr params_node, node_ptr return_type, node_ptr body)
+{
+    node->type = NodeType::FUNC;
+    node->_Node = FuncNode();
+    node->_Node.Function().return_type = return_type;
+    node->_Node.Function().body = body;
+
+    if (node->_Node.Function().body->type == NodeType::OBJECT && node->_Node.Function().body->_Node.Object().contains_yield)
+    {
+        node->_Node.Function().is_generator = true;
+    }
+
+    if (params_node->type == NodeType::PAREN)
+    {
+        node_ptr params = params_node;
+
+        if (params->type == NodeType::PAREN && params->_Node.Paren().elements.size() == 0)
+        {
+            node_ptr list = new_node(NodeType::LIST);
+            list->_Node = ListNode();
+            list->type = NodeType::COMMA_LIST;
+            params->_Node.Paren().elements.push_back(list);
+        }
+
+        else if (params->type == NodeType::PAREN && params->_Node.Paren().elements.size() == 1 && params->_Node.Paren().elements[0]->type != NodeType::COMMA_LIST)
+        {
+            node_ptr list = new_node(NodeType::LIST);
+            list->_Node = ListNode();
+            list->type = NodeType::COMMA_LIST;
+            list->_Node.List().elements.push_back(params->_Node.Paren().elements[0]);
+            params->_Node.Paren().elements[0] = list;
+        }
+
+        int elem_count = -1;
+
+        for (node_ptr &elem : params->_Node.Paren().elements[0]->_Node.List().elements)
+        {
+
+            elem_count++;
+
+            // ...args
+            if (elem->type == NodeType::OP && elem->_Node.Op().value == "...")
+            {
+                if (elem_count < params->_Node.Paren().elements[0]->_Node.List().elements.size() - 1)
+                {
+                    error_and_exit("Argument captures (...) must be defined last");
+                }
+                node_ptr param_name = elem->_Node.Op().right;
+                param_name->Meta.tags.push_back("capture");
+                elem = param_name;
+            }
+            // x: String
+            if (elem->type == NodeType::OP && elem->_Node.Op().value == ":")
+            {
+
+                // Check if we already have defaults, if we do, we raise an error
+                // Because we can't have non-default params after default params
+
+                if (node->_Node.Function().default_values.size() > 0)
+                {
+                    error_and_exit("Cannot define non-default parameters after default parameters");
+                }
+
+                node_ptr param_name = elem->_Node.Op().left;
+                node_ptr param_type = elem->_Node.Op().right;
+
+                if (param_name->type != NodeType::ID)
+                {
+                    error_and_exit("Parameter names must be identifiers");
+                }
+
+                node->_Node.Function().params.push_back(param_name);
+
+                node->_Node.Function().param_types[param_name->_Node.ID().value] = param_type;
+            }
+            // x: String = "hi"
+            else if (elem->type == NodeType::OP && elem->_Node.Op().value == "=")
+            {
+                node_ptr left = elem->_Node.Op().left;
+                node_ptr param_name;
+                node_ptr param_type;
+                node_ptr default_value = elem->_Node.Op().right;
+
+                if (left->type == NodeType::ID)
+                {
+                    param_name = left;
+                }
+                else if (left->type == NodeType::OP && left->_Node.Op().value == ":")
+                {
+                    param_name = left->_Node.Op().left;
+                    param_type = left->_Node.Op().right;
+                }
+
+                if (param_name->type != NodeType::ID)
+                {
+                    error_and_exit("Parameter names must be identifiers");
+                }
+
+                node->_Node.Function().params.push_back(param_name);
+
+                if (param_type)
+                {
+                    node->_Node.Function().param_types[param_name->_Node.ID().value] = param_type;
+                }
+                else
+                {
+                    node->_Node.Function().param_types[param_name->_Node.ID().value] = new_node(NodeType::ANY);
+                }
+
+                node->_Node.Function().default_values[param_name->_Node.ID().value] = default_value;
+                node->_Node.Function().default_values_ordered.push_back(default_value);
+            }
+            else if (elem->type == NodeType::ID)
+            {
+
+                // Check if we already have defaults, if we do, we raise an error
+                // Because we can't have non-default params after default params
+
+                if (node->_Node.Function().default_values.size() > 0)
+                {
+                    error_and_exit("Cannot define non-default parameters after default parameters");
+                }
+
+                node_ptr param_name = elem;
+                node_ptr param_type = new_node(NodeType::ANY);
+
+                node->_Node.Function().params.push_back(param_name);
+                node->_Node.Function().param_types[param_name->_Node.ID().value] = param_type;
+            }
+
+            node->_Node.Function().args.push_back(nullptr);
+        }
+    }
+
+    if (node->type == NodeType::FUNC && node->_Node.Function().body->type == NodeType::OBJECT)
+    {
+        for (int i = 0; i < node->_Node.Function().body->_Node.Object().elements.size(); i++)
+        {
+            auto &elem = node->_Node.Function().body->_Node.Object().elements[i];
+            if (elem->type == NodeType::OP && elem->_Node.Op().value == ";")
+            {
+                node->_Node.Function().body->_Node.Object().elements.erase(node->_Node.Function().body->_Node.Object().elements.begin() + i);
+            }
+        }
+    }
+}
+
+void Parser::build_func_call_args(node_ptr node, node_ptr args_list)
+{
+    if (args_list->_Node.Paren().elements.size() == 1 && args_list->_Node.Paren().elements[0]->type == NodeType::COMMA_LIST)
+    {
+        node->_Node.FunctionCall().args = args_list->_Node.Paren().elements[0]->_Node.List().elements;
+    }
+    else if (args_list->_Node.Paren().elements.size() == 1)
+    {
+        node->_Node.FunctionCall().args.push_back(args_list->_Node.Paren().elements[0]);
+    }
+}
+
+void Parser::build_import(node_ptr node, node_ptr next)
+{
+    node->type = NodeType::IMPORT;
+    node->_Node = ImportNode();
+    if (next->type == NodeType::OP && next->_Node.Op().value == ":")
+    {
+        node->_Node.Import().module = next->_Node.Op().left;
+        node->_Node.Import().target = next->_Node.Op().right;
+    }
+    else if (next->type == NodeType::ID)
+    {
+        node->_Node.Import().module = next;
+        node->_Node.Import().is_default = true;
+    }
+    else
+    {
+        error_and_exit("Malformed import statement");
+    }
+}
+
+// Names a function assigned with '=' or defined as an object member with ':'
+void Parser::name_function(node_ptr node)
+{
+    node_ptr left = node->_Node.Op().left;
+    node_ptr right = node->_Node.Op().right;
+
+    if (right->type != NodeType::FUNC)
+    {
+        return;
+    }
+
+    if (left->type == NodeType::ID)
+    {
+        right->_Node.Function().name = left->_Node.ID().value;
+    }
+    else if (left->type == NodeType::STRING)
+    {
+        right->_Node.Function().name = left->_Node.String().value;
+    }
+    else if (left->type == NodeType::OP && left->_Node.Op().value == "." && left->_Node.Op().right->type == NodeType::ID)
+    {
+        right->_Node.Function().name = left->_Node.Op().right->_Node.ID().value;
+    }
+}
+
+void Parser::build_type(node_ptr node, node_ptr next)
+{
+    if (next->type == NodeType::OP && next->_Node.Op().value == "=")
+    {
+        node->type = NodeType::TYPE;
+        node->_Node = TypeNode();
+
+        node_ptr name;
+        node_ptr parametric_list;
+
+        if (next->_Node.Op().left->type == NodeType::ACCESSOR)
+        {
+            name = next->_Node.Op().left->_Node.Accessor().container;
+            parametric_list = next->_Node.Op().left->_Node.Accessor().accessor;
+        }
+        else if (next->_Node.Op().left->type == NodeType::ID)
+        {
+            name = next->_Node.Op().left;
+        }
+        else
+        {
+            error_and_exit("Malformed type definition");
+        }
+
+        node->_Node.Type().name = name->_Node.ID().value;
+        node->_Node.Type().body = next->_Node.Op().right;
+
+        if (parametric_list)
+        {
+            node->_Node.Type().parametric_type = true;
+            if (parametric_list->_Node.List().elements.size() == 1 && parametric_list->_Node.List().elements[0]->type == NodeType::COMMA_LIST)
+            {
+                parametric_list = parametric_list->_Node.List().elements[0];
+            }
+            for (node_ptr &param : parametric_list->_Node.List().elements)
+            {
+                if (param->type == NodeType::OP && param->_Node.Op().value == ":")
+                {
+                    node_ptr param_name = param->_Node.Op().left;
+                    if (param_name->type != NodeType::ID)
+                    {
+                        error_and_exit("Parametric type must be an identifier");
+                    }
+                    node->_Node.Type().params.push_back(param_name);
+                    node->_Node.Type().param_types[param_name->_Node.ID().value] = param->_Node.Op().right;
+                }
+                else if (param->type == NodeType::ID)
+                {
+                    node->_Node.Type().params.push_back(param);
+                }
+                else
+                {
+                    error_and_exit("Malformed parametric type definition");
+                }
+            }
+        }
+    }
+    else
+    {
+        node->type = NodeType::TYPE;
+        node->_Node = TypeNode();
+        node_ptr name = next;
+        if (name->type != NodeType::ID)
+        {
+            error_and_exit("Type definition expects a name");
+        }
+        node->_Node.Type().name = name->_Node.ID().value;
+        node->TypeInfo.is_decl = true;
+    }
+}
+
+bool Parser::build_var(node_ptr node, node_ptr next)
+{
+    if (next->type == NodeType::ID)
+    {
+        node->type = NodeType::VARIABLE_DECLARATION;
+        node->_Node = VariableDeclatationNode();
+        node->_Node.VariableDeclaration().name = next->_Node.ID().value;
+        node->_Node.VariableDeclaration().value = new_node(NodeType::NONE);
+        return true;
+    }
+    else if (next->type == NodeType::OP && next->_Node.Op().value == "=")
+    {
+        node->type = NodeType::VARIABLE_DECLARATION;
+        node->_Node = VariableDeclatationNode();
+        if (next->_Node.Op().left->type == NodeType::OP && next->_Node.Op().left->_Node.Op().value == ":")
+        {
+            node_ptr typed_var = next->_Node.Op().left;
+            if (typed_var->_Node.Op().left->type != NodeType::ID)
+            {
+                error_and_exit("Malformed declaration");
+            }
+            node->_Node.VariableDeclaration().name = typed_var->_Node.Op().left->_Node.ID().value;
+            node->_Node.VariableDeclaration().value = next->_Node.Op().right;
+            node->_Node.VariableDeclaration().type = typed_var->_Node.Op().right;
+        }
+        else
+        {
+            if (next->_Node.Op().left->type != NodeType::ID)
+            {
+                error_and_exit("Malformed declaration");
+            }
+            node->_Node.VariableDeclaration().name = next->_Node.Op().left->_Node.ID().value;
+            node->_Node.VariableDeclaration().value = next->_Node.Op().right;
+        }
+        return true;
+    }
+    else if (next->type == NodeType::OP && next->_Node.Op().value == ":")
+    {
+        node->type = NodeType::VARIABLE_DECLARATION;
+        node->_Node = VariableDeclatationNode();
+        node->_Node.VariableDeclaration().name = next->_Node.Op().left->_Node.ID().value;
+        node->_Node.VariableDeclaration().type = next->_Node.Op().right;
+
+        if (node->_Node.VariableDeclaration().type->type == NodeType::ANY)
+        {
+            node->_Node.VariableDeclaration().value = new_node(NodeType::ANY);
+        }
+        else
+        {
+            node->_Node.VariableDeclaration().value = new_node(NodeType::NONE);
+        }
+        return true;
+    }
+    return false;
+}
+
+void Parser::build_const(node_ptr node, node_ptr next)
+{
+    if (next->type == NodeType::OP && next->_Node.Op().value == "=")
+    {
+        node->type = NodeType::CONSTANT_DECLARATION;
+        node->_Node = ConstantDeclatationNode();
+        if (next->_Node.Op().left->type == NodeType::OP && next->_Node.Op().left->_Node.Op().value == ":")
+        {
+            node_ptr typed_var = next->_Node.Op().left;
+            if (typed_var->_Node.Op().left->type != NodeType::ID)
+            {
+                error_and_exit("Malformed declaration");
+            }
+            node->_Node.ConstantDeclatation().name = typed_var->_Node.Op().left->_Node.ID().value;
+            node->_Node.ConstantDeclatation().value = next->_Node.Op().right;
+            node->_Node.ConstantDeclatation().type = typed_var->_Node.Op().right;
+        }
+        else
+        {
+            if (next->_Node.Op().left->type != NodeType::ID)
+            {
+                error_and_exit("Malformed declaration");
+            }
+            node->_Node.ConstantDeclatation().name = next->_Node.Op().left->_Node.ID().value;
+            node->_Node.ConstantDeclatation().value = next->_Node.Op().right;
+        }
+    }
+    else
+    {
+        error_and_exit("Const declaration expects a value");
+    }
+}
+
+void Parser::build_for_loop(node_ptr node, node_ptr config, node_ptr body)
+{
+    node->type = NodeType::FOR_LOOP;
+    node->_Node = ForLoopNode();
+    if (config->type != NodeType::PAREN && body->type != NodeType::OBJECT)
+    {
+        error_and_exit("Malformed for loop");
+    }
+
+    node_ptr for_loop_config = config;
+
+    if (for_loop_config->_Node.Paren().elements.size() == 0 || for_loop_config->_Node.Paren().elements.size() > 3)
+    {
+        error_and_exit("For loop constructor expects 1, 2 or 3 elements");
+    }
+
+    if (for_loop_config->_Node.Paren().elements[0]->type == NodeType::COMMA_LIST)
+    {
+        for_loop_config->_Node.Paren().elements = for_loop_config->_Node.Paren().elements[0]->_Node.List().elements;
+    }
+
+    if (for_loop_config->_Node.Paren().elements.size() > 0)
+    {
+        if (for_loop_config->_Node.Paren().elements[0]->type == NodeType::NUMBER)
+        {
+            node->_Node.ForLoop().start = new_number_node(0);
+            node->_Node.ForLoop().end = for_loop_config->_Node.Paren().elements[0];
+        }
+        else if (for_loop_config->_Node.Paren().elements[0]->type == NodeType::OP && for_loop_config->_Node.Paren().elements[0]->_Node.Op().value == "..")
+        {
+            node->_Node.ForLoop().start = for_loop_config->_Node.Paren().elements[0]->_Node.Op().left;
+            node->_Node.ForLoop().end = for_loop_config->_Node.Paren().elements[0]->_Node.Op().right;
+        }
+        else
+        {
+            node->_Node.ForLoop().iterator = for_loop_config->_Node.Paren().elements[0];
+        }
+    }
+
+    if (for_loop_config->_Node.Paren().elements.size() > 1)
+    {
+        if (for_loop_config->_Node.Paren().elements[1]->type != NodeType::ID)
+        {
+            error_and_exit("Index variable in for loop must be an identifier");
+        }
+
+        node->_Node.ForLoop().index_name = for_loop_config->_Node.Paren().elements[1];
+    }
+
+    if (for_loop_config->_Node.Paren().elements.size() > 2)
+    {
+        if (for_loop_config->_Node.Paren().elements[2]->type != NodeType::ID)
+        {
+            error_and_exit("Value variable in for loop must be an identifier");
+        }
+
+        node->_Node.ForLoop().value_name = for_loop_config->_Node.Paren().elements[2];
+    }
+
+    node->_Node.ForLoop().body = body;
+}
+
+void Parser::build_while_loop(node_ptr node, node_ptr config, node_ptr body)
+{
+    node->type = NodeType::WHILE_LOOP;
+    node->_Node = WhileLoopNode();
+    if (config->type != NodeType::PAREN && body->type != NodeType::OBJECT)
+    {
+        error_and_exit("Malformed while loop");
+    }
+
+    node_ptr while_loop_config = config;
+
+    if (while_loop_config->_Node.Paren().elements.size() != 1)
+    {
+        error_and_exit("While loop constructor expects 1 element");
+    }
+
+    node->_Node.WhileLoop().condition = while_loop_config->_Node.Paren().elements[0];
+    node->_Node.WhileLoop().body = body;
+}
+
+void Parser::build_if_statement(node_ptr node, node_ptr conditional, node_ptr body)
+{
+    node->type = NodeType::IF_STATEMENT;
+    node->_Node = IfStatementNode();
+    if (conditional->type != NodeType::PAREN && body->type != NodeType::OBJECT)
+    {
+        error_and_exit("Malformed if statement");
+    }
+
+    if (conditional->_Node.Paren().elements.size() != 1)
+    {
+        error_and_exit("If statement expects 1 conditional statement");
+    }
+
+    node->_Node.IfStatement().condition = conditional->_Node.Paren().elements[0];
+    node->_Node.IfStatement().body = body;
+}
+
+void Parser::build_if_block(node_ptr node, node_ptr prev, node_ptr next)
+{
+    node->type = NodeType::IF_BLOCK;
+    node->_Node = IfBlockNode();
+    if (prev->type != NodeType::IF_STATEMENT && prev->type != NodeType::IF_BLOCK)
+    {
+        error_and_exit("Malformed if block");
+    }
+    else if (next->type != NodeType::IF_STATEMENT && next->type != NodeType::OBJECT)
+    {
+        error_and_exit("Malformed if block");
+    }
+
+    if (prev->type == NodeType::IF_BLOCK)
+    {
+        for (node_ptr &statement : prev->_Node.IfBlock().statements)
+        {
+            node->_Node.IfBlock().statements.push_back(statement);
+        }
+    }
+    else
+    {
+        node->_Node.IfBlock().statements.push_back(prev);
+    }
+
+    node->_Node.IfBlock().statements.push_back(next);
+}
+
+void Parser::build_try_catch(node_ptr node, node_ptr try_block, node_ptr catch_keyword, node_ptr catch_block)
+{
+    if (try_block->type != NodeType::OBJECT)
+    {
+        error_and_exit("Malformed try-catch expression - missing 'try' block");
+    }
+    if (catch_keyword->type != NodeType::FUNC_CALL || catch_keyword->_Node.FunctionCall().name != "catch")
+    {
+        error_and_exit("Malformed try-catch expression - missing 'catch' block");
+    }
+    if (catch_keyword->_Node.FunctionCall().args.size() != 1)
+    {
+        error_and_exit("Malformed try-catch expression - 'catch' expects one argument");
+    }
+    if (catch_keyword->_Node.FunctionCall().args[0]->type != NodeType::ID)
+    {
+        error_and_exit("Malformed try-catch expression - 'catch' expects argument to be an identifier");
+    }
+    if (catch_block->type != NodeType::OBJECT)
+    {
+        error_and_exit("Malformed try-catch expression - missing 'catch' block");
+    }
+    node->type = NodeType::TRY_CATCH;
+    node->_Node = TryCatchNode();
+    node->_Node.TryCatch().try_body = try_block;
+    node->_Node.TryCatch().catch_keyword = catch_keyword;
+    node->_Node.TryCatch().catch_body = catch_block;
+}
+
+void Parser::build_tags(node_ptr node, node_ptr next)
+{
+    // node_ptr tag = node->_Node.Op().right;
+    // std::vector<std::string> tags;
+    // if (tag->type == NodeType::ID) {
+    //     tags.push_back(tag->_Node.ID().value);
+    // } else if (tag->type == NodeType::LIST) {
+    //     if (tag->_Node.List().elements.size() == 1 && tag->_Node.List().elements[0]->type == NodeType::COMMA_LIST) {
+    //         tag = tag->_Node.List().elements[0];
+    //     }
+    //     for (node_ptr& t : tag->_Node.List().elements) {
+    //         if (t->type != NodeType::ID) {
+    //             error_and_exit("Tags must be identifiers");
+    //         }
+    //         tags.push_back(t->_Node.ID().value);
+    //     }
+    // } else {
+    //     error_and_exit("Tag must be an identifier");
+    // }
+
+    node_ptr tag = node->_Node.Op().right;
+    std::vector<node_ptr> tags;
+    if (tag->type == NodeType::LIST)
+    {
+        if (tag->_Node.List().elements.size() == 1 && tag->_Node.List().elements[0]->type == NodeType::COMMA_LIST)
+        {
+            tag = tag->_Node.List().elements[0];
+        }
+        for (node_ptr &t : tag->_Node.List().elements)
+        {
+            tags.push_back(t);
+        }
+    }
+    else
+    {
+        tags.push_back(tag);
+    }
+
+    // if (next->type == NodeType::CONSTANT_DECLARATION) {
+    //     for (std::string tag : tags) {
+    //         next->_Node.ConstantDeclatation().value->Meta.tags.push_back(tag);
+    //     }
+    // } else if (next->type == NodeType::VARIABLE_DECLARATION) {
+    //     if (next->_Node.VariableDeclaration().value) {
+    //         for (std::string tag : tags) {
+    //             next->_Node.VariableDeclaration().value->Meta.tags.push_back(tag);
+    //         }
+    //     }
+    // } else if (next->type == NodeType::OP && (next->_Node.Op().value == "." || next->_Node.Op().value == ":")) {
+    //     for (std::string tag : tags) {
+    //         next->_Node.Op().right->Meta.tags.push_back(tag);
+    //     }
+    // } else {
+    //     for (std::string tag : tags) {
+    //         next->Meta.tags.push_back(tag);
+    //     }
+    // }
+
+    if (next->type == NodeType::CONSTANT_DECLARATION)
+    {
+        for (node_ptr &tag : tags)
+        {
+            next->_Node.ConstantDeclatation().value->Meta.decorators.push_back(tag);
+        }
+    }
+    else if (next->type == NodeType::VARIABLE_DECLARATION)
+    {
+        if (next->_Node.VariableDeclaration().value)
+        {
+            for (node_ptr &tag : tags)
+            {
+                next->_Node.VariableDeclaration().value->Meta.decorators.push_back(tag);
+            }
+        }
+    }
+    else if (next->type == NodeType::OP && (next->_Node.Op().value == "." || next->_Node.Op().value == ":"))
+    {
+        for (node_ptr &tag : tags)
+        {
+            next->_Node.Op().right->Meta.decorators.push_back(tag);
+        }
+    }
+    else
+    {
+        for (node_ptr &tag : tags)
+        {
+            next->Meta.decorators.push_back(tag);
+        }
+    }
+}
+
+void Parser::convert_keyword(node_ptr node)
+{
+    if (node->_Node.ID().value == "break")
+    {
+        node->type = NodeType::BREAK;
+    }
+    else if (node->_Node.ID().value == "continue")
+    {
+        node->type = NodeType::CONTINUE;
+    }
+    else if (node->_Node.ID().value == "Number")
+    {
+        node->type = NodeType::STRING;
+        node->_Node = StringNode();
+        node->_Node.String().value = "Number";
+        node->TypeInfo.is_type = true;
+        // node->type = NodeType::NUMBER;
+        // node->_Node = NumberNode();
+        // node->TypeInfo.is_type = true;
+    }
+    else if (node->_Node.ID().value == "String")
+    {
+        node->type = NodeType::STRING;
+        node->_Node = StringNode();
+        node->_Node.String().value = "String";
+        node->TypeInfo.is_type = true;
+        // node->type = NodeType::STRING;
+        // node->_Node = StringNode();
+        // node->TypeInfo.is_type = true;
+    }
+    else if (node->_Node.ID().value == "Boolean")
+    {
+        node->type = NodeType::STRING;
+        node->_Node = StringNode();
+        node->_Node.String().value = "Boolean";
+        node->TypeInfo.is_type = true;
+        // node->type = NodeType::BOOLEAN;
+        // node->_Node = BooleanNode();
+        // node->TypeInfo.is_type = true;
+    }
+    else if (node->_Node.ID().value == "List")
+    {
+        node->type = NodeType::STRING;
+        node->_Node = StringNode();
+        node->_Node.String().value = "List";
+        node->TypeInfo.is_type = true;
+        // node->type = NodeType::LIST;
+        // node->_Node = ListNode();
+        // node->TypeInfo.is_type = true;
+        // node->TypeInfo.is_general_type = true;
+    }
+    else if (node->_Node.ID().value == "Object")
+    {
+        node->type = NodeType::STRING;
+        node->_Node = StringNode();
+        node->_Node.String().value = "Object";
+        node->TypeInfo.is_type = true;
+        // node->type = NodeType::OBJECT;
+        // node->_Node = ObjectNode();
+        // node->TypeInfo.is_type = true;
+        // node->TypeInfo.is_general_type = true;
+    }
+    else if (node->_Node.ID().value == "Function")
+    {
+        node->type = NodeType::STRING;
+        node->_Node = StringNode();
+        node->_Node.String().value = "Function";
+        node->TypeInfo.is_type = true;
+        // node->type = NodeType::FUNC;
+        // node->_Node = FuncNode();
+        // node->TypeInfo.is_type = true;
+        // node->TypeInfo.is_general_type = true;
+        // node->_Node.Function().return_type = new_node(NodeType::ANY);
+    }
+    else if (node->_Node.ID().value == "Pointer")
+    {
+        node->type = NodeType::STRING;
+        node->_Node = StringNode();
+        node->_Node.String().value = "Pointer";
+        node->TypeInfo.is_type = true;
+        // node->type = NodeType::POINTER;
+        // node->_Node = PointerNode();
+        // node->TypeInfo.is_type = true;
+    }
+    else if (node->_Node.ID().value == "Library")
+    {
+        node->type = NodeType::STRING;
+        node->_Node = StringNode();
+        node->_Node.String().value = "Library";
+        node->TypeInfo.is_type = true;
+        // node->type = NodeType::LIB;
+        // node->_Node = LibNode();
+        // node->TypeInfo.is_type = true;
+    }
+    else if (node->_Node.ID().value == "Any")
+    {
+        node->type = NodeType::STRING;
+        node->_Node = StringNode();
+        node->_Node.String().value = "Any";
+        node->TypeInfo.is_type = true;
+        // node->type = NodeType::ANY;
+        // node->TypeInfo.is_type = true;
+    }
+    // else if (node->_Node.ID().value == "Error")
+    // {
+    //     node->type = NodeType::STRING;
+    //     node->_Node = StringNode();
+    //     node->_Node.String().value = "Error";
+    //     node->TypeInfo.is_type = true;
+    //     // node->type = NodeType::_ERROR;
+    //     // node->_Node = ErrorNode();
+    //     // node->TypeInfo.is_type = true;
+    // }
+}
+
+int Parser::find_closing_index(int start, std::string opening_symbol, std::string closing_symbol)
+{
+    int count = 0;
+
+    for (int i = start; i < nodes.size(); i++)
+    {
+        if (nodes[i]->type == NodeType::OP && nodes[i]->_Node.Op().value == opening_symbol)
+        {
+            count++;
+        }
+        else if (nodes[i]->type == NodeType::OP && nodes[i]->_Node.Op().value == closing_symbol)
+        {
+            count--;
+        }
+
+        if (nodes[i]->type == NodeType::OP && nodes[i]->_Node.Op().value == closing_symbol && count == 0)
+        {
+            return i;
+        }
+    }
+
+    return 0;
+}
+
+node_ptr Parser::flatten_comma_node(node_ptr node)
+{
+    // node->type = NodeType::COMMA_LIST;
+    node_ptr comma_list = new_node(NodeType::LIST);
+    comma_list->type = NodeType::COMMA_LIST;
+
+    if (node->type == NodeType::OP && node->_Node.Op().left->type == NodeType::OP && node->_Node.Op().left->_Node.Op().value == ",")
+    {
+        node->_Node.Op().left = flatten_comma_node(node->_Node.Op().left);
+    }
+    else
+    {
+        comma_list->_Node.List().elements.push_back(node->_Node.Op().left);
+    }
+
+    if (node->type == NodeType::OP && node->_Node.Op().left->type == NodeType::COMMA_LIST)
+    {
+        for (auto &child_node : node->_Node.Op().left->_Node.List().elements)
+        {
+            comma_list->_Node.List().elements.push_back(child_node);
+        }
+    }
+
+    if (node->type == NodeType::OP && node->_Node.Op().right->type == NodeType::OP && node->_Node.Op().right->_Node.Op().value == ",")
+    {
+        node->_Node.Op().right = flatten_comma_node(node->_Node.Op().right);
+    }
+    else
+    {
+        comma_list->_Node.List().elements.push_back(node->_Node.Op().right);
+    }
+
+    if (node->type == NodeType::OP && node->_Node.Op().right->type == NodeType::COMMA_LIST)
+    {
+        for (auto &child_node : node->_Node.Op().right->_Node.List().elements)
+        {
+            comma_list->_Node.List().elements.push_back(child_node);
+        }
+    }
+
+    *node = *comma_list;
+
+    return node;
+}
+
+node_ptr Parser::flatten_pipe_node(node_ptr node)
+{
+    node_ptr pipe_list = new_node(NodeType::LIST);
+    pipe_list->type = NodeType::PIPE_LIST;
+
+    if (node->type == NodeType::OP && node->_Node.Op().left->type == NodeType::OP && node->_Node.Op().left->_Node.Op().value == "|")
+    {
+        node->_Node.Op().left = flatten_pipe_node(node->_Node.Op().left);
+    }
+    else
+    {
+        pipe_list->_Node.List().elements.push_back(node->_Node.Op().left);
+    }
+
+    if (node->type == NodeType::OP && node->_Node.Op().left->type == NodeType::PIPE_LIST)
+    {
+        for (auto &child_node : node->_Node.Op().left->_Node.List().elements)
+        {
+            pipe_list->_Node.List().elements.push_back(child_node);
+        }
+    }
+
+    if (node->type == NodeType::OP && node->_Node.Op().right->type == NodeType::OP && node->_Node.Op().right->_Node.Op().value == "|")
+    {
+        node->_Node.Op().right = flatten_comma_node(node->_Node.Op().right);
+    }
+    else
+    {
+        pipe_list->_Node.List().elements.push_back(node->_Node.Op().right);
+    }
+
+    if (node->type == NodeType::OP && node->_Node.Op().right->type == NodeType::PIPE_LIST)
+    {
+        for (auto &child_node : node->_Node.Op().right->_Node.List().elements)
+        {
+            pipe_list->_Node.List().elements.push_back(child_node);
+        }
+    }
+
+    *node = *pipe_list;
+
+    return node;
+}
+
+void Parser::remove_op_node(std::string type)
+{
+    nodes.erase(std::remove_if(nodes.begin() + index, nodes.end(), [&](node_ptr &node)
+                               { return node->type == NodeType::OP && node->_Node.Op().value == type; }),
+                nodes.end());
+    index = nodes.size() - 1;
+    current_node = nodes[index];
 }
 
 void Parser::erase_next()
@@ -11,6 +11,10 @@ public:
     std::string file_name;
     int line, column;
     std::vector<node_ptr> nested_objects;
+    /* Elements parsed ahead of the one being returned */
+    std::vector<node_ptr> pending;
+    /* Parse with the rewrite passes instead of the Pratt parser */
+    static bool legacy;
 
 public:
     Parser() = default;
@@ -50,6 +54,7 @@ public:
     void parse_tag(std::string end);
     void parse_return(std::string end);
     void parse_yield(std::string end);
+    void parse_yield_from(std::string end);
     void parse_keywords(std::string end);
     void parse_object_desconstruct(std::string end);
     void parse_hook_implementation(std::string end);
@@ -58,8 +63,41 @@ public:
     void parse_equals(std::string end);
     void flatten_commas(std::string end);
     void flatten_pipes(std::string end);
+    void parse_passes(int start, std::string end);
     void parse(int start, std::string end);
 
+    std::vector<node_ptr> parse_sequence(std::string closing);
+    node_ptr parse_element();
+    node_ptr parse_expression(int precedence);
+    node_ptr parse_prefix(int precedence);
+    node_ptr parse_primary();
+    node_ptr parse_postfix(node_ptr node);
+    node_ptr parse_infix(node_ptr left, int precedence);
+    node_ptr parse_typed_func(node_ptr params);
+    node_ptr parse_group(NodeType type, std::string closing);
+    node_ptr parse_block();
+    node_ptr parse_loop(node_ptr node);
+    node_ptr parse_if_statement();
+    node_ptr parse_if();
+    node_ptr parse_try_catch(node_ptr node);
+    node_ptr parse_return(node_ptr node);
+    node_ptr parse_declaration(node_ptr node);
+
+    void build_func_def(node_ptr node, node_ptr params_node, node_ptr return_type, node_ptr body);
+    void build_func_call_args(node_ptr node, node_ptr args_list);
+    void build_import(node_ptr node, node_ptr next);
+    void build_type(node_ptr node, node_ptr next);
+    bool build_var(node_ptr node, node_ptr next);
+    void build_const(node_ptr node, node_ptr next);
+    void build_for_loop(node_ptr node, node_ptr config, node_ptr body);
+    void build_while_loop(node_ptr node, node_ptr config, node_ptr body);
+    void build_if_statement(node_ptr node, node_ptr conditional, node_ptr body);
+    void build_if_block(node_ptr node, node_ptr prev, node_ptr next);
+    void build_try_catch(node_ptr node, node_ptr try_block, node_ptr catch_keyword, node_ptr catch_block);
+    void build_tags(node_ptr node, node_ptr next);
+    void convert_keyword(node_ptr node);
+    void name_function(node_ptr node);
+
     bool has_children(node_ptr node);
 
     node_ptr flatten_comma_node(node_ptr node);
@@ -1,6 +1,16 @@
 #include "VirtualMachine.hpp"
 
-int internal_stack_count = 0;
+thread_local int internal_stack_count = 0;
+// The VM whose run loop is calling the current native function
+static thread_local VM *current_vm = nullptr;
+
+static int call_function(VM &vm, Value &function, int param_num, CallFrame *&frame, Value *object = nullptr, bool tail = false);
+static bool resume_coroutine(VM &vm, const Ref<FunctionObj> &root, Value *sent, int instruction_index, CallFrame *&frame);
+
+static Value collect_builtin(std::vector<Value> &args);
+static Value collector_stats_builtin(std::vector<Value> &args);
+static Value collector_threshold_builtin(std::vector<Value> &args);
+static Value global_slots_builtin(std::vector<Value> &args);
 
 void push(VM &vm, Value &value)
 {
@@ -8,6 +18,12 @@ void push(VM &vm, Value &value)
     vm.sp = &vm.stack.back();
 }
 
+void push(VM &vm, Value &&value)
+{
+    vm.stack.push_back(std::move(value));
+    vm.sp = &vm.stack.back();
+}
+
 Value pop(VM &vm)
 {
     Value value = std::move(vm.stack.back());
@@ -16,154 +32,451 @@ Value pop(VM &vm)
     return value;
 }
 
-Value pop_close(VM &vm)
+// Replaces the two operands on top of the stack with a binary operator's
+// result, without moving either of them off the stack first
+static inline void replace_operands(VM &vm, Value &&result)
 {
-    Value &v = vm.stack.back();
-    for (auto &closure : vm.closed_values)
-    {
-        if (closure->location == &v)
-        {
-            closure->closed = v;
-            closure->location = &closure->closed;
-            break;
-        }
-    }
-    Value value = std::move(vm.stack.back());
     vm.stack.pop_back();
-    vm.sp--;
-    return value;
+    vm.stack.back() = std::move(result);
+    vm.sp = &vm.stack.back();
 }
 
-static void runtimeError(VM &vm, std::string message, std::string error_type, ...)
+// Rewrites the instruction at `op` to a form specialised for the operand
+// types it just ran with, or back to the generic form when those types
+// change. Code is only rewritten while no other thread can be running it.
+static inline void quicken(uint8_t *op, uint8_t quickened)
 {
-    int last_frame = vm.frames.size() - 1;
-    CallFrame &frame = vm.frames[last_frame];
-
-    if (frame.function->is_generator && frame.function->generator_init)
+    if (!shared_heap_threads.load(std::memory_order_acquire))
     {
-        frame = *vm.gen_frames[frame.function->name];
+        *op = quickened;
     }
+}
 
-    int num_try_blocks = vm.try_instructions.size();
-
-    if (num_try_blocks > 0)
+// Drops the operands of a fused compare and takes the conditional jump
+// stored after it
+static inline void compare_and_branch(VM &vm, CallFrame *frame, bool result)
+{
+    vm.stack.pop_back();
+    vm.stack.pop_back();
+    vm.sp -= 2;
+    uint8_t *jump = frame->ip;
+    frame->ip += 5;
+    if (result == (jump[0] == OP_POP_JUMP_IF_TRUE))
     {
-        vm.status = 2;
+        frame->ip += bytes_to_int(jump[1], jump[2], jump[3], jump[4]);
+    }
+}
 
-        size_t instr = frame.ip - frame.function->chunk.code.data() - 1;
+// replace_operands for quickened instructions whose operands are known to
+// be numbers or ranges, so there is nothing to release
+static inline void replace_numbers(VM &vm, double result)
+{
+    vm.stack.pop_back();
+    Value &top = vm.stack.back();
+    top.type = Number;
+    top.as.number = result;
+    top.meta = Meta();
+    top.set_hooks_id(0);
+    vm.sp--;
+}
 
-        Value error_obj = object_val();
-        error_obj.get_object()->keys = {"message", "type", "line", "path"};
-        error_obj.get_object()->values["message"] = string_val(message);
-        error_obj.get_object()->values["type"] = string_val(error_type);
-        error_obj.get_object()->values["line"] = number_val(frame.function->chunk.lines[instr]);
-        error_obj.get_object()->values["path"] = string_val(frame.function->name == "" ? frame.name : frame.function->import_path);
+static inline void replace_numbers(VM &vm, bool result)
+{
+    vm.stack.pop_back();
+    Value &top = vm.stack.back();
+    top.type = Boolean;
+    top.as.bits = 0;
+    top.as.boolean = result;
+    top.meta = Meta();
+    top.set_hooks_id(0);
+    vm.sp--;
+}
 
-        int current_offset = (int)(size_t)(frame.ip - &frame.function->chunk.code[0]);
-        int instruction_index = std::find(frame.function->instruction_offsets.begin(), frame.function->instruction_offsets.end(), current_offset) - frame.function->instruction_offsets.begin();
-        int instruction = frame.function->instruction_offsets[instruction_index];
-        int _instruction = frame.function->chunk.code[instruction];
+// Materializes a range, for the places that need an actual list
+static Value range_list(Value &range)
+{
+    Value list = list_val();
+    auto &elements = *list.get_list();
+    elements.reserve(range.range_length());
+    for (int i = range.range_start(); i < range.range_end(); i++)
+    {
+        elements.push_back(number_val(i));
+    }
+    return list;
+}
 
-        int try_count = 1;
-        int diff;
+// The one-byte string for each byte value, shared by every loop over a
+// string
+static Value &byte_string(unsigned char byte)
+{
+    static std::vector<Value> strings = []
+    {
+        std::vector<Value> strings;
+        for (int i = 0; i < 256; i++)
+        {
+            strings.push_back(string_val(std::string(1, (char)i)));
+        }
+        return strings;
+    }();
+    return strings[byte];
+}
 
-        instruction_index++;
+// Builtins that read a range as it is. Every other native, including
+// those from modules, is handed a list in its place.
+static bool takes_ranges(NativeFunction function)
+{
+    return function == print_builtin || function == println_builtin || function == to_string_builtin ||
+           function == length_builtin || function == type_builtin || function == copy_builtin ||
+           function == id_builtin;
+}
 
-        while (true)
+// Moves a native call's arguments off the stack, top first, spreading
+// unpacked lists into individual arguments
+static void pop_native_args(VM &vm, int param_num, std::vector<Value> &args, NativeFunction function)
+{
+    args.reserve(param_num);
+    bool keep_ranges = takes_ranges(function);
+    for (int i = 0; i < param_num; i++)
+    {
+        Value arg = pop(vm);
+        if (arg.meta.unpack)
         {
-            if (instruction_index == 0)
+            arg.meta.unpack = false;
+            for (auto &elem : *arg.get_list())
             {
-                int to_clean = vm.stack.size() - frame.sp;
-                for (int i = 0; i < to_clean; i++)
-                {
-                    vm.stack.pop_back();
-                }
+                args.push_back(elem);
+            }
+        }
+        else if (arg.is_range() && !keep_ranges)
+        {
+            args.push_back(range_list(arg));
+        }
+        else
+        {
+            args.push_back(std::move(arg));
+        }
+    }
+}
 
-                last_frame -= 1;
-                frame = vm.frames[last_frame];
+// Closes every open closure that points at `last` or above it. The list is
+// ordered by stack address, so those are always at its end.
+void close_values(VM &vm, Value *last)
+{
+    auto &open = vm.open_closures;
+    while (!open.empty() && open.back()->location >= last)
+    {
+        auto &closure = open.back();
+        closure->closed = *closure->location;
+        closure->location = &closure->closed;
+        open.pop_back();
+    }
+}
 
-                if (frame.function->is_generator && frame.function->generator_init)
-                {
-                    frame = *vm.gen_frames[frame.function->name];
-                }
+Value pop_close(VM &vm)
+{
+    close_values(vm, &vm.stack.back());
+    return pop(vm);
+}
 
-                current_offset = (int)(size_t)(frame.ip - &frame.function->chunk.code[0]);
-                instruction_index = std::find(frame.function->instruction_offsets.begin(), frame.function->instruction_offsets.end(), current_offset) - frame.function->instruction_offsets.begin();
-                instruction = frame.function->instruction_offsets[instruction_index];
-                _instruction = frame.function->chunk.code[instruction];
-                instruction_index++;
-            }
-            instruction_index--;
-            instruction = frame.function->instruction_offsets[instruction_index];
-            diff = instruction - frame.function->instruction_offsets[instruction_index - 1];
-            frame.ip -= diff;
-            _instruction = frame.function->chunk.code[instruction];
+#ifdef DEBUG_COUNT_COPIES
+static const char *opcode_names[] = {
+    "OP_RETURN",
+    "OP_YIELD",
+    "OP_YIELD_FROM",
+    "OP_LOAD_CONST",
+    "OP_NEGATE",
+    "OP_ADD",
+    "OP_SUBTRACT",
+    "OP_MULTIPLY",
+    "OP_DIVIDE",
+    "OP_MOD",
+    "OP_POW",
+    "OP_AND",
+    "OP_OR",
+    "OP_NOT",
+    "OP_EQ_EQ",
+    "OP_NOT_EQ",
+    "OP_LT_EQ",
+    "OP_GT_EQ",
+    "OP_LT",
+    "OP_GT",
+    "OP_RANGE",
+    "OP_DOT",
+    "OP_STORE_VAR",
+    "OP_LOAD",
+    "OP_LOAD_GLOBAL",
+    "OP_LOAD_CLOSURE",
+    "OP_SET",
+    "OP_SET_FORCE",
+    "OP_SET_PROPERTY",
+    "OP_SET_CLOSURE",
+    "OP_MAKE_CLOSURE",
+    "OP_MAKE_TYPE",
+    "OP_MAKE_TYPED",
+    "OP_MAKE_OBJECT",
+    "OP_MAKE_FUNCTION",
+    "OP_MAKE_CONST",
+    "OP_MAKE_NON_CONST",
+    "OP_TYPE_DEFAULTS",
+    "OP_POP",
+    "OP_POP_CLOSE",
+    "OP_JUMP_IF_FALSE",
+    "OP_JUMP_IF_TRUE",
+    "OP_POP_JUMP_IF_FALSE",
+    "OP_POP_JUMP_IF_TRUE",
+    "OP_JUMP",
+    "OP_JUMP_BACK",
+    "OP_EXIT",
+    "OP_BREAK",
+    "OP_CONTINUE",
+    "OP_BUILD_LIST",
+    "OP_ACCESSOR",
+    "OP_LEN",
+    "OP_CALL",
+    "OP_CALL_METHOD",
+    "OP_TAIL_CALL",
+    "OP_TAIL_CALL_METHOD",
+    "OP_IMPORT",
+    "OP_UNPACK",
+    "OP_REMOVE_PUSH",
+    "OP_SWAP_TOS",
+    "OP_HOOK_ONCHANGE",
+    "OP_HOOK_CLOSURE_ONCHANGE",
+    "OP_HOOK_ONACCESS",
+    "OP_HOOK_CLOSURE_ONACCESS",
+    "OP_LOAD_GLOBAL_OPTIONAL",
+    "OP_GET_PROPERTY",
+    "OP_GET_METHOD",
+    "OP_SET_PROPERTY_NAMED",
+    "OP_MAKE_SHAPED_OBJECT",
+    "OP_GET_ITER",
+    "OP_FOR_ITER",
+    "OP_ADD_NUM_NUM",
+    "OP_ADD_STR_STR",
+    "OP_EQ_EQ_NUM_NUM",
+    "OP_NOT_EQ_NUM_NUM",
+    "OP_ACCESS_LIST_NUM",
+    "OP_ACCESS_RANGE_NUM",
+    "OP_INCREMENT_LOCAL",
+    "OP_LOAD_LOAD",
+    "OP_SET_POP",
+    "OP_ADD_CONST",
+    "OP_SUBTRACT_CONST",
+    "OP_MULTIPLY_CONST",
+    "OP_LT_JUMP",
+    "OP_LT_EQ_JUMP",
+    "OP_GT_JUMP",
+    "OP_GT_EQ_JUMP",
+    "OP_LOAD_PROPERTY",
+    "OP_CALL_GLOBAL"};
+static_assert(sizeof(opcode_names) / sizeof(char *) == OP_COUNT, "opcode_names is out of sync with OpCode");
+
+// Copies and retains are charged to the opcode that was running when
+// they happened, including those made by natives it called
+static struct CopyCounts
+{
+    long long executed[OP_COUNT] = {};
+    long long copies[OP_COUNT] = {};
+    long long retains[OP_COUNT] = {};
+    int last_op = -1;
+    long long last_copies = 0;
+    long long last_retains = 0;
+
+    void count(uint8_t op)
+    {
+        if (last_op >= 0)
+        {
+            copies[last_op] += value_copies - last_copies;
+            retains[last_op] += ref_retains - last_retains;
+        }
+        executed[op]++;
+        last_op = op;
+        last_copies = value_copies;
+        last_retains = ref_retains;
+    }
 
-            if (_instruction == OP_TRY_END)
-            {
-                try_count++;
-            }
-            if (_instruction == OP_TRY_BEGIN)
+    ~CopyCounts()
+    {
+        count(OP_EXIT);
+        fprintf(stderr, "%-26s %12s %14s %14s\n", "opcode", "executed", "copies/op", "retains/op");
+        for (int op = 0; op < OP_COUNT; op++)
+        {
+            if (executed[op])
             {
-                try_count--;
-                if (try_count == 0)
-                {
-                    break;
-                }
+                fprintf(stderr, "%-26s %12lld %14.2f %14.2f\n", opcode_names[op], executed[op], (double)copies[op] / executed[op], (double)retains[op] / executed[op]);
             }
         }
+    }
+} copy_counts;
+#endif
+
+// Pops both operands of a binary operator and reports them as invalid
+static void operand_error(VM &vm, const std::string &op)
+{
+    Value v2 = pop(vm);
+    Value v1 = pop(vm);
+    runtimeError(vm, "Cannot perform operation '" + op + "' on values: " + v1.value_repr() + " (" + v1.type_repr() + "), " + v2.value_repr() + " (" + v2.type_repr() + ")");
+}
 
-        push(vm, error_obj);
+// Returns the innermost try block of the chunk that covers the
+// instruction just before ip, or null
+static ExceptionHandler *find_handler(Chunk &chunk, uint8_t *ip)
+{
+    int pc = (int)(ip - chunk.code.data()) - 1;
+    for (ExceptionHandler &handler : chunk.handlers)
+    {
+        if (pc >= handler.start && pc < handler.end)
+        {
+            return &handler;
+        }
+    }
+    return nullptr;
+}
 
-        instruction_index--;
+// Returns the innermost try block of the frame's function that covers
+// the instruction the frame is executing, or null
+static ExceptionHandler *find_handler(CallFrame &frame)
+{
+    return find_handler(frame.function->proto->chunk, frame.ip);
+}
 
-        while (true)
+// A delegate runs without the frames of the generators waiting on it
+// through yield from. Returns the nearest of those whose yield from sits
+// in a try block, with that block, or null.
+static FunctionObj *find_delegating_handler(CallFrame &frame, ExceptionHandler *&handler)
+{
+    FunctionObj *found = nullptr;
+    if (!frame.resumed || frame.resumed == frame.function)
+    {
+        return found;
+    }
+    for (FunctionObj *link = frame.resumed.get(); link && link != frame.function.get(); link = link->coroutine->delegate.get())
+    {
+        ExceptionHandler *covering = find_handler(link->proto->chunk, link->coroutine->ip);
+        if (covering)
         {
-            instruction_index++;
-            instruction = frame.function->instruction_offsets[instruction_index];
-            _instruction = frame.function->chunk.code[instruction];
-            frame.ip += diff;
-            diff = frame.function->instruction_offsets[instruction_index + 1] - instruction;
+            found = link;
+            handler = covering;
+        }
+    }
+    return found;
+}
 
-            if (_instruction == OP_TRY_BEGIN)
-            {
-                try_count++;
-            }
-            if (_instruction == OP_CATCH_BEGIN)
+// Finishes the delegate running in the top frame and the delegates
+// between it and waiting, then puts waiting's frame in its place
+static void resume_delegating(VM &vm, FunctionObj *waiting)
+{
+    CallFrame &top = vm.frames.back();
+    Ref<FunctionObj> root = top.resumed;
+    int instruction_index = top.instruction_index;
+    for (FunctionObj *link = waiting->coroutine->delegate.get(); link; link = link->coroutine->delegate.get())
+    {
+        link->generator_done = true;
+    }
+    waiting->coroutine->delegate = nullptr;
+    top.function->coroutine->running = false;
+    close_values(vm, vm.stack.data() + top.sp);
+    vm.stack.resize(top.sp);
+    vm.frames.pop_back();
+
+    CallFrame *frame;
+    resume_coroutine(vm, root, nullptr, instruction_index, frame);
+}
+
+// Pops frames above depth. A generator an error unwinds cannot be resumed
+// since its slots went with the stack, so it finishes along with the
+// generators delegating to it.
+static void unwind_frames(VM &vm, int depth)
+{
+    while ((int)vm.frames.size() > depth)
+    {
+        CallFrame &frame = vm.frames.back();
+        if (frame.function->coroutine)
+        {
+            frame.function->coroutine->running = false;
+            for (FunctionObj *link = frame.resumed.get(); link; link = link->coroutine->delegate.get())
             {
-                try_count--;
-                if (try_count == 0)
-                {
-                    break;
-                }
+                link->generator_done = true;
+                link->coroutine->loop_waiting = false;
             }
+            frame.function->generator_done = true;
+        }
+        vm.frames.pop_back();
+    }
+}
+
+static void runtimeError(VM &vm, std::string message, std::string error_type, ...)
+{
+    // Only frames this run loop owns can catch; a callback's caller gets
+    // anything they let through from vm_call
+    for (int i = vm.frames.size() - 1; i >= vm.return_depth; i--)
+    {
+        ExceptionHandler *handler = find_handler(vm.frames[i]);
+        FunctionObj *waiting = nullptr;
+        if (!handler)
+        {
+            waiting = find_delegating_handler(vm.frames[i], handler);
+        }
+        if (!handler)
+        {
+            continue;
         }
-        vm.try_instructions.pop_back();
 
-        if (frame.function->is_generator && frame.function->generator_init)
+        vm.status = 2;
+
+        Value error_obj;
+        if (handler->binds_error)
         {
-            *vm.gen_frames[frame.function->name] = frame;
+            CallFrame &top = vm.frames.back();
+            size_t instr = top.ip - top.function->proto->chunk.code.data() - 1;
+
+            error_obj = object_val();
+            error_obj.get_object()->keys = {"message", "type", "line", "path"};
+            error_obj.get_object()->values["message"] = string_val(message);
+            error_obj.get_object()->values["type"] = string_val(error_type);
+            error_obj.get_object()->values["line"] = number_val(get_line(top.function->proto->chunk, instr));
+            error_obj.get_object()->values["path"] = string_val(top.function->proto->name == "" ? top.name : top.function->proto->import_path);
         }
 
-        while (vm.frames.size() > last_frame + 1)
+        unwind_frames(vm, i + 1);
+        if (waiting)
         {
-            vm.frames.pop_back();
+            resume_delegating(vm, waiting);
         }
 
+        // Locals the try body declared but never reached read as none
+        CallFrame &frame = vm.frames[i];
+        int depth = frame.frame_start + handler->depth;
+        if ((int)vm.stack.size() > depth)
+        {
+            close_values(vm, vm.stack.data() + depth);
+        }
+        vm.stack.resize(depth);
+        if (handler->binds_error)
+        {
+            push(vm, std::move(error_obj));
+        }
+        frame.ip = frame.function->proto->chunk.code.data() + handler->handler;
         return;
     }
-    else
+
+    // Errors not caught inside a callback are handed back to vm_call
+    if (vm.return_depth > 0)
     {
         vm.status = 1;
+        vm.callback_error = error_object(message, error_type);
+        return;
     }
 
+    vm.status = 1;
+
     va_list args;
     va_start(args, error_type);
     vfprintf(stderr, (error_type + ": " + message).c_str(), args);
     va_end(args);
     fputs("\n", stderr);
 
-    CallFrame *prev_frame;
+    CallFrame *prev_frame = nullptr;
 
     for (int i = vm.frames.size() - 1; i >= 0; i--)
     {
@@ -177,15 +490,15 @@ static void runtimeError(VM &vm, std::string message, std::string error_type, ..
         prev_frame = frame;
 
         auto &function = frame->function;
-        size_t instruction = frame->ip - function->chunk.code.data() - 1;
-        if (function->name == "error" || function->name == "Error")
+        size_t instruction = frame->ip - function->proto->chunk.code.data() - 1;
+        if (function->proto->name == "error" || function->proto->name == "Error")
         {
             continue;
         }
         fprintf(stderr, "[line %d] in ",
-                function->chunk.lines[instruction]);
+                get_line(function->proto->chunk, instruction));
 
-        if (function->name == "")
+        if (function->proto->name == "")
         {
             std::string name = frame->name;
             if (name == "")
@@ -193,41 +506,134 @@ static void runtimeError(VM &vm, std::string message, std::string error_type, ..
                 name = "script";
             }
 
-            fprintf(stderr, "%s\n", (name + ":" + std::to_string(function->chunk.lines[instruction])).c_str());
+            fprintf(stderr, "%s\n", (name + ":" + std::to_string(get_line(function->proto->chunk, instruction))).c_str());
         }
         else
         {
-            if (function->import_path != "")
+            if (function->proto->import_path != "")
             {
-                fprintf(stderr, "%s:%d <%s>\n", function->import_path.c_str(), function->chunk.lines[instruction], function->name.c_str());
+                fprintf(stderr, "%s:%d <%s>\n", function->proto->import_path.c_str(), get_line(function->proto->chunk, instruction), function->proto->name.c_str());
             }
             else
             {
-                fprintf(stderr, "%s()\n", function->name.c_str());
+                fprintf(stderr, "%s()\n", function->proto->name.c_str());
             }
         }
     }
 }
 
+// Returns the slot the site's key has in the object, or -1 when the
+// object lacks it. Only tree shapes are cached, since they are never
+// freed and their address can't be reused by another shape.
+static inline int find_property(PropertyCache &cache, PropertyMap &values, const std::string &key)
+{
+    Shape *shape = values.shape.get();
+    uint64_t tag = (uint64_t)(uintptr_t)shape << 16;
+    for (auto &entry : cache.entries)
+    {
+        uint64_t cached = entry.load(std::memory_order_relaxed);
+        if ((cached & ~(uint64_t)0xFFFF) == tag)
+        {
+            return cached & 0xFFFF;
+        }
+    }
+
+    int slot = shape->find(key);
+    if (slot >= 0 && !shape->is_dictionary)
+    {
+        auto &entry = cache.entries[(tag >> 20) % PROPERTY_CACHE_SIZE];
+        entry.store(tag | slot, std::memory_order_relaxed);
+    }
+    return slot;
+}
+
+static void store_global(GlobalTable &globals, int slot, const std::string &name, Value value)
+{
+    if (slot >= (int)globals.values.size())
+    {
+        globals.values.resize(slot + 1);
+        globals.names.resize(slot + 1);
+    }
+    globals.values[slot] = value;
+    globals.names[slot] = name;
+}
+
+// Returns nullptr when the table does not define the slot
+static inline Value *find_global(GlobalTable &globals, int slot)
+{
+    if (slot >= (int)globals.names.size() || globals.names[slot].empty())
+    {
+        return nullptr;
+    }
+    return &globals.values[slot];
+}
+
+// Runs a property's onAccess hook with its value and hook name
+static Value call_access_hook(VM &vm, Value &value)
+{
+    Value obj = object_val();
+    obj.get_object()->keys = {"value", "name"};
+    Value value_pure = copy(value);
+    value_pure.set_hooks_id(0);
+    obj.get_object()->values["value"] = value_pure;
+    obj.get_object()->values["name"] = string_val(value.get_hooks().onAccessHookName);
+
+    std::vector<Value> hook_args = {obj};
+    Value result = vm_call(vm, *value.get_hooks().onAccessHook, hook_args);
+    obj.get_object()->values["value"].set_hooks_id(value.hooks_id);
+    return result;
+}
+
+// The function a method call site falls back to, loaded the way the
+// instruction its name resolved to would load it
+static Value method_fallback(VM &vm, CallFrame *frame, PropertyCache &cache)
+{
+    switch (cache.fallback_op)
+    {
+    case OP_LOAD:
+        return vm.stack[frame->frame_start + cache.fallback];
+    case OP_LOAD_CLOSURE:
+        return *frame->function->closed_vars[cache.fallback]->location;
+    default:
+    {
+        int slot = cache.fallback;
+        if (slot < 0)
+        {
+            slot = find_global_slot(frame->function->proto->chunk.constants[cache.name].get_string());
+        }
+        Value *global = slot < 0 ? nullptr : find_global(vm.globals, slot);
+        return global ? *global : none_val();
+    }
+    }
+}
+
+// Brings an imported VM's globals through, except its own __vm__ pointer
+static void merge_globals(GlobalTable &globals, GlobalTable &imported)
+{
+    for (int slot = 0; slot < (int)imported.names.size(); slot++)
+    {
+        if (!imported.names[slot].empty() && imported.names[slot] != "__vm__")
+        {
+            store_global(globals, slot, imported.names[slot], imported.values[slot]);
+        }
+    }
+}
+
 static void define_native(VM &vm, std::string name, NativeFunction function)
 {
     Value native = native_val();
     native.get_native()->function = function;
     native.get_native()->name = name;
-    vm.globals[name] = native;
+    define_global(vm, name, native);
 }
 
 static void define_global(VM &vm, std::string name, Value value)
 {
-    vm.globals[name] = value;
+    store_global(vm.globals, global_slot(name), name, value);
 }
 
-static EvaluateResult run(VM &vm)
+static void define_builtins(VM &vm)
 {
-#define READ_BYTE() (*frame->ip++)
-#define READ_INT() (bytes_to_int(READ_BYTE(), READ_BYTE(), READ_BYTE(), READ_BYTE()))
-#define READ_CONSTANT() (frame->function->chunk.constants[READ_INT()])
-
     // Define globals
     define_global(vm, "String", type_val("String"));
     define_global(vm, "Number", type_val("Number"));
@@ -262,17 +668,154 @@ static EvaluateResult run(VM &vm)
     define_native(vm, "__future__", future_builtin);
     define_native(vm, "__get_future__", get_future_builtin);
     define_native(vm, "__check_future__", check_future_builtin);
+    define_native(vm, "__collect__", collect_builtin);
+    define_native(vm, "__collector_stats__", collector_stats_builtin);
+    define_native(vm, "__collector_threshold__", collector_threshold_builtin);
+    define_native(vm, "__global_slots__", global_slots_builtin);
     define_native(vm, "exit", exit_builtin);
     define_native(vm, "error", error_builtin);
     define_native(vm, "Error", error_type_builtin);
     define_native(vm, "load_lib", load_lib_builtin);
+}
 
-    CallFrame *frame = &vm.frames.back();
-    frame->ip = frame->function->chunk.code.data();
-    frame->frame_start = vm.stack.size();
+static EvaluateResult run(VM &vm)
+{
+#define READ_BYTE() (*frame->ip++)
+#define READ_INT() (frame->ip += 4, bytes_to_int(frame->ip[-4], frame->ip[-3], frame->ip[-2], frame->ip[-1]))
+#define READ_OPERAND() (*frame->ip != OPERAND_WIDE ? (int)READ_BYTE() : (frame->ip++, READ_INT()))
+#define READ_CONSTANT() (frame->function->proto->chunk.constants[READ_OPERAND()])
+#ifdef DEBUG_COUNT_COPIES
+#define COUNT_COPIES() copy_counts.count(*frame->ip)
+#else
+#define COUNT_COPIES()
+#endif
+
+    // With GCC/Clang every handler jumps straight to the next one through
+    // a table of label addresses instead of going back through the switch.
+    // The table has to follow the order of the OpCode enum.
+#if defined(__GNUC__) && !defined(DEBUG_TRACE_EXECUTION)
+#define USE_COMPUTED_GOTO
+    static void *dispatch_table[] = {
+        &&TARGET_OP_RETURN,
+        &&TARGET_OP_YIELD,
+        &&TARGET_OP_YIELD_FROM,
+        &&TARGET_OP_LOAD_CONST,
+        &&TARGET_OP_NEGATE,
+        &&TARGET_OP_ADD,
+        &&TARGET_OP_SUBTRACT,
+        &&TARGET_OP_MULTIPLY,
+        &&TARGET_OP_DIVIDE,
+        &&TARGET_OP_MOD,
+        &&TARGET_OP_POW,
+        &&TARGET_OP_AND,
+        &&TARGET_OP_OR,
+        &&TARGET_OP_NOT,
+        &&TARGET_OP_EQ_EQ,
+        &&TARGET_OP_NOT_EQ,
+        &&TARGET_OP_LT_EQ,
+        &&TARGET_OP_GT_EQ,
+        &&TARGET_OP_LT,
+        &&TARGET_OP_GT,
+        &&TARGET_OP_RANGE,
+        &&TARGET_UNKNOWN,
+        &&TARGET_UNKNOWN,
+        &&TARGET_OP_LOAD,
+        &&TARGET_OP_LOAD_GLOBAL,
+        &&TARGET_OP_LOAD_CLOSURE,
+        &&TARGET_OP_SET,
+        &&TARGET_OP_SET_FORCE,
+        &&TARGET_OP_SET_PROPERTY,
+        &&TARGET_OP_SET_CLOSURE,
+        &&TARGET_OP_MAKE_CLOSURE,
+        &&TARGET_OP_MAKE_TYPE,
+        &&TARGET_OP_MAKE_TYPED,
+        &&TARGET_OP_MAKE_OBJECT,
+        &&TARGET_OP_MAKE_FUNCTION,
+        &&TARGET_OP_MAKE_CONST,
+        &&TARGET_OP_MAKE_NON_CONST,
+        &&TARGET_OP_TYPE_DEFAULTS,
+        &&TARGET_OP_POP,
+        &&TARGET_OP_POP_CLOSE,
+        &&TARGET_OP_JUMP_IF_FALSE,
+        &&TARGET_OP_JUMP_IF_TRUE,
+        &&TARGET_OP_POP_JUMP_IF_FALSE,
+        &&TARGET_OP_POP_JUMP_IF_TRUE,
+        &&TARGET_OP_JUMP,
+        &&TARGET_OP_JUMP_BACK,
+        &&TARGET_OP_EXIT,
+        &&TARGET_OP_CONTINUE, // OP_BREAK shares its handler
+        &&TARGET_OP_CONTINUE,
+        &&TARGET_OP_BUILD_LIST,
+        &&TARGET_OP_ACCESSOR,
+        &&TARGET_OP_LEN,
+        &&TARGET_OP_CALL,
+        &&TARGET_OP_CALL_METHOD,
+        &&TARGET_OP_TAIL_CALL,
+        &&TARGET_OP_TAIL_CALL_METHOD,
+        &&TARGET_OP_IMPORT,
+        &&TARGET_OP_UNPACK,
+        &&TARGET_OP_REMOVE_PUSH,
+        &&TARGET_OP_SWAP_TOS,
+        &&TARGET_OP_HOOK_ONCHANGE,
+        &&TARGET_OP_HOOK_CLOSURE_ONCHANGE,
+        &&TARGET_OP_HOOK_ONACCESS,
+        &&TARGET_OP_HOOK_CLOSURE_ONACCESS,
+        &&TARGET_OP_LOAD_GLOBAL_OPTIONAL,
+        &&TARGET_OP_GET_PROPERTY,
+        &&TARGET_OP_GET_METHOD,
+        &&TARGET_OP_SET_PROPERTY_NAMED,
+        &&TARGET_OP_MAKE_SHAPED_OBJECT,
+        &&TARGET_OP_GET_ITER,
+        &&TARGET_OP_FOR_ITER,
+        &&TARGET_OP_ADD_NUM_NUM,
+        &&TARGET_OP_ADD_STR_STR,
+        &&TARGET_OP_EQ_EQ_NUM_NUM,
+        &&TARGET_OP_NOT_EQ_NUM_NUM,
+        &&TARGET_OP_ACCESS_LIST_NUM,
+        &&TARGET_OP_ACCESS_RANGE_NUM,
+        &&TARGET_OP_INCREMENT_LOCAL,
+        &&TARGET_OP_LOAD_LOAD,
+        &&TARGET_OP_SET_POP,
+        &&TARGET_OP_ADD_CONST,
+        &&TARGET_OP_SUBTRACT_CONST,
+        &&TARGET_OP_MULTIPLY_CONST,
+        &&TARGET_OP_LT_JUMP,
+        &&TARGET_OP_LT_EQ_JUMP,
+        &&TARGET_OP_GT_JUMP,
+        &&TARGET_OP_GT_EQ_JUMP,
+        &&TARGET_OP_LOAD_PROPERTY,
+        &&TARGET_OP_CALL_GLOBAL,
+    };
+    static_assert(sizeof(dispatch_table) / sizeof(void *) == OP_COUNT, "dispatch_table is out of sync with OpCode");
+// A computed goto out of a handler's block would skip the destructors of
+// its locals, so TARGET wraps the block in an outer one and DISPATCH()
+// first leaves it with a plain goto to the handler's own next label.
+// That reloads the frame, which calls and returns may have replaced.
+#define TARGET(op) \
+    case op:       \
+    TARGET_##op:   \
+    {              \
+        __label__ next;
+#define END_TARGET()                       \
+    next:                                  \
+        frame = &vm.frames.back();         \
+        COUNT_COPIES();                    \
+        goto *dispatch_table[READ_BYTE()]; \
+    }
+#define DISPATCH() goto next
+#else
+#define TARGET(op) case op:
+#define END_TARGET()
+#define DISPATCH() break
+#endif
+
+    CallFrame *frame;
 
     for (;;)
     {
+        // Handlers that finish with break instead of DISPATCH() land here,
+        // including after a caught error that unwound some frames
+        frame = &vm.frames.back();
 #ifdef DEBUG_TRACE_EXECUTION
         printf("          ");
         printf("[ ");
@@ -285,21 +828,21 @@ static EvaluateResult run(VM &vm)
         printf("\n");
         disassemble_instruction(frame->function->chunk, (int)(size_t)(frame->ip - &frame->function->chunk.code[0]));
 #endif
-        uint8_t instruction;
-        switch (instruction = READ_BYTE())
+        COUNT_COPIES();
+#ifdef USE_COMPUTED_GOTO
+        goto *dispatch_table[READ_BYTE()];
+#endif
+        switch (READ_BYTE())
         {
-        case OP_EXIT:
+        TARGET(OP_EXIT)
         {
-            for (auto &closure : vm.closed_values)
-            {
-                closure->closed = *closure->location;
-                closure->location = &closure->closed;
-            }
+            close_values(vm, vm.stack.data());
             return EVALUATE_OK;
         }
-        case OP_RETURN:
+        END_TARGET()
+        TARGET(OP_RETURN)
         {
-            if (frame->function->is_generator)
+            if (frame->function->proto->is_generator)
             {
                 frame->function->generator_done = true;
             }
@@ -318,159 +861,188 @@ static EvaluateResult run(VM &vm)
             }
 
             return_value.meta.temp_non_const = false;
-            if (frame->function->is_type_generator && return_value.is_object())
+            if (frame->function->proto->is_type_generator && return_value.is_object())
             {
-                return_value.get_object()->type_name = frame->function->name;
+                return_value.get_object()->type_name = frame->function->proto->name;
             }
-            int to_clean = vm.stack.size() - frame->sp;
             int instruction_index = frame->instruction_index;
-            for (int i = 0; i < to_clean; i++)
+            close_values(vm, vm.stack.data() + frame->sp);
+            vm.stack.resize(frame->sp);
+
+            // A delegate that finished hands control back to the generator
+            // waiting on it, which carries on after its yield from
+            if (frame->resumed && frame->resumed != frame->function)
             {
-                Value &value = vm.stack.back();
-                for (auto &closure : vm.closed_values)
+                Ref<FunctionObj> root = frame->resumed;
+                vm.frames.pop_back();
+                if (!resume_coroutine(vm, root, nullptr, instruction_index, frame))
                 {
-                    if (closure->location == &value)
+                    if (vm.status == 2)
                     {
-                        closure->closed = value;
-                        closure->location = &closure->closed;
+                        vm.status = 0;
                         break;
                     }
+
+                    return EVALUATE_RUNTIME_ERROR;
                 }
-                vm.stack.pop_back();
+                DISPATCH();
             }
 
             vm.frames.pop_back();
+            if ((int)vm.frames.size() == vm.return_depth)
+            {
+                push(vm, std::move(return_value));
+                return EVALUATE_OK;
+            }
             frame = &vm.frames.back();
-            frame->ip = &frame->function->chunk.code[instruction_index];
-            push(vm, return_value);
-            break;
+            frame->ip = &frame->function->proto->chunk.code[instruction_index];
+            push(vm, std::move(return_value));
+            DISPATCH();
         }
-        case OP_YIELD:
+        END_TARGET()
+        TARGET(OP_YIELD)
         {
-            frame->gen_stack.clear();
             Value return_value = pop(vm);
-            int to_clean = vm.stack.size() - frame->sp;
             int instruction_index = frame->instruction_index;
-            for (int i = 0; i < to_clean; i++)
-            {
-                Value &value = vm.stack.back();
-                for (auto &closure : vm.closed_values)
-                {
-                    if (closure->location == &value)
-                    {
-                        closure->closed = value;
-                        closure->location = &closure->closed;
-                        break;
-                    }
-                }
-                frame->gen_stack.insert(frame->gen_stack.begin(), value);
-                vm.stack.pop_back();
-            }
-            *vm.gen_frames[frame->function->name] = *frame;
+            close_values(vm, vm.stack.data() + frame->sp);
+
+            // The frame's live slots move into the instance's own segment
+            Coroutine &coroutine = *frame->function->coroutine;
+            coroutine.slots.assign(std::make_move_iterator(vm.stack.begin() + frame->sp), std::make_move_iterator(vm.stack.end()));
+            coroutine.ip = frame->ip;
+            coroutine.running = false;
+            vm.stack.resize(frame->sp);
             vm.frames.pop_back();
-            frame = &vm.frames.back();
-            frame->ip = &frame->function->chunk.code[instruction_index];
-            push(vm, return_value);
-            break;
-        }
-        case OP_TRY_BEGIN:
-        {
-            int index = READ_INT();
-            vm.try_instructions.push_back(index);
-            break;
-        }
-        case OP_TRY_END:
-        {
-            vm.try_instructions.pop_back();
-            break;
-        }
-        case OP_CATCH_BEGIN:
-        {
-            break;
-        }
-        case OP_LOAD_THIS:
-        {
-            if (!frame->function->object)
+            if ((int)vm.frames.size() == vm.return_depth)
             {
-                Value none = none_val();
-                push(vm, none);
-            }
-            else
-            {
-                Value &value = *frame->function->object;
-                value.meta.temp_non_const = true;
-                push(vm, value);
+                push(vm, std::move(return_value));
+                return EVALUATE_OK;
             }
-            break;
-        }
-        case OP_LOAD_CONST:
-        {
-            Value constant = READ_CONSTANT();
-            push(vm, constant);
-            break;
+            frame = &vm.frames.back();
+            frame->ip = &frame->function->proto->chunk.code[instruction_index];
+            push(vm, std::move(return_value));
+            DISPATCH();
         }
-        case OP_LOAD:
+        END_TARGET()
+        TARGET(OP_YIELD_FROM)
         {
-            int index = READ_INT();
-            Value &value = vm.stack[index + frame->frame_start];
-            push(vm, value);
-            if (value.hooks.onAccessHook)
+            Value delegate = pop(vm);
+            if (!delegate.is_function() || !delegate.get_function()->coroutine)
             {
-                Value obj = object_val();
-                obj.get_object()->keys = {"value", "name"};
-                Value value_pure = copy(value);
-                value_pure.hooks.onAccessHook = nullptr;
-                value_pure.hooks.onChangeHook = nullptr;
-                obj.get_object()->values["value"] = value_pure;
-                obj.get_object()->values["name"] = string_val(value.hooks.onAccessHookName);
-
-                VM func_vm;
-                std::shared_ptr<FunctionObj> main = std::make_shared<FunctionObj>();
-                main->name = "";
-                main->arity = 0;
-                main->chunk = Chunk();
-                main->chunk.import_path = frame->function->chunk.import_path;
-                CallFrame main_frame;
-                main_frame.name = frame->name;
-                main_frame.function = main;
-                main_frame.sp = 0;
-                main_frame.ip = main->chunk.code.data();
-                main_frame.frame_start = 0;
-                func_vm.frames.push_back(main_frame);
-
-                add_constant(main->chunk, *value.hooks.onAccessHook);
-                add_constant(main->chunk, obj);
-
-                add_opcode(main->chunk, OP_LOAD_CONST, 1, 0);
-                add_opcode(main->chunk, OP_LOAD_CONST, 0, 0);
-                add_opcode(main->chunk, OP_CALL, 1, 0);
-                add_code(main->chunk, OP_EXIT, 0);
-
-                auto offsets = instruction_offsets(main_frame.function->chunk);
-                main_frame.function->instruction_offsets = offsets;
-
-                auto status = evaluate(func_vm);
-
-                if (status != 0)
+                runtimeError(vm, "Can only yield from a generator, got: " + delegate.value_repr() + " (" + delegate.type_repr() + ")");
+                if (vm.status == 2)
                 {
-                    exit(1);
+                    vm.status = 0;
+                    break;
                 }
 
-                obj.get_object()->values["value"].hooks.onChangeHook = value.hooks.onChangeHook;
-                obj.get_object()->values["value"].hooks.onChangeHookName = value.hooks.onChangeHookName;
-                obj.get_object()->values["value"].hooks.onAccessHook = value.hooks.onAccessHook;
-                obj.get_object()->values["value"].hooks.onAccessHookName = value.hooks.onAccessHookName;
-                break;
+                return EVALUATE_RUNTIME_ERROR;
             }
-            break;
+
+            // A generator already in this delegation chain would resume itself
+            bool cycle = false;
+            for (FunctionObj *link = delegate.get_function().get(); link; link = link->coroutine->delegate.get())
+            {
+                if (link == frame->function.get())
+                {
+                    cycle = true;
+                    break;
+                }
+            }
+            if (cycle)
+            {
+                runtimeError(vm, "Generator cannot yield from itself");
+                if (vm.status == 2)
+                {
+                    vm.status = 0;
+                    break;
+                }
+
+                return EVALUATE_RUNTIME_ERROR;
+            }
+
+            if (delegate.get_function()->generator_done)
+            {
+                DISPATCH();
+            }
+
+            // Suspend like OP_YIELD, then resume on behalf of the same caller,
+            // which now reaches the delegate
+            Ref<FunctionObj> root = frame->resumed;
+            int instruction_index = frame->instruction_index;
+            close_values(vm, vm.stack.data() + frame->sp);
+            Coroutine &coroutine = *frame->function->coroutine;
+            coroutine.slots.assign(std::make_move_iterator(vm.stack.begin() + frame->sp), std::make_move_iterator(vm.stack.end()));
+            coroutine.ip = frame->ip;
+            coroutine.running = false;
+            coroutine.delegate = delegate.get_function();
+            vm.stack.resize(frame->sp);
+            vm.frames.pop_back();
+
+            if (!resume_coroutine(vm, root, nullptr, instruction_index, frame))
+            {
+                if (vm.status == 2)
+                {
+                    vm.status = 0;
+                    break;
+                }
+
+                return EVALUATE_RUNTIME_ERROR;
+            }
+            DISPATCH();
         }
-        case OP_SET:
+        END_TARGET()
+        TARGET(OP_LOAD_CONST)
         {
-            int index = READ_INT();
-            Value value = vm.stack[index + frame->frame_start];
-            if (value.meta.is_const)
+        load_const:
+            push(vm, READ_CONSTANT());
+            DISPATCH();
+        }
+        END_TARGET()
+        TARGET(OP_LOAD)
+        {
+        load_local:
+            int index = READ_OPERAND();
+            Value &value = vm.stack[index + frame->frame_start];
+            push(vm, value);
+            if (value.hooks_id && value.get_hooks().onAccessHook)
             {
-                if (!value.meta.temp_non_const)
+                Value obj = object_val();
+                obj.get_object()->keys = {"value", "name"};
+                Value value_pure = copy(value);
+                value_pure.set_hooks_id(0);
+                obj.get_object()->values["value"] = value_pure;
+                obj.get_object()->values["name"] = string_val(value.get_hooks().onAccessHookName);
+
+                std::vector<Value> hook_args = {obj};
+                Value result = vm_call(vm, *value.get_hooks().onAccessHook, hook_args);
+
+                if (result.is_object() && result.get_object()->type_name == "Error")
+                {
+                    runtimeError(vm, result.get_object()->values["message"].get_string(), result.get_object()->values["type"].get_string());
+                    if (vm.status == 2)
+                    {
+                        vm.status = 0;
+                        break;
+                    }
+
+                    return EVALUATE_RUNTIME_ERROR;
+                }
+
+                obj.get_object()->values["value"].set_hooks_id(value.hooks_id);
+                break;
+            }
+            DISPATCH();
+        }
+        END_TARGET()
+        TARGET(OP_SET)
+        {
+        set_local:
+            int index = READ_OPERAND();
+            Value &slot = vm.stack[index + frame->frame_start];
+            if (slot.meta.is_const)
+            {
+                if (!slot.meta.temp_non_const)
                 {
                     runtimeError(vm, "Cannot modify const");
                     if (vm.status == 2)
@@ -482,74 +1054,66 @@ static EvaluateResult run(VM &vm)
                     return EVALUATE_RUNTIME_ERROR;
                 }
             }
-            if (value.hooks.onChangeHook)
+            if (slot.hooks_id && slot.get_hooks().onChangeHook)
             {
+                Value value = slot;
                 Value new_value = pop(vm);
 
                 Value obj = object_val();
                 obj.get_object()->keys = {"old", "current", "name"};
                 Value old_pure = copy(value);
-                old_pure.hooks.onChangeHook = nullptr;
-                old_pure.hooks.onAccessHook = nullptr;
+                old_pure.set_hooks_id(0);
                 obj.get_object()->values["old"] = old_pure;
                 obj.get_object()->values["current"] = new_value;
-                obj.get_object()->values["name"] = string_val(value.hooks.onChangeHookName);
+                obj.get_object()->values["name"] = string_val(value.get_hooks().onChangeHookName);
 
                 vm.stack[index + frame->frame_start] = new_value;
 
-                VM func_vm;
-                std::shared_ptr<FunctionObj> main = std::make_shared<FunctionObj>();
-                main->name = "";
-                main->arity = 0;
-                main->chunk = Chunk();
-                main->chunk.import_path = frame->function->chunk.import_path;
-                CallFrame main_frame;
-                main_frame.name = frame->name;
-                main_frame.function = main;
-                main_frame.sp = 0;
-                main_frame.ip = main->chunk.code.data();
-                main_frame.frame_start = 0;
-                func_vm.frames.push_back(main_frame);
-
-                add_constant(main->chunk, *value.hooks.onChangeHook);
-                add_constant(main->chunk, obj);
-
-                add_opcode(main->chunk, OP_LOAD_CONST, 1, 0);
-                add_opcode(main->chunk, OP_LOAD_CONST, 0, 0);
-                add_opcode(main->chunk, OP_CALL, 1, 0);
-                add_code(main->chunk, OP_EXIT, 0);
-
-                auto offsets = instruction_offsets(main_frame.function->chunk);
-                main_frame.function->instruction_offsets = offsets;
-
-                auto status = evaluate(func_vm);
+                std::vector<Value> hook_args = {obj};
+                Value result = vm_call(vm, *value.get_hooks().onChangeHook, hook_args);
 
-                if (status != 0)
+                if (result.is_object() && result.get_object()->type_name == "Error")
                 {
-                    exit(1);
+                    runtimeError(vm, result.get_object()->values["message"].get_string(), result.get_object()->values["type"].get_string());
+                    if (vm.status == 2)
+                    {
+                        vm.status = 0;
+                        break;
+                    }
+
+                    return EVALUATE_RUNTIME_ERROR;
                 }
 
-                obj.get_object()->values["current"].hooks.onChangeHook = value.hooks.onChangeHook;
-                obj.get_object()->values["current"].hooks.onChangeHookName = value.hooks.onChangeHookName;
-                obj.get_object()->values["current"].hooks.onAccessHook = value.hooks.onAccessHook;
-                obj.get_object()->values["current"].hooks.onAccessHookName = value.hooks.onAccessHookName;
+                obj.get_object()->values["current"].set_hooks_id(value.hooks_id);
                 push(vm, obj.get_object()->values["current"]);
                 vm.stack[index + frame->frame_start] = vm.stack.back();
                 break;
             }
-            vm.stack[index + frame->frame_start] = vm.stack.back();
-            vm.stack[index + frame->frame_start].meta.is_const = false;
-            break;
+            slot = vm.stack.back();
+            slot.meta.is_const = false;
+            DISPATCH();
         }
-        case OP_SET_FORCE:
+        END_TARGET()
+        TARGET(OP_SET_FORCE)
         {
-            int index = READ_INT();
-            Value value = vm.stack[index + frame->frame_start];
+            int index = READ_OPERAND();
             vm.stack[index + frame->frame_start] = vm.stack.back();
-            break;
+            DISPATCH();
         }
-        case OP_SET_PROPERTY:
+        END_TARGET()
+        TARGET(OP_SET_PROPERTY)
         {
+            {
+                // The key was computed, so a new one makes the object a
+                // dictionary instead of adding a shape nothing will share
+                Value &container = vm.stack[vm.stack.size() - 3];
+                Value &accessor = vm.stack[vm.stack.size() - 2];
+                if (container.is_object() && accessor.is_string() && (!container.meta.is_const || container.meta.temp_non_const))
+                {
+                    container.get_object()->values.insert_computed(accessor.get_string());
+                }
+            }
+        set_property:
             Value value = pop(vm);
             Value accessor = pop(vm);
             Value container = pop(vm);
@@ -581,75 +1145,52 @@ static EvaluateResult run(VM &vm)
 
                     return EVALUATE_RUNTIME_ERROR;
                 }
-                Value current = container.get_object()->values[accessor.get_string()];
+                Value &slot = container.get_object()->values[accessor.get_string()];
 
-                if (current.hooks.onChangeHook)
+                if (slot.hooks_id && slot.get_hooks().onChangeHook)
                 {
+                    Value current = slot;
                     Value obj = object_val();
                     obj.get_object()->keys = {"old", "current", "name"};
 
                     Value old_pure = copy(current);
-                    old_pure.hooks.onChangeHook = nullptr;
-                    old_pure.hooks.onAccessHook = nullptr;
+                    old_pure.set_hooks_id(0);
                     obj.get_object()->values["old"] = old_pure;
                     obj.get_object()->values["current"] = value;
-                    obj.get_object()->values["name"] = string_val(current.hooks.onChangeHookName);
+                    obj.get_object()->values["name"] = string_val(current.get_hooks().onChangeHookName);
 
                     container.get_object()->values[accessor.get_string()] = value;
 
                     // store onChangeHook here
-                    auto hook = current.hooks.onChangeHook;
-                    obj.get_object()->values["old"].hooks.onChangeHook = nullptr;
-
-                    auto value_hook = obj.get_object()->values["current"].hooks.onChangeHook;
-                    obj.get_object()->values["current"].hooks.onChangeHook = nullptr;
-
-                    VM func_vm;
-                    std::shared_ptr<FunctionObj> main = std::make_shared<FunctionObj>();
-                    main->name = "";
-                    main->arity = 0;
-                    main->chunk = Chunk();
-                    main->chunk.import_path = frame->function->chunk.import_path;
-                    CallFrame main_frame;
-                    main_frame.name = frame->name;
-                    main_frame.function = main;
-                    main_frame.sp = 0;
-                    main_frame.ip = main->chunk.code.data();
-                    main_frame.frame_start = 0;
-                    func_vm.frames.push_back(main_frame);
+                    auto hook = current.get_hooks().onChangeHook;
+                    uint32_t value_hooks = obj.get_object()->values["current"].hooks_id;
+                    obj.get_object()->values["current"].set_hooks_id(0);
 
-                    add_constant(main->chunk, *hook);
-                    add_constant(main->chunk, obj);
+                    std::vector<Value> hook_args = {obj};
+                    Value result = vm_call(vm, *hook, hook_args);
 
-                    add_opcode(main->chunk, OP_LOAD_CONST, 1, 0);
-                    add_opcode(main->chunk, OP_LOAD_CONST, 0, 0);
-                    add_opcode(main->chunk, OP_CALL, 1, 0);
-                    add_code(main->chunk, OP_EXIT, 0);
+                    obj.get_object()->values["current"].set_hooks_id(value_hooks);
 
-                    auto offsets = instruction_offsets(main_frame.function->chunk);
-                    main_frame.function->instruction_offsets = offsets;
-
-                    auto status = evaluate(func_vm);
-
-                    obj.get_object()->values["old"].hooks.onChangeHook = hook;
-                    obj.get_object()->values["current"].hooks.onChangeHook = value_hook;
-
-                    if (status != 0)
+                    if (result.is_object() && result.get_object()->type_name == "Error")
                     {
-                        exit(1);
+                        runtimeError(vm, result.get_object()->values["message"].get_string(), result.get_object()->values["type"].get_string());
+                        if (vm.status == 2)
+                        {
+                            vm.status = 0;
+                            break;
+                        }
+
+                        return EVALUATE_RUNTIME_ERROR;
                     }
 
-                    obj.get_object()->values["current"].hooks.onChangeHook = current.hooks.onChangeHook;
-                    obj.get_object()->values["current"].hooks.onChangeHookName = current.hooks.onChangeHookName;
-                    obj.get_object()->values["current"].hooks.onAccessHook = current.hooks.onAccessHook;
-                    obj.get_object()->values["current"].hooks.onAccessHookName = current.hooks.onAccessHookName;
+                    obj.get_object()->values["current"].set_hooks_id(current.hooks_id);
                     push(vm, obj.get_object()->values["current"]);
                     container.get_object()->values[accessor.get_string()] = obj.get_object()->values["current"];
                     break;
                 }
-                std::string &accessor_string = accessor.get_string();
+                const std::string &accessor_string = accessor.get_string();
                 auto &keys = container.get_object()->keys;
-                container.get_object()->values[accessor_string] = value;
+                slot = std::move(value);
                 if (std::find(keys.begin(), keys.end(), accessor_string) == keys.end())
                 {
                     keys.push_back(accessor_string);
@@ -672,15 +1213,15 @@ static EvaluateResult run(VM &vm)
                 int acc = accessor.get_number();
                 if (acc < 0)
                 {
-                    list.insert(list.begin(), value);
+                    list.insert(list.begin(), std::move(value));
                 }
                 else if (acc >= list.size())
                 {
-                    list.push_back(value);
+                    list.push_back(std::move(value));
                 }
                 else
                 {
-                    list[acc] = value;
+                    list[acc] = std::move(value);
                 }
             }
             else if (container.is_string())
@@ -707,25 +1248,196 @@ static EvaluateResult run(VM &vm)
 
                     return EVALUATE_RUNTIME_ERROR;
                 }
-                auto &string = container.get_string();
-                int acc = accessor.get_number();
-                // TODO: Fix this
-                if (acc < 0)
+                // Strings are immutable and the container is a popped
+                // temporary, so the assignment never reaches the variable
+            }
+            else
+            {
+                runtimeError(vm, "Object is not accessible: " + container.value_repr() + " (" + container.type_repr() + ")");
+                if (vm.status == 2)
                 {
-                    string = value.get_string() + string;
+                    vm.status = 0;
+                    break;
                 }
-                else if (acc >= string.length())
+
+                return EVALUATE_RUNTIME_ERROR;
+            }
+            // push(vm, value);
+            push(vm, std::move(container));
+            DISPATCH();
+        }
+        END_TARGET()
+        TARGET(OP_LOAD_GLOBAL)
+        {
+        load_global:
+            int slot = READ_OPERAND();
+            Value *global = find_global(vm.globals, slot);
+            if (!global)
+            {
+                runtimeError(vm, "Global '" + global_slot_name(slot) + "' is undefined");
+                if (vm.status == 2)
                 {
-                    string += value.get_string();
+                    vm.status = 0;
+                    break;
                 }
-                else
+
+                return EVALUATE_RUNTIME_ERROR;
+            }
+            push(vm, *global);
+            DISPATCH();
+        }
+        END_TARGET()
+        TARGET(OP_LOAD_GLOBAL_OPTIONAL)
+        {
+            int slot = READ_OPERAND();
+            Value *global = find_global(vm.globals, slot);
+            if (!global)
+            {
+                Value none = none_val();
+                push(vm, none);
+                DISPATCH();
+            }
+            push(vm, *global);
+            DISPATCH();
+        }
+        END_TARGET()
+        TARGET(OP_GET_PROPERTY)
+        {
+        get_property:
+            PropertyCache &cache = frame->function->proto->chunk.property_caches[READ_OPERAND()];
+            Value &name = frame->function->proto->chunk.constants[cache.name];
+            Value &container = vm.stack.back();
+            if (container.is_object())
+            {
+                auto &values = container.get_object()->values;
+                int slot = find_property(cache, values, name.get_string());
+                if (slot < 0)
+                {
+                    container = none_val();
+                    DISPATCH();
+                }
+                if (!values.slots[slot].hooks_id)
                 {
-                    string[acc] = value.get_string()[0];
+                    Value value = values.slots[slot];
+                    container = std::move(value);
+                    DISPATCH();
                 }
             }
-            else
+            push(vm, name);
+            goto access_property;
+        }
+        END_TARGET()
+        TARGET(OP_GET_METHOD)
+        {
+            // Leaves the method under its receiver. A receiver without the
+            // method stays as the first argument, under the function the
+            // site falls back to and a None receiver.
+            PropertyCache &cache = frame->function->proto->chunk.property_caches[READ_OPERAND()];
+            Value &name = frame->function->proto->chunk.constants[cache.name];
+            Value &container = vm.stack.back();
+            if (container.is_object())
+            {
+                auto &values = container.get_object()->values;
+                int slot = find_property(cache, values, name.get_string());
+                if (slot >= 0 && !values.slots[slot].is_none())
+                {
+                    Value method = values.slots[slot];
+                    if (method.hooks_id && method.get_hooks().onAccessHook)
+                    {
+                        Value result = call_access_hook(vm, method);
+
+                        if (result.is_object() && result.get_object()->type_name == "Error")
+                        {
+                            runtimeError(vm, result.get_object()->values["message"].get_string(), result.get_object()->values["type"].get_string());
+                            if (vm.status == 2)
+                            {
+                                vm.status = 0;
+                                break;
+                            }
+
+                            return EVALUATE_RUNTIME_ERROR;
+                        }
+                    }
+                    // The hook may have grown the stack
+                    Value &receiver = vm.stack.back();
+                    Value object = receiver;
+                    receiver = std::move(method);
+                    push(vm, std::move(object));
+                    DISPATCH();
+                }
+            }
+            push(vm, method_fallback(vm, frame, cache));
+            push(vm, none_val());
+            DISPATCH();
+        }
+        END_TARGET()
+        TARGET(OP_SET_PROPERTY_NAMED)
+        {
+            PropertyCache &cache = frame->function->proto->chunk.property_caches[READ_OPERAND()];
+            Value &name = frame->function->proto->chunk.constants[cache.name];
+            Value &container = vm.stack[vm.stack.size() - 2];
+            if (container.is_object() && (!container.meta.is_const || container.meta.temp_non_const))
+            {
+                auto &values = container.get_object()->values;
+                int slot = find_property(cache, values, name.get_string());
+                if (slot >= 0 && !values.slots[slot].hooks_id)
+                {
+                    values.slots[slot] = pop(vm);
+                    DISPATCH();
+                }
+            }
+            Value value = pop(vm);
+            push(vm, name);
+            push(vm, value);
+            goto set_property;
+        }
+        END_TARGET()
+        TARGET(OP_MAKE_SHAPED_OBJECT)
+        {
+            PropertyCache &cache = frame->function->proto->chunk.property_caches[READ_OPERAND()];
+            Shape *shape = (Shape *)(uintptr_t)cache.entries[0].load(std::memory_order_acquire);
+            if (!shape)
+            {
+                Ref<Shape> built = empty_shape();
+                for (Value &key : *frame->function->proto->chunk.constants[cache.name].get_list())
+                {
+                    built = shape_with(built, key.get_string());
+                }
+                shape = built.get();
+                cache.entries[0].store((uint64_t)(uintptr_t)shape, std::memory_order_release);
+            }
+
+            Value object = object_val();
+            auto &object_obj = object.get_object();
+            int size = shape->keys.size();
+            object_obj->values.shape = Ref<Shape>(shape);
+            object_obj->values.slots.resize(size);
+            object_obj->keys = shape->keys;
+            for (int i = 0; i < size; i++)
+            {
+                object_obj->values.slots[i] = pop(vm);
+            }
+            push(vm, object);
+            DISPATCH();
+        }
+        END_TARGET()
+        TARGET(OP_GET_ITER)
+        {
+            // An object with an __iter__ method is iterated through what it
+            // returns. The name is reserved so plain data keys stay data.
+            Value &iterable = vm.stack.back();
+            if (!iterable.is_object() || !iterable.get_object()->values.count("__iter__"))
+            {
+                DISPATCH();
+            }
+            Value function = iterable.get_object()->values["__iter__"];
+            if (!function.is_function())
+            {
+                DISPATCH();
+            }
+            Value object = pop(vm);
+            if (call_function(vm, function, 0, frame, &object) != 0)
             {
-                runtimeError(vm, "Object is not accessible: " + container.value_repr() + " (" + container.type_repr() + ")");
                 if (vm.status == 2)
                 {
                     vm.status = 0;
@@ -734,45 +1446,149 @@ static EvaluateResult run(VM &vm)
 
                 return EVALUATE_RUNTIME_ERROR;
             }
-            // push(vm, value);
-            push(vm, container);
-            break;
+            DISPATCH();
         }
-        case OP_LOAD_GLOBAL:
+        END_TARGET()
+        TARGET(OP_FOR_ITER)
         {
-            int flag = READ_INT();
-            Value name = pop(vm);
-            std::string &name_str = name.get_string();
-            if (!vm.globals.count(name_str))
+            // Moves the loop's iterable, index and value locals on by one
+            // element. With one, it runs the OP_JUMP_BACK that follows
+            // straight away; at the end it skips it and leaves the loop.
+            uint8_t *start = frame->ip - 1;
+            int slot = READ_OPERAND();
+            Value *locals = vm.stack.data() + frame->frame_start + slot;
+            Value &iterable = locals[0];
+            Value &index = locals[1];
+            Value &value = locals[2];
+
+            if (!index.is_number())
             {
-                if (flag == 0)
+                runtimeError(vm, "Loop index must be a number - index: " + index.value_repr() + " (" + index.type_repr() + ")");
+                if (vm.status == 2)
                 {
-                    runtimeError(vm, "Global '" + name_str + "' is undefined");
-                    // pop(vm);
-                    if (vm.status == 2)
+                    vm.status = 0;
+                    break;
+                }
+
+                return EVALUATE_RUNTIME_ERROR;
+            }
+
+            int next = index.get_number() + 1;
+            bool produced = false;
+            bool resumed = false;
+            switch (iterable.type)
+            {
+            case List:
+            {
+                auto &list = iterable.get_list();
+                if (next < (int)list->size())
+                {
+                    value = (*list)[next];
+                    produced = true;
+                }
+                break;
+            }
+            case Range:
+                if (next < iterable.range_length())
+                {
+                    value = number_val(iterable.range_start() + next);
+                    produced = true;
+                }
+                break;
+            case String:
+            {
+                const std::string &string = iterable.get_string();
+                if (next < (int)string.length())
+                {
+                    value = byte_string(string[next]);
+                    produced = true;
+                }
+                break;
+            }
+            case Object:
+            {
+                auto &keys = iterable.get_object()->keys;
+                if (next < (int)keys.size())
+                {
+                    value = string_val(keys[next]);
+                    produced = true;
+                }
+                break;
+            }
+            case Function:
+            {
+                auto &generator = iterable.get_function();
+                if (!generator->coroutine)
+                {
+                    goto not_iterable;
+                }
+                // A resume started here comes back with what the generator
+                // yielded, or returned once it is done, on top of the locals
+                if (generator->coroutine->loop_waiting)
+                {
+                    generator->coroutine->loop_waiting = false;
+                    Value result = pop(vm);
+                    if (!generator->generator_done)
                     {
-                        vm.status = 0;
-                        break;
+                        value = std::move(result);
+                        produced = true;
                     }
-
-                    return EVALUATE_RUNTIME_ERROR;
+                    break;
                 }
-                else if (flag == 1)
+                if (generator->generator_done)
                 {
-                    Value none = none_val();
-                    push(vm, none);
                     break;
                 }
+                frame->ip = start;
+                Value callee = iterable;
+                if (call_function(vm, callee, 0, frame) != 0)
+                {
+                    goto for_iter_error;
+                }
+                generator->coroutine->loop_waiting = true;
+                resumed = true;
+                break;
             }
-            push(vm, vm.globals[name_str]);
-            break;
+            default:
+            not_iterable:
+                runtimeError(vm, "Cannot iterate over value: " + iterable.value_repr() + " (" + iterable.type_repr() + ")");
+                goto for_iter_error;
+            }
+
+            if (resumed)
+            {
+                DISPATCH();
+            }
+
+            if (!produced)
+            {
+                frame->ip += 5;
+                DISPATCH();
+            }
+            index = number_val(next);
+            frame->ip++;
+            frame->ip -= READ_INT();
+            if (collection_due.load(std::memory_order_relaxed))
+            {
+                collect_cycles();
+            }
+            DISPATCH();
+
+        for_iter_error:
+            if (vm.status == 2)
+            {
+                vm.status = 0;
+                break;
+            }
+
+            return EVALUATE_RUNTIME_ERROR;
         }
-        case OP_MAKE_OBJECT:
+        END_TARGET()
+        TARGET(OP_MAKE_OBJECT)
         {
-            int size = READ_INT();
+            int size = READ_OPERAND();
             Value object = object_val();
             auto &object_obj = object.get_object();
-            std::set<std::string> _keys;
             for (int i = 0; i < size; i++)
             {
                 Value tos = vm.stack.back();
@@ -823,7 +1639,7 @@ static EvaluateResult run(VM &vm)
                     return EVALUATE_RUNTIME_ERROR;
                 }
                 // object_obj->keys.insert(object_obj->keys.begin(), prop_name.get_string());
-                if (_keys.insert(prop_name.get_string()).second)
+                if (!object_obj->values.count(prop_name.get_string()))
                 {
                     object_obj->keys.push_back(prop_name.get_string());
                 }
@@ -831,26 +1647,30 @@ static EvaluateResult run(VM &vm)
                 object_obj->values[prop_name.get_string()] = prop_value;
             }
             push(vm, object);
-            break;
+            DISPATCH();
         }
-        case OP_MAKE_FUNCTION:
+        END_TARGET()
+        TARGET(OP_MAKE_FUNCTION)
         {
-            int count = READ_INT();
+            int count = READ_OPERAND();
             Value function = pop(vm);
             // std::string base_name = frame->name.substr(frame->name.find_last_of("/\\") + 1);
             // function.get_function()->import_path = std::filesystem::current_path().string() + "/" + base_name;
-            function.get_function()->import_path = frame->name;
+            function.get_function()->proto->import_path = frame->name;
             // function.get_function()->import_path = std::filesystem::absolute(frame->name);
-            for (int i = 0; i < count; i++)
+            auto &default_values = function.get_function()->default_values;
+            default_values.resize(count);
+            for (int i = count - 1; i >= 0; i--)
             {
-                function.get_function()->default_values.insert(function.get_function()->default_values.begin(), pop(vm));
+                default_values[i] = pop(vm);
             }
             push(vm, function);
-            break;
+            DISPATCH();
         }
-        case OP_MAKE_TYPE:
+        END_TARGET()
+        TARGET(OP_MAKE_TYPE)
         {
-            int size = READ_INT();
+            int size = READ_OPERAND();
             Value type = type_val("");
             auto &type_obj = type.get_type();
             for (int i = 0; i < size; i++)
@@ -864,21 +1684,24 @@ static EvaluateResult run(VM &vm)
             Value name = pop(vm);
             type_obj->name = name.get_string();
             push(vm, type);
-            break;
+            DISPATCH();
         }
-        case OP_MAKE_CONST:
+        END_TARGET()
+        TARGET(OP_MAKE_CONST)
         {
             vm.stack.back().meta.is_const = true;
-            break;
+            DISPATCH();
         }
-        case OP_MAKE_NON_CONST:
+        END_TARGET()
+        TARGET(OP_MAKE_NON_CONST)
         {
             vm.stack.back().meta.is_const = false;
-            break;
+            DISPATCH();
         }
-        case OP_TYPE_DEFAULTS:
+        END_TARGET()
+        TARGET(OP_TYPE_DEFAULTS)
         {
-            int size = READ_INT();
+            int size = READ_OPERAND();
             auto &type = vm.stack[vm.stack.size() - (size * 2) - 1];
             for (int i = 0; i < size; i++)
             {
@@ -887,65 +1710,49 @@ static EvaluateResult run(VM &vm)
 
                 type.get_type()->defaults[prop_name.get_string()] = prop_default;
             }
-            break;
+            DISPATCH();
         }
-        case OP_MAKE_TYPED:
+        END_TARGET()
+        TARGET(OP_MAKE_TYPED)
         {
             Value type = pop(vm);
             Value &object = vm.stack.back();
             object.get_object()->type = type.get_type();
-            break;
+            DISPATCH();
         }
-        case OP_MAKE_CLOSURE:
+        END_TARGET()
+        TARGET(OP_MAKE_CLOSURE)
         {
-            int index = READ_INT();
+            READ_OPERAND();
             auto function = pop(vm).get_function();
-            Value closure = function_val();
+            Value closure = function_val(function->proto);
             auto closure_obj = closure.get_function();
-            closure_obj->arity = function->arity;
-            closure_obj->closed_var_indexes = function->closed_var_indexes;
-            closure_obj->chunk = function->chunk;
-            closure_obj->defaults = function->defaults;
-            closure_obj->name = function->name;
-            closure_obj->params = function->params;
-            closure_obj->is_generator = function->is_generator;
             closure_obj->generator_init = function->generator_init;
             closure_obj->generator_done = function->generator_done;
-            closure_obj->is_type_generator = function->is_type_generator;
-            closure_obj->instruction_offsets = function->instruction_offsets;
-            closure_obj->closed_vars = std::vector<std::shared_ptr<Closure>>();
-
-            // auto compare_closures = [](const std::shared_ptr<Closure> &cl1, const std::shared_ptr<Closure> &cl2)
-            // {
-            //     return cl1->initial_location == cl2->initial_location;
-            // };
-
-            // auto pred = [](const std::shared_ptr<Closure> &cl1, const std::shared_ptr<Closure> &cl2)
-            // {
-            //     return cl1->initial_location < cl2->initial_location;
-            // };
 
-            // std::sort(vm.closed_values.begin(), vm.closed_values.end(), pred);
-
-            // auto new_vec = std::unique(vm.closed_values.begin(), vm.closed_values.end(), compare_closures);
-
-            // std::cout << vm.closed_values.size() << std::endl;
-
-            // vm.closed_values.erase(new_vec, vm.closed_values.end());
-
-            for (auto &var : closure_obj->closed_var_indexes)
+            for (auto &var : closure_obj->proto->closed_var_indexes)
             {
                 int index = var.index;
-                bool is_local = var.is_local;
-                Value *value_pointer;
-                if (is_local)
+
+                // A variable closed over by the enclosing function is shared
+                // through the enclosing function's closure
+                if (!var.is_local)
                 {
-                    value_pointer = &vm.stack[index + frame->frame_start];
+                    closure_obj->closed_vars.push_back(frame->function->closed_vars[index]);
+                    continue;
                 }
-                else
+
+                Value *value_pointer = &vm.stack[index + frame->frame_start];
+                auto &open = vm.open_closures;
+                auto it = std::lower_bound(open.begin(), open.end(), value_pointer, [](const std::shared_ptr<Closure> &closure, Value *location)
+                                           { return closure->location < location; });
+
+                if (it != open.end() && (*it)->location == value_pointer)
                 {
-                    value_pointer = frame->function->closed_vars[index]->location;
+                    closure_obj->closed_vars.push_back(*it);
+                    continue;
                 }
+
                 auto hoisted = std::make_shared<Closure>();
                 hoisted->location = value_pointer;
                 hoisted->frame_name = frame->name;
@@ -954,109 +1761,52 @@ static EvaluateResult run(VM &vm)
                 hoisted->is_local = var.is_local;
                 hoisted->initial_location = value_pointer;
 
-                if (vm.closed_values.size() == 0)
-                {
-                    closure_obj->closed_vars.push_back(hoisted);
-                    vm.closed_values.push_back(hoisted);
-                }
-                else
-                {
-                    bool found = false;
-
-                    for (auto &cl : vm.closed_values)
-                    {
-                        if (cl->location == value_pointer)
-                        {
-                            closure_obj->closed_vars.push_back(cl);
-                            found = true;
-                            break;
-                        }
-                    }
-
-                    if (!found)
-                    {
-                        bool f = false;
-                        for (auto &cl : vm.closed_values)
-                        {
-                            if (cl->initial_location == value_pointer)
-                            {
-                                cl = hoisted;
-                                f = true;
-                            }
-                        }
-                        if (!f)
-                        {
-                            vm.closed_values.push_back(hoisted);
-                        }
-                        closure_obj->closed_vars.push_back(hoisted);
-                        // vm.closed_values.push_back(hoisted);
-                    }
-                }
+                open.insert(it, hoisted);
+                closure_obj->closed_vars.push_back(hoisted);
             }
 
-            function->closed_vars = closure_obj->closed_vars;
-
             push(vm, closure);
-            break;
+            DISPATCH();
         }
-        case OP_LOAD_CLOSURE:
+        END_TARGET()
+        TARGET(OP_LOAD_CLOSURE)
         {
-            int index = READ_INT();
+            int index = READ_OPERAND();
             Value &value = *frame->function->closed_vars[index]->location;
             push(vm, value);
-            if (value.hooks.onAccessHook)
+            if (value.hooks_id && value.get_hooks().onAccessHook)
             {
                 Value obj = object_val();
                 obj.get_object()->keys = {"value", "name"};
                 Value value_pure = copy(value);
-                value_pure.hooks.onAccessHook = nullptr;
-                value_pure.hooks.onChangeHook = nullptr;
+                value_pure.set_hooks_id(0);
                 obj.get_object()->values["value"] = value_pure;
-                obj.get_object()->values["name"] = string_val(value.hooks.onAccessHookName);
-
-                VM func_vm;
-                std::shared_ptr<FunctionObj> main = std::make_shared<FunctionObj>();
-                main->name = "";
-                main->arity = 0;
-                main->chunk = Chunk();
-                main->chunk.import_path = frame->function->chunk.import_path;
-                CallFrame main_frame;
-                main_frame.name = frame->name;
-                main_frame.function = main;
-                main_frame.sp = 0;
-                main_frame.ip = main->chunk.code.data();
-                main_frame.frame_start = 0;
-                func_vm.frames.push_back(main_frame);
-
-                add_constant(main->chunk, *value.hooks.onAccessHook);
-                add_constant(main->chunk, obj);
-
-                add_opcode(main->chunk, OP_LOAD_CONST, 1, 0);
-                add_opcode(main->chunk, OP_LOAD_CONST, 0, 0);
-                add_opcode(main->chunk, OP_CALL, 1, 0);
-                add_code(main->chunk, OP_EXIT, 0);
+                obj.get_object()->values["name"] = string_val(value.get_hooks().onAccessHookName);
 
-                auto offsets = instruction_offsets(main_frame.function->chunk);
-                main_frame.function->instruction_offsets = offsets;
+                std::vector<Value> hook_args = {obj};
+                Value result = vm_call(vm, *value.get_hooks().onAccessHook, hook_args);
 
-                auto status = evaluate(func_vm);
-
-                if (status != 0)
+                if (result.is_object() && result.get_object()->type_name == "Error")
                 {
-                    exit(1);
+                    runtimeError(vm, result.get_object()->values["message"].get_string(), result.get_object()->values["type"].get_string());
+                    if (vm.status == 2)
+                    {
+                        vm.status = 0;
+                        break;
+                    }
+
+                    return EVALUATE_RUNTIME_ERROR;
                 }
 
-                obj.get_object()->values["value"].hooks.onChangeHook = value.hooks.onChangeHook;
-                obj.get_object()->values["value"].hooks.onChangeHookName = value.hooks.onChangeHookName;
-                obj.get_object()->values["value"].hooks.onAccessHook = value.hooks.onAccessHook;
-                obj.get_object()->values["value"].hooks.onAccessHookName = value.hooks.onAccessHookName;
+                obj.get_object()->values["value"].set_hooks_id(value.hooks_id);
                 break;
             }
-            break;
+            DISPATCH();
         }
-        case OP_SET_CLOSURE:
+        END_TARGET()
+        TARGET(OP_SET_CLOSURE)
         {
-            int index = READ_INT();
+            int index = READ_OPERAND();
             Value value = *frame->function->closed_vars[index]->location;
             if (value.meta.is_const)
             {
@@ -1072,7 +1822,7 @@ static EvaluateResult run(VM &vm)
                     return EVALUATE_RUNTIME_ERROR;
                 }
             }
-            if (value.hooks.onChangeHook)
+            if (value.hooks_id && value.get_hooks().onChangeHook)
             {
 
                 Value new_value = pop(vm);
@@ -1081,77 +1831,59 @@ static EvaluateResult run(VM &vm)
                 obj.get_object()->keys = {"old", "current", "name"};
 
                 Value old_pure = copy(value);
-                old_pure.hooks.onChangeHook = nullptr;
-                old_pure.hooks.onAccessHook = nullptr;
+                old_pure.set_hooks_id(0);
                 obj.get_object()->values["old"] = old_pure;
 
                 obj.get_object()->values["current"] = new_value;
-                obj.get_object()->values["name"] = string_val(value.hooks.onChangeHookName);
+                obj.get_object()->values["name"] = string_val(value.get_hooks().onChangeHookName);
 
                 *frame->function->closed_vars[index]->location = new_value;
 
-                VM func_vm;
-                std::shared_ptr<FunctionObj> main = std::make_shared<FunctionObj>();
-                main->name = "";
-                main->arity = 0;
-                main->chunk = Chunk();
-                main->chunk.import_path = frame->function->chunk.import_path;
-                CallFrame main_frame;
-                main_frame.name = frame->name;
-                main_frame.function = main;
-                main_frame.sp = 0;
-                main_frame.ip = main->chunk.code.data();
-                main_frame.frame_start = 0;
-                func_vm.frames.push_back(main_frame);
-
-                add_constant(main->chunk, *value.hooks.onChangeHook);
-                add_constant(main->chunk, obj);
+                std::vector<Value> hook_args = {obj};
+                Value result = vm_call(vm, *value.get_hooks().onChangeHook, hook_args);
 
-                add_opcode(main->chunk, OP_LOAD_CONST, 1, 0);
-                add_opcode(main->chunk, OP_LOAD_CONST, 0, 0);
-                add_opcode(main->chunk, OP_CALL, 1, 0);
-                add_code(main->chunk, OP_EXIT, 0);
-
-                auto offsets = instruction_offsets(main_frame.function->chunk);
-                main_frame.function->instruction_offsets = offsets;
-
-                auto status = evaluate(func_vm);
-
-                if (status != 0)
+                if (result.is_object() && result.get_object()->type_name == "Error")
                 {
-                    exit(1);
+                    runtimeError(vm, result.get_object()->values["message"].get_string(), result.get_object()->values["type"].get_string());
+                    if (vm.status == 2)
+                    {
+                        vm.status = 0;
+                        break;
+                    }
+
+                    return EVALUATE_RUNTIME_ERROR;
                 }
 
-                obj.get_object()->values["current"].hooks.onChangeHook = value.hooks.onChangeHook;
-                obj.get_object()->values["current"].hooks.onChangeHookName = value.hooks.onChangeHookName;
-                obj.get_object()->values["current"].hooks.onAccessHook = value.hooks.onAccessHook;
-                obj.get_object()->values["current"].hooks.onAccessHookName = value.hooks.onAccessHookName;
+                obj.get_object()->values["current"].set_hooks_id(value.hooks_id);
                 push(vm, obj.get_object()->values["current"]);
                 *frame->function->closed_vars[index]->location = vm.stack.back();
                 break;
             }
             *frame->function->closed_vars[index]->location = vm.stack.back();
-            break;
+            DISPATCH();
         }
-        case OP_JUMP_IF_FALSE:
+        END_TARGET()
+        TARGET(OP_JUMP_IF_FALSE)
         {
             int offset = READ_INT();
             if (is_falsey(vm.stack.back()))
             {
                 frame->ip += offset;
             }
-            break;
+            DISPATCH();
         }
-        case OP_JUMP_IF_TRUE:
+        END_TARGET()
+        TARGET(OP_JUMP_IF_TRUE)
         {
             int offset = READ_INT();
             if (!is_falsey(vm.stack.back()))
             {
                 frame->ip += offset;
             }
-            break;
+            DISPATCH();
         }
-        case OP_POP_JUMP_IF_FALSE:
+        END_TARGET()
+        TARGET(OP_POP_JUMP_IF_FALSE)
         {
             int offset = READ_INT();
             if (is_falsey(vm.stack.back()))
@@ -1159,9 +1891,10 @@ static EvaluateResult run(VM &vm)
                 frame->ip += offset;
             }
             pop(vm);
-            break;
+            DISPATCH();
         }
-        case OP_POP_JUMP_IF_TRUE:
+        END_TARGET()
+        TARGET(OP_POP_JUMP_IF_TRUE)
         {
             int offset = READ_INT();
             if (!is_falsey(vm.stack.back()))
@@ -1170,249 +1903,157 @@ static EvaluateResult run(VM &vm)
             }
 
             pop(vm);
-            break;
+            DISPATCH();
         }
-        case OP_JUMP:
+        END_TARGET()
+        TARGET(OP_JUMP)
         {
             int offset = READ_INT();
             frame->ip += offset;
-            break;
+            DISPATCH();
         }
-        case OP_JUMP_BACK:
+        END_TARGET()
+        TARGET(OP_JUMP_BACK)
         {
             int offset = READ_INT();
             frame->ip -= offset;
-            break;
-        }
-        case OP_POP:
-        {
-            pop(vm);
-            break;
-        }
-        case OP_POP_CLOSE:
-        {
-            pop_close(vm);
-            break;
-        }
-        case OP_LOOP:
-        {
-            int stack_size = vm.stack.size();
-            uint8_t *bytes = int_to_bytes(stack_size);
-            for (int i = 0; i < 4; i++)
+            // Loops and calls are where the VM collects cycles, as every
+            // value in use is on the stack or held by a frame
+            if (collection_due.load(std::memory_order_relaxed))
             {
-                frame->ip[i] = bytes[i];
+                collect_cycles();
             }
-            READ_INT();
-            break;
+            DISPATCH();
         }
-        case OP_LOOP_END:
+        END_TARGET()
+        TARGET(OP_POP)
         {
-            break;
+            pop(vm);
+            DISPATCH();
         }
-        case OP_ITER:
+        END_TARGET()
+        TARGET(OP_POP_CLOSE)
         {
-            break;
+            pop_close(vm);
+            DISPATCH();
         }
+        END_TARGET()
         case OP_BREAK:
+        TARGET(OP_CONTINUE)
         {
-            int count = 1;
-            int current_offset = (int)(size_t)(frame->ip - &frame->function->chunk.code[0]);
-            int instruction_index = std::find(frame->function->instruction_offsets.begin(), frame->function->instruction_offsets.end(), current_offset) - frame->function->instruction_offsets.begin();
-            int instruction = frame->function->instruction_offsets[instruction_index];
-            int _instruction = frame->function->chunk.code[instruction];
-            while (true)
-            {
-                instruction_index--;
-                instruction = frame->function->instruction_offsets[instruction_index];
-                int diff = frame->function->instruction_offsets[instruction_index + 1] - instruction;
-                frame->ip -= diff;
-                _instruction = frame->function->chunk.code[instruction];
-                if (_instruction == OP_LOOP_END)
-                {
-                    count++;
-                }
-                else if (_instruction == OP_LOOP)
-                {
-                    count--;
-                    if (count == 0)
-                    {
-                        break;
-                    }
-                }
-            }
-            READ_BYTE();
-            int stack_size_start = READ_INT();
-            int to_pop = vm.stack.size() - stack_size_start;
-
-            for (int i = 0; i < to_pop; i++)
+            // Drops the locals declared inside the loop body; the OP_JUMP
+            // that follows leaves the loop or starts its next iteration
+            int depth = frame->frame_start + READ_OPERAND();
+            close_values(vm, vm.stack.data() + depth);
+            while ((int)vm.stack.size() > depth)
             {
                 pop(vm);
             }
-            // We need to go all the way down to OP_JUMP_BACK, but make sure to
-            // skip any loops along the way
-
-            count = 1;
-
-            while (true)
+            DISPATCH();
+        }
+        END_TARGET()
+        TARGET(OP_BUILD_LIST)
+        {
+            // The elements are the top `size` slots, first element lowest,
+            // so the list is sized once and filled in order
+            int size = READ_OPERAND();
+            Value *elements = vm.stack.data() + vm.stack.size() - size;
+            size_t length = 0;
+            Value *bad_spread = nullptr;
+            for (int i = 0; i < size; i++)
             {
-
-                instruction_index++;
-                instruction = frame->function->instruction_offsets[instruction_index];
-                _instruction = frame->function->chunk.code[instruction];
-                int diff = frame->function->instruction_offsets[instruction_index + 1] - instruction;
-                frame->ip += diff;
-
-                if (_instruction == OP_LOOP)
+                if (!elements[i].meta.unpack)
                 {
-                    count++;
+                    length++;
                 }
-                if (_instruction == OP_JUMP_BACK)
+                else if (!elements[i].is_list())
                 {
-                    count--;
+                    bad_spread = &elements[i];
                 }
-
-                if (count == 0)
+                else
                 {
-                    break;
+                    length += elements[i].get_list()->size();
                 }
             }
-
-            // while (_instruction != OP_JUMP_BACK)
-            // {
-            //     instruction_index++;
-            //     instruction = frame->function->instruction_offsets[instruction_index];
-            //     _instruction = frame->function->chunk.code[instruction];
-            //     int diff = frame->function->instruction_offsets[instruction_index + 1] - instruction;
-            //     frame->ip += diff;
-            // }
-
-            break;
-        }
-        case OP_CONTINUE:
-        {
-            int count = 1;
-            int current_offset = (int)(size_t)(frame->ip - &frame->function->chunk.code[0]);
-            int instruction_index = std::find(frame->function->instruction_offsets.begin(), frame->function->instruction_offsets.end(), current_offset) - frame->function->instruction_offsets.begin();
-            int instruction = frame->function->instruction_offsets[instruction_index];
-            int _instruction = frame->function->chunk.code[instruction];
-            while (true)
+            if (bad_spread)
             {
-                instruction_index--;
-                instruction = frame->function->instruction_offsets[instruction_index];
-                int diff = frame->function->instruction_offsets[instruction_index + 1] - instruction;
-                frame->ip -= diff;
-                _instruction = frame->function->chunk.code[instruction];
-                if (_instruction == OP_LOOP_END)
-                {
-                    count++;
-                }
-                else if (_instruction == OP_LOOP)
+                runtimeError(vm, "Operand must be a list - value: " + bad_spread->value_repr() + " (" + bad_spread->type_repr() + ")");
+                if (vm.status == 2)
                 {
-                    count--;
-                    if (count == 0)
-                    {
-                        break;
-                    }
+                    vm.status = 0;
+                    break;
                 }
-            }
 
-            READ_BYTE();
-            int stack_size_start = READ_INT();
-            int to_pop = vm.stack.size() - stack_size_start;
-
-            for (int i = 0; i < to_pop; i++)
-            {
-                pop(vm);
+                return EVALUATE_RUNTIME_ERROR;
             }
 
-            // We need to go all the way down to OP_JUMP_BACK, but make sure to
-            // skip any loops along the way
-
-            count = 1;
-
-            while (true)
+            Value list = list_val();
+            auto &list_value = *list.get_list();
+            list_value.reserve(length);
+            for (int i = 0; i < size; i++)
             {
-                instruction_index++;
-                instruction = frame->function->instruction_offsets[instruction_index];
-                _instruction = frame->function->chunk.code[instruction];
-                int diff = frame->function->instruction_offsets[instruction_index + 1] - instruction;
-                frame->ip += diff;
-
-                if (_instruction == OP_LOOP)
+                Value &element = elements[i];
+                if (element.meta.unpack)
                 {
-                    count++;
+                    auto &spread = *element.get_list();
+                    list_value.insert(list_value.end(), spread.begin(), spread.end());
                 }
-                if (_instruction == OP_JUMP_BACK)
+                else
                 {
-                    count--;
+                    list_value.push_back(std::move(element));
                 }
-
-                if (_instruction == OP_ITER && count == 1)
+            }
+            vm.stack.erase(vm.stack.end() - size, vm.stack.end());
+            push(vm, std::move(list));
+            DISPATCH();
+        }
+        END_TARGET()
+        TARGET(OP_ACCESSOR)
+        {
+        generic_accessor:
+            if (vm.stack.back().is_number() && frame->ip[0] == 0)
+            {
+                if (vm.stack[vm.stack.size() - 2].is_list())
                 {
-                    frame->ip -= diff;
-                    break;
+                    quicken(frame->ip - 1, OP_ACCESS_LIST_NUM);
                 }
-
-                if (count == 0)
+                else if (vm.stack[vm.stack.size() - 2].is_range())
                 {
-                    frame->ip -= diff;
-                    break;
+                    quicken(frame->ip - 1, OP_ACCESS_RANGE_NUM);
                 }
             }
+            READ_OPERAND();
+        access_property:
+            Value _index = pop(vm);
+            Value _container = pop(vm);
 
-            break;
-        }
-        case OP_BUILD_LIST:
-        {
-            Value list = list_val();
-            int size = READ_INT();
-            auto &list_val = list.get_list();
-            for (int i = 0; i < size; i++)
+            if (_container.is_range())
             {
-                Value v = pop(vm);
-                if (v.meta.unpack)
+                if (!_index.is_number())
                 {
-                    if (!v.is_list())
-                    {
-                        runtimeError(vm, "Operand must be a list - value: " + v.value_repr() + " (" + v.type_repr() + ")");
-                        if (vm.status == 2)
-                        {
-                            vm.status = 0;
-                            break;
-                        }
-
-                        return EVALUATE_RUNTIME_ERROR;
-                    }
-
-                    for (int i = (*v.get_list()).size() - 1; i >= 0; i--)
+                    runtimeError(vm, "Accessor must be a number - accessor used: " + _index.value_repr() + " (" + _index.type_repr() + ")");
+                    if (vm.status == 2)
                     {
-                        Value &e = (*v.get_list())[i];
-                        list_val->insert(list_val->begin(), e);
+                        vm.status = 0;
+                        break;
                     }
 
-                    v.meta.unpack = false;
+                    return EVALUATE_RUNTIME_ERROR;
+                }
+                int index = _index.get_number();
+                if (index >= _container.range_length() || index < 0)
+                {
+                    push(vm, none_val());
                 }
                 else
                 {
-                    list_val->insert(list_val->begin(), v);
+                    push(vm, number_val(_container.range_start() + index));
                 }
+                DISPATCH();
             }
-            push(vm, list);
-            break;
-        }
-        case OP_ACCESSOR:
-        {
-            int flag = READ_INT();
-            Value _index = pop(vm);
-            Value _container = pop(vm);
 
             if (!_container.is_list() && !_container.is_object() && !_container.is_string())
             {
-                if (flag == 1)
-                {
-                    push(vm, _container);
-                    break;
-                }
                 runtimeError(vm, "Object is not accessible: " + _container.value_repr() + " (" + _container.type_repr() + ")");
                 if (vm.status == 2)
                 {
@@ -1425,12 +2066,6 @@ static EvaluateResult run(VM &vm)
 
             if (_container.is_list())
             {
-                if (flag == 1)
-                {
-                    Value none = none_val();
-                    push(vm, _container);
-                    break;
-                }
                 if (!_index.is_number())
                 {
                     runtimeError(vm, "Accessor must be a number - accessor used: " + _index.value_repr() + " (" + _index.type_repr() + ")");
@@ -1467,7 +2102,7 @@ static EvaluateResult run(VM &vm)
 
                     return EVALUATE_RUNTIME_ERROR;
                 }
-                std::string &index = _index.get_string();
+                const std::string &index = _index.get_string();
                 auto &object = _container.get_object();
                 if (!object->values.count(index))
                 {
@@ -1479,64 +2114,27 @@ static EvaluateResult run(VM &vm)
                     Value &value = object->values[index];
                     push(vm, value);
 
-                    if (value.hooks.onAccessHook)
+                    if (value.hooks_id && value.get_hooks().onAccessHook)
                     {
-                        Value obj = object_val();
-                        obj.get_object()->keys = {"value", "name"};
-                        Value value_pure = copy(value);
-                        value_pure.hooks.onAccessHook = nullptr;
-                        value_pure.hooks.onChangeHook = nullptr;
-                        obj.get_object()->values["value"] = value_pure;
-                        obj.get_object()->values["name"] = string_val(value.hooks.onAccessHookName);
-
-                        VM func_vm;
-                        std::shared_ptr<FunctionObj> main = std::make_shared<FunctionObj>();
-                        main->name = "";
-                        main->arity = 0;
-                        main->chunk = Chunk();
-                        main->chunk.import_path = frame->function->chunk.import_path;
-                        CallFrame main_frame;
-                        main_frame.name = frame->name;
-                        main_frame.function = main;
-                        main_frame.sp = 0;
-                        main_frame.ip = main->chunk.code.data();
-                        main_frame.frame_start = 0;
-                        func_vm.frames.push_back(main_frame);
-
-                        add_constant(main->chunk, *value.hooks.onAccessHook);
-                        add_constant(main->chunk, obj);
-
-                        add_opcode(main->chunk, OP_LOAD_CONST, 1, 0);
-                        add_opcode(main->chunk, OP_LOAD_CONST, 0, 0);
-                        add_opcode(main->chunk, OP_CALL, 1, 0);
-                        add_code(main->chunk, OP_EXIT, 0);
-
-                        auto offsets = instruction_offsets(main_frame.function->chunk);
-                        main_frame.function->instruction_offsets = offsets;
-
-                        auto status = evaluate(func_vm);
-
-                        if (status != 0)
+                        Value result = call_access_hook(vm, value);
+
+                        if (result.is_object() && result.get_object()->type_name == "Error")
                         {
-                            exit(1);
-                        }
+                            runtimeError(vm, result.get_object()->values["message"].get_string(), result.get_object()->values["type"].get_string());
+                            if (vm.status == 2)
+                            {
+                                vm.status = 0;
+                                break;
+                            }
 
-                        obj.get_object()->values["value"].hooks.onChangeHook = value.hooks.onChangeHook;
-                        obj.get_object()->values["value"].hooks.onChangeHookName = value.hooks.onChangeHookName;
-                        obj.get_object()->values["value"].hooks.onAccessHook = value.hooks.onAccessHook;
-                        obj.get_object()->values["value"].hooks.onAccessHookName = value.hooks.onAccessHookName;
+                            return EVALUATE_RUNTIME_ERROR;
+                        }
                         break;
                     }
                 }
             }
             else if (_container.is_string())
             {
-                if (flag == 1)
-                {
-                    Value none = none_val();
-                    push(vm, _container);
-                    break;
-                }
                 if (!_index.is_number())
                 {
                     runtimeError(vm, "Accessor must be a number - accessor used: " + _index.value_repr() + " (" + _index.type_repr() + ")");
@@ -1561,16 +2159,17 @@ static EvaluateResult run(VM &vm)
                     push(vm, str);
                 }
             }
-
-            if (flag == 1)
-            {
-                push(vm, _container);
-            }
-            break;
+            DISPATCH();
         }
-        case OP_LEN:
+        END_TARGET()
+        TARGET(OP_LEN)
         {
             Value list = pop(vm);
+            if (list.is_range())
+            {
+                push(vm, number_val(list.range_length()));
+                DISPATCH();
+            }
             if (!list.is_list())
             {
                 runtimeError(vm, "Operand must be a list - value: " + list.value_repr() + " (" + list.type_repr() + ")");
@@ -1584,11 +2183,16 @@ static EvaluateResult run(VM &vm)
             }
             Value value = number_val(list.get_list()->size());
             push(vm, value);
-            break;
+            DISPATCH();
         }
-        case OP_UNPACK:
+        END_TARGET()
+        TARGET(OP_UNPACK)
         {
             Value &value = vm.stack.back();
+            if (value.is_range())
+            {
+                value = range_list(value);
+            }
             if (!value.is_list() && !value.is_object())
             {
                 runtimeError(vm, "Operand must be a list or object - value: " + value.value_repr() + " (" + value.type_repr() + ")");
@@ -1601,50 +2205,44 @@ static EvaluateResult run(VM &vm)
                 return EVALUATE_RUNTIME_ERROR;
             }
             value.meta.unpack = true;
-            break;
+            DISPATCH();
         }
-        case OP_REMOVE_PUSH:
+        END_TARGET()
+        TARGET(OP_REMOVE_PUSH)
         {
-            int index = READ_INT();
+            int index = READ_OPERAND();
             int _index = vm.stack.size() - index;
             Value value = vm.stack[_index];
             vm.stack.erase(vm.stack.begin() + _index);
             push(vm, value);
-            break;
+            DISPATCH();
         }
-        case OP_SWAP_TOS:
+        END_TARGET()
+        TARGET(OP_SWAP_TOS)
         {
             Value v1 = pop(vm);
             Value v2 = pop(vm);
-            push(vm, v1);
-            push(vm, v2);
-            break;
+            push(vm, std::move(v1));
+            push(vm, std::move(v2));
+            DISPATCH();
         }
-        case OP_CALL:
+        END_TARGET()
+        TARGET(OP_CALL)
         {
-            int param_num = READ_INT();
+        call_value:
+            if (collection_due.load(std::memory_order_relaxed))
+            {
+                collect_cycles();
+            }
+            bool tail = frame->ip[-1] == OP_TAIL_CALL;
+            int param_num = READ_OPERAND();
             Value function = pop(vm);
 
             if (function.is_native())
             {
                 auto &native_function = function.get_native();
                 std::vector<Value> args;
-                for (int i = 0; i < param_num; i++)
-                {
-                    Value arg = pop(vm);
-                    if (arg.meta.unpack)
-                    {
-                        arg.meta.unpack = false;
-                        for (auto &elem : *arg.get_list())
-                        {
-                            args.push_back(elem);
-                        }
-                    }
-                    else
-                    {
-                        args.push_back(arg);
-                    }
-                }
+                pop_native_args(vm, param_num, args, native_function->function);
                 Value result = native_function->function(args);
 
                 if (result.is_object() && result.get_object()->type_name == "Error")
@@ -1660,7 +2258,7 @@ static EvaluateResult run(VM &vm)
                     return EVALUATE_RUNTIME_ERROR;
                 }
 
-                push(vm, result);
+                push(vm, std::move(result));
                 break;
             }
 
@@ -1681,7 +2279,7 @@ static EvaluateResult run(VM &vm)
                 return EVALUATE_RUNTIME_ERROR;
             }
 
-            int status = call_function(vm, function, param_num, frame);
+            int status = call_function(vm, function, param_num, frame, nullptr, tail);
 
             if (status != 0)
             {
@@ -1693,53 +2291,44 @@ static EvaluateResult run(VM &vm)
 
                 return EVALUATE_RUNTIME_ERROR;
             }
-            break;
+            DISPATCH();
         }
-        case OP_CALL_METHOD:
+        END_TARGET()
+        // The tail forms run the same handlers, which tell them apart by
+        // the opcode just read
+        TARGET(OP_TAIL_CALL)
         {
-            int param_num = READ_INT();
-            Value backup_function = pop(vm);
-            Value object = pop(vm);
-            Value function;
-
-            if (!object.is_object())
-            {
-                function = backup_function;
-                param_num++;
-                push(vm, object);
-            }
-            else
+            goto call_value;
+        }
+        END_TARGET()
+        TARGET(OP_TAIL_CALL_METHOD)
+        {
+            goto call_method;
+        }
+        END_TARGET()
+        TARGET(OP_CALL_METHOD)
+        {
+        call_method:
+            if (collection_due.load(std::memory_order_relaxed))
             {
-                function = pop(vm);
+                collect_cycles();
             }
+            bool tail = frame->ip[-1] == OP_TAIL_CALL_METHOD;
+            int param_num = READ_OPERAND();
+            Value object = pop(vm);
+            Value function = pop(vm);
 
-            if (function.is_none())
+            // Without a receiver, the object is the first argument
+            if (object.is_none())
             {
-                function = backup_function;
                 param_num++;
-                push(vm, object);
             }
 
             if (function.is_native())
             {
                 auto &native_function = function.get_native();
                 std::vector<Value> args;
-                for (int i = 0; i < param_num; i++)
-                {
-                    Value arg = pop(vm);
-                    if (arg.meta.unpack)
-                    {
-                        arg.meta.unpack = false;
-                        for (auto &elem : *arg.get_list())
-                        {
-                            args.push_back(elem);
-                        }
-                    }
-                    else
-                    {
-                        args.push_back(arg);
-                    }
-                }
+                pop_native_args(vm, param_num, args, native_function->function);
                 Value result = native_function->function(args);
 
                 if (result.is_object() && result.get_object()->type_name == "Error")
@@ -1754,7 +2343,7 @@ static EvaluateResult run(VM &vm)
 
                     return EVALUATE_RUNTIME_ERROR;
                 }
-                push(vm, result);
+                push(vm, std::move(result));
                 break;
             }
 
@@ -1775,7 +2364,7 @@ static EvaluateResult run(VM &vm)
                 return EVALUATE_RUNTIME_ERROR;
             }
 
-            int status = call_function(vm, function, param_num, frame, std::make_shared<Value>(object));
+            int status = call_function(vm, function, param_num, frame, object.is_none() ? nullptr : &object, tail);
 
             if (status != 0)
             {
@@ -1788,11 +2377,12 @@ static EvaluateResult run(VM &vm)
                 return EVALUATE_RUNTIME_ERROR;
             }
 
-            break;
+            DISPATCH();
         }
-        case OP_IMPORT:
+        END_TARGET()
+        TARGET(OP_IMPORT)
         {
-            int index = READ_INT();
+            int index = READ_OPERAND();
             if (index == 0)
             {
                 Value mod = pop(vm);
@@ -1805,13 +2395,7 @@ static EvaluateResult run(VM &vm)
 
                     if (vm.import_cache.count(absolute_path) > 0)
                     {
-                        for (auto &global : vm.import_cache[absolute_path].import_globals)
-                        {
-                            if (global.first != "__vm__")
-                            {
-                                vm.globals[global.first] = global.second;
-                            }
-                        }
+                        merge_globals(vm.globals, vm.import_cache[absolute_path].import_globals);
 
                         for (auto &prop : vm.import_cache[absolute_path].import_object.get_object()->values)
                         {
@@ -1850,26 +2434,27 @@ static EvaluateResult run(VM &vm)
                     }
 
                     VM import_vm;
-                    std::shared_ptr<FunctionObj> main = std::make_shared<FunctionObj>();
-                    main->name = "";
-                    main->arity = 0;
-                    main->chunk = Chunk();
-                    main->chunk.import_path = frame->function->chunk.import_path;
+                    Ref<FunctionObj> main = make_ref<FunctionObj>();
+                    main->proto->name = "";
+                    main->proto->arity = 0;
+                    main->proto->chunk = Chunk();
+                    main->proto->chunk.import_path = frame->function->proto->chunk.import_path;
                     CallFrame main_frame;
                     // main_frame.name = frame->name;
                     // main_frame.name = path.get_string();
                     main_frame.name = std::filesystem::current_path().string() + "/" + path.get_string().substr(path.get_string().find_last_of("/\\") + 1);
                     main_frame.function = main;
                     main_frame.sp = 0;
-                    main_frame.ip = main->chunk.code.data();
+                    main_frame.ip = main->proto->chunk.code.data();
                     main_frame.frame_start = 0;
                     import_vm.frames.push_back(main_frame);
 
                     reset();
-                    generate_bytecode(parser.nodes, main_frame.function->chunk);
-                    add_code(main_frame.function->chunk, OP_EXIT);
-                    auto offsets = instruction_offsets(main_frame.function->chunk);
-                    main_frame.function->instruction_offsets = offsets;
+                    generate_bytecode(parser.nodes, main_frame.function->proto->chunk);
+                    add_code(main_frame.function->proto->chunk, OP_EXIT);
+                    optimize_chunk(main_frame.function->proto->chunk);
+                    auto offsets = instruction_offsets(main_frame.function->proto->chunk);
+                    main_frame.function->proto->instruction_offsets = offsets;
                     evaluate(import_vm);
 
                     if (import_vm.status != 0)
@@ -1878,21 +2463,15 @@ static EvaluateResult run(VM &vm)
                     }
 
                     // Bring through globals in import
-                    for (auto &global : import_vm.globals)
-                    {
-                        if (global.first != "__vm__")
-                        {
-                            vm.globals[global.first] = global.second;
-                        }
-                    }
+                    merge_globals(vm.globals, import_vm.globals);
 
                     std::filesystem::current_path(current_path);
 
                     Value import_obj = object_val();
                     auto &obj = import_obj.get_object();
-                    for (int i = 0; i < import_vm.frames[0].function->chunk.public_variables.size(); i++)
+                    for (int i = 0; i < import_vm.frames[0].function->proto->chunk.public_variables.size(); i++)
                     {
-                        auto &var = import_vm.frames[0].function->chunk.public_variables[i];
+                        auto &var = import_vm.frames[0].function->proto->chunk.public_variables[i];
 
                         obj->values[var] = import_vm.stack[i];
                         obj->keys.push_back(var);
@@ -1903,10 +2482,9 @@ static EvaluateResult run(VM &vm)
                     cached.import_globals = import_vm.globals;
                     vm.import_cache[absolute_path] = cached;
 
-                    for (int i = 0; i < import_vm.frames[0].function->chunk.public_variables.size(); i++)
+                    for (int i = 0; i < import_vm.frames[0].function->proto->chunk.public_variables.size(); i++)
                     {
-                        auto &var = import_vm.frames[0].function->chunk.public_variables[i];
-                        auto &value = import_vm.stack[i];
+                        auto &var = import_vm.frames[0].function->proto->chunk.public_variables[i];
                         define_global(vm, var, import_vm.stack[i]);
                     }
 
@@ -1921,13 +2499,7 @@ static EvaluateResult run(VM &vm)
 
                     if (vm.import_cache.count(absolute_path) > 0)
                     {
-                        for (auto &global : vm.import_cache[absolute_path].import_globals)
-                        {
-                            if (global.first != "__vm__")
-                            {
-                                vm.globals[global.first] = global.second;
-                            }
-                        }
+                        merge_globals(vm.globals, vm.import_cache[absolute_path].import_globals);
                         push(vm, vm.import_cache[absolute_path].import_object);
                         break;
                     }
@@ -1961,26 +2533,27 @@ static EvaluateResult run(VM &vm)
                     }
 
                     VM import_vm;
-                    std::shared_ptr<FunctionObj> main = std::make_shared<FunctionObj>();
-                    main->name = "";
-                    main->arity = 0;
-                    main->chunk = Chunk();
-                    main->chunk.import_path = frame->function->chunk.import_path;
+                    Ref<FunctionObj> main = make_ref<FunctionObj>();
+                    main->proto->name = "";
+                    main->proto->arity = 0;
+                    main->proto->chunk = Chunk();
+                    main->proto->chunk.import_path = frame->function->proto->chunk.import_path;
                     CallFrame main_frame;
                     // main_frame.name = frame->name;
                     // main_frame.name = path.get_string();
                     main_frame.name = std::filesystem::current_path().string() + "/" + path.get_string().substr(path.get_string().find_last_of("/\\") + 1);
                     main_frame.function = main;
                     main_frame.sp = 0;
-                    main_frame.ip = main->chunk.code.data();
+                    main_frame.ip = main->proto->chunk.code.data();
                     main_frame.frame_start = 0;
                     import_vm.frames.push_back(main_frame);
 
                     reset();
-                    generate_bytecode(parser.nodes, main_frame.function->chunk);
-                    add_code(main_frame.function->chunk, OP_EXIT);
-                    auto offsets = instruction_offsets(main_frame.function->chunk);
-                    main_frame.function->instruction_offsets = offsets;
+                    generate_bytecode(parser.nodes, main_frame.function->proto->chunk);
+                    add_code(main_frame.function->proto->chunk, OP_EXIT);
+                    optimize_chunk(main_frame.function->proto->chunk);
+                    auto offsets = instruction_offsets(main_frame.function->proto->chunk);
+                    main_frame.function->proto->instruction_offsets = offsets;
                     evaluate(import_vm);
 
                     for (auto &c : import_vm.import_cache)
@@ -1994,21 +2567,15 @@ static EvaluateResult run(VM &vm)
                     }
 
                     // Bring through globals in import
-                    for (auto &global : import_vm.globals)
-                    {
-                        if (global.first != "__vm__")
-                        {
-                            vm.globals[global.first] = global.second;
-                        }
-                    }
+                    merge_globals(vm.globals, import_vm.globals);
 
                     std::filesystem::current_path(current_path);
 
                     Value import_obj = object_val();
                     auto &obj = import_obj.get_object();
-                    for (int i = 0; i < import_vm.frames[0].function->chunk.public_variables.size(); i++)
+                    for (int i = 0; i < import_vm.frames[0].function->proto->chunk.public_variables.size(); i++)
                     {
-                        auto &var = import_vm.frames[0].function->chunk.public_variables[i];
+                        auto &var = import_vm.frames[0].function->proto->chunk.public_variables[i];
 
                         obj->values[var] = import_vm.stack[i];
                         obj->keys.push_back(var);
@@ -2041,13 +2608,7 @@ static EvaluateResult run(VM &vm)
 
                 if (vm.import_cache.count(absolute_path) > 0)
                 {
-                    for (auto &global : vm.import_cache[absolute_path].import_globals)
-                    {
-                        if (global.first != "__vm__")
-                        {
-                            vm.globals[global.first] = global.second;
-                        }
-                    }
+                    merge_globals(vm.globals, vm.import_cache[absolute_path].import_globals);
 
                     auto &import_object = vm.import_cache[absolute_path].import_object;
 
@@ -2102,25 +2663,26 @@ static EvaluateResult run(VM &vm)
                 }
 
                 VM import_vm;
-                std::shared_ptr<FunctionObj> main = std::make_shared<FunctionObj>();
-                main->name = "";
-                main->arity = 0;
-                main->chunk = Chunk();
-                main->chunk.import_path = frame->function->chunk.import_path;
+                Ref<FunctionObj> main = make_ref<FunctionObj>();
+                main->proto->name = "";
+                main->proto->arity = 0;
+                main->proto->chunk = Chunk();
+                main->proto->chunk.import_path = frame->function->proto->chunk.import_path;
                 CallFrame main_frame;
                 // main_frame.name = frame->name;
                 main_frame.name = std::filesystem::current_path().string() + "/" + path.get_string().substr(path.get_string().find_last_of("/\\") + 1);
                 main_frame.function = main;
                 main_frame.sp = 0;
-                main_frame.ip = main->chunk.code.data();
+                main_frame.ip = main->proto->chunk.code.data();
                 main_frame.frame_start = 0;
                 import_vm.frames.push_back(main_frame);
 
                 reset();
-                generate_bytecode(parser.nodes, main_frame.function->chunk);
-                add_code(main_frame.function->chunk, OP_EXIT);
-                auto offsets = instruction_offsets(main_frame.function->chunk);
-                main_frame.function->instruction_offsets = offsets;
+                generate_bytecode(parser.nodes, main_frame.function->proto->chunk);
+                add_code(main_frame.function->proto->chunk, OP_EXIT);
+                optimize_chunk(main_frame.function->proto->chunk);
+                auto offsets = instruction_offsets(main_frame.function->proto->chunk);
+                main_frame.function->proto->instruction_offsets = offsets;
                 evaluate(import_vm);
 
                 for (auto &c : import_vm.import_cache)
@@ -2134,21 +2696,15 @@ static EvaluateResult run(VM &vm)
                 }
 
                 // Bring through globals in import
-                for (auto &global : import_vm.globals)
-                {
-                    if (global.first != "__vm__")
-                    {
-                        vm.globals[global.first] = global.second;
-                    }
-                }
+                merge_globals(vm.globals, import_vm.globals);
 
                 std::filesystem::current_path(current_path);
 
                 Value import_obj = object_val();
                 auto &obj = import_obj.get_object();
-                for (int i = 0; i < import_vm.frames[0].function->chunk.public_variables.size(); i++)
+                for (int i = 0; i < import_vm.frames[0].function->proto->chunk.public_variables.size(); i++)
                 {
-                    auto &var = import_vm.frames[0].function->chunk.public_variables[i];
+                    auto &var = import_vm.frames[0].function->proto->chunk.public_variables[i];
 
                     obj->values[var] = import_vm.stack[i];
                     obj->keys.push_back(var);
@@ -2162,9 +2718,9 @@ static EvaluateResult run(VM &vm)
                 for (auto &name : names)
                 {
                     bool found = false;
-                    for (int i = 0; i < import_vm.frames[0].function->chunk.public_variables.size(); i++)
+                    for (int i = 0; i < import_vm.frames[0].function->proto->chunk.public_variables.size(); i++)
                     {
-                        if (name == import_vm.frames[0].function->chunk.public_variables[i])
+                        if (name == import_vm.frames[0].function->proto->chunk.public_variables[i])
                         {
                             push(vm, import_vm.stack[i]);
                             found = true;
@@ -2187,11 +2743,12 @@ static EvaluateResult run(VM &vm)
 
                 break;
             }
-            break;
+            DISPATCH();
         }
-        case OP_HOOK_ONCHANGE:
+        END_TARGET()
+        TARGET(OP_HOOK_ONCHANGE)
         {
-            int index = READ_INT();
+            int index = READ_OPERAND();
             Value name = pop(vm);
             Value function = pop(vm);
             if (!name.is_string())
@@ -2208,8 +2765,10 @@ static EvaluateResult run(VM &vm)
             if (index == -1)
             {
                 Value &val = vm.stack.back();
-                val.hooks.onChangeHook = std::make_shared<Value>(function);
-                val.hooks.onChangeHookName = name.get_string();
+                ValueHooks hooks = val.get_hooks();
+                hooks.onChangeHook = std::make_shared<Value>(function);
+                hooks.onChangeHookName = name.get_string();
+                val.set_hooks(hooks);
                 vm.stack.pop_back();
                 break;
             }
@@ -2220,8 +2779,10 @@ static EvaluateResult run(VM &vm)
 
                 if (container.is_object() && accessor.is_string())
                 {
-                    container.get_object()->values[accessor.get_string()].hooks.onChangeHook = std::make_shared<Value>(function);
-                    container.get_object()->values[accessor.get_string()].hooks.onChangeHookName = name.get_string();
+                    ValueHooks hooks = container.get_object()->values[accessor.get_string()].get_hooks();
+                    hooks.onChangeHook = std::make_shared<Value>(function);
+                    hooks.onChangeHookName = name.get_string();
+                    container.get_object()->values[accessor.get_string()].set_hooks(hooks);
                     break;
                 }
 
@@ -2235,13 +2796,16 @@ static EvaluateResult run(VM &vm)
                 return EVALUATE_RUNTIME_ERROR;
             }
 
-            vm.stack[index + frame->frame_start].hooks.onChangeHook = std::make_shared<Value>(function);
-            vm.stack[index + frame->frame_start].hooks.onChangeHookName = name.get_string();
-            break;
+            ValueHooks hooks = vm.stack[index + frame->frame_start].get_hooks();
+            hooks.onChangeHook = std::make_shared<Value>(function);
+            hooks.onChangeHookName = name.get_string();
+            vm.stack[index + frame->frame_start].set_hooks(hooks);
+            DISPATCH();
         }
-        case OP_HOOK_CLOSURE_ONCHANGE:
+        END_TARGET()
+        TARGET(OP_HOOK_CLOSURE_ONCHANGE)
         {
-            int index = READ_INT();
+            int index = READ_OPERAND();
             Value name = pop(vm);
             Value function = pop(vm);
             if (!name.is_string())
@@ -2259,8 +2823,10 @@ static EvaluateResult run(VM &vm)
             if (index == -1)
             {
                 Value &val = vm.stack.back();
-                val.hooks.onChangeHook = std::make_shared<Value>(function);
-                val.hooks.onChangeHookName = name.get_string();
+                ValueHooks hooks = val.get_hooks();
+                hooks.onChangeHook = std::make_shared<Value>(function);
+                hooks.onChangeHookName = name.get_string();
+                val.set_hooks(hooks);
                 vm.stack.pop_back();
                 break;
             }
@@ -2271,8 +2837,10 @@ static EvaluateResult run(VM &vm)
 
                 if (container.is_object() && accessor.is_string())
                 {
-                    container.get_object()->values[accessor.get_string()].hooks.onChangeHook = std::make_shared<Value>(function);
-                    container.get_object()->values[accessor.get_string()].hooks.onChangeHookName = name.get_string();
+                    ValueHooks hooks = container.get_object()->values[accessor.get_string()].get_hooks();
+                    hooks.onChangeHook = std::make_shared<Value>(function);
+                    hooks.onChangeHookName = name.get_string();
+                    container.get_object()->values[accessor.get_string()].set_hooks(hooks);
                     break;
                 }
 
@@ -2286,13 +2854,16 @@ static EvaluateResult run(VM &vm)
                 return EVALUATE_RUNTIME_ERROR;
             }
 
-            (*frame->function->closed_vars[index]->location).hooks.onChangeHook = std::make_shared<Value>(function);
-            (*frame->function->closed_vars[index]->location).hooks.onAccessHookName = name.get_string();
-            break;
+            ValueHooks hooks = (*frame->function->closed_vars[index]->location).get_hooks();
+            hooks.onChangeHook = std::make_shared<Value>(function);
+            hooks.onAccessHookName = name.get_string();
+            (*frame->function->closed_vars[index]->location).set_hooks(hooks);
+            DISPATCH();
         }
-        case OP_HOOK_ONACCESS:
+        END_TARGET()
+        TARGET(OP_HOOK_ONACCESS)
         {
-            int index = READ_INT();
+            int index = READ_OPERAND();
             Value name = pop(vm);
             Value function = pop(vm);
             if (!name.is_string())
@@ -2310,8 +2881,10 @@ static EvaluateResult run(VM &vm)
             if (index == -1)
             {
                 Value &val = vm.stack.back();
-                val.hooks.onChangeHook = std::make_shared<Value>(function);
-                val.hooks.onChangeHookName = name.get_string();
+                ValueHooks hooks = val.get_hooks();
+                hooks.onChangeHook = std::make_shared<Value>(function);
+                hooks.onChangeHookName = name.get_string();
+                val.set_hooks(hooks);
                 vm.stack.pop_back();
                 break;
             }
@@ -2322,8 +2895,10 @@ static EvaluateResult run(VM &vm)
 
                 if (container.is_object() && accessor.is_string())
                 {
-                    container.get_object()->values[accessor.get_string()].hooks.onAccessHook = std::make_shared<Value>(function);
-                    container.get_object()->values[accessor.get_string()].hooks.onAccessHookName = name.get_string();
+                    ValueHooks hooks = container.get_object()->values[accessor.get_string()].get_hooks();
+                    hooks.onAccessHook = std::make_shared<Value>(function);
+                    hooks.onAccessHookName = name.get_string();
+                    container.get_object()->values[accessor.get_string()].set_hooks(hooks);
                     break;
                 }
 
@@ -2337,13 +2912,16 @@ static EvaluateResult run(VM &vm)
                 return EVALUATE_RUNTIME_ERROR;
             }
 
-            vm.stack[index + frame->frame_start].hooks.onAccessHook = std::make_shared<Value>(function);
-            vm.stack[index + frame->frame_start].hooks.onAccessHookName = name.get_string();
-            break;
+            ValueHooks hooks = vm.stack[index + frame->frame_start].get_hooks();
+            hooks.onAccessHook = std::make_shared<Value>(function);
+            hooks.onAccessHookName = name.get_string();
+            vm.stack[index + frame->frame_start].set_hooks(hooks);
+            DISPATCH();
         }
-        case OP_HOOK_CLOSURE_ONACCESS:
+        END_TARGET()
+        TARGET(OP_HOOK_CLOSURE_ONACCESS)
         {
-            int index = READ_INT();
+            int index = READ_OPERAND();
             Value name = pop(vm);
             Value function = pop(vm);
             if (!name.is_string())
@@ -2361,8 +2939,10 @@ static EvaluateResult run(VM &vm)
             if (index == -1)
             {
                 Value &val = vm.stack.back();
-                val.hooks.onChangeHook = std::make_shared<Value>(function);
-                val.hooks.onChangeHookName = name.get_string();
+                ValueHooks hooks = val.get_hooks();
+                hooks.onChangeHook = std::make_shared<Value>(function);
+                hooks.onChangeHookName = name.get_string();
+                val.set_hooks(hooks);
                 vm.stack.pop_back();
                 break;
             }
@@ -2373,8 +2953,10 @@ static EvaluateResult run(VM &vm)
 
                 if (container.is_object() && accessor.is_string())
                 {
-                    container.get_object()->values[accessor.get_string()].hooks.onAccessHook = std::make_shared<Value>(function);
-                    container.get_object()->values[accessor.get_string()].hooks.onAccessHookName = name.get_string();
+                    ValueHooks hooks = container.get_object()->values[accessor.get_string()].get_hooks();
+                    hooks.onAccessHook = std::make_shared<Value>(function);
+                    hooks.onAccessHookName = name.get_string();
+                    container.get_object()->values[accessor.get_string()].set_hooks(hooks);
                     break;
                 }
 
@@ -2388,11 +2970,14 @@ static EvaluateResult run(VM &vm)
                 return EVALUATE_RUNTIME_ERROR;
             }
 
-            (*frame->function->closed_vars[index]->location).hooks.onAccessHook = std::make_shared<Value>(function);
-            (*frame->function->closed_vars[index]->location).hooks.onAccessHookName = name.get_string();
-            break;
+            ValueHooks hooks = (*frame->function->closed_vars[index]->location).get_hooks();
+            hooks.onAccessHook = std::make_shared<Value>(function);
+            hooks.onAccessHookName = name.get_string();
+            (*frame->function->closed_vars[index]->location).set_hooks(hooks);
+            DISPATCH();
         }
-        case OP_NEGATE:
+        END_TARGET()
+        TARGET(OP_NEGATE)
         {
             Value constant = pop(vm);
             if (!constant.is_number())
@@ -2408,9 +2993,10 @@ static EvaluateResult run(VM &vm)
             }
             Value value = number_val(-constant.get_number());
             push(vm, value);
-            break;
+            DISPATCH();
         }
-        case OP_NOT:
+        END_TARGET()
+        TARGET(OP_NOT)
         {
             Value constant = pop(vm);
             if (constant.is_none())
@@ -2435,22 +3021,43 @@ static EvaluateResult run(VM &vm)
             }
             Value value = boolean_val(!constant.get_boolean());
             push(vm, value);
-            break;
+            DISPATCH();
         }
-        case OP_ADD:
+        END_TARGET()
+        TARGET(OP_ADD)
         {
-            Value v2 = pop(vm);
-            Value v1 = pop(vm);
+        generic_add:
+            Value &v2 = vm.stack.back();
+            Value &v1 = vm.stack[vm.stack.size() - 2];
             if (v1.is_string() && v2.is_string())
             {
-                Value value = string_val(v1.get_string() + v2.get_string());
-                push(vm, value);
+                quicken(frame->ip - 1, OP_ADD_STR_STR);
+                replace_operands(vm, string_val(v1.get_string() + v2.get_string()));
                 break;
             }
             if (!v1.is_number() || !v2.is_number())
             {
-                runtimeError(vm, "Cannot perform operation '+' on values: " + v1.value_repr() + " (" + v1.type_repr() + "), " + v2.value_repr() + " (" + v2.type_repr() + ")");
+                operand_error(vm, "+");
+                if (vm.status == 2)
+                {
+                    vm.status = 0;
+                    break;
+                }
 
+                return EVALUATE_RUNTIME_ERROR;
+            }
+            quicken(frame->ip - 1, OP_ADD_NUM_NUM);
+            replace_operands(vm, number_val(v1.get_number() + v2.get_number()));
+            DISPATCH();
+        }
+        END_TARGET()
+        TARGET(OP_SUBTRACT)
+        {
+            Value &v2 = vm.stack.back();
+            Value &v1 = vm.stack[vm.stack.size() - 2];
+            if (!v1.is_number() || !v2.is_number())
+            {
+                operand_error(vm, "-");
                 if (vm.status == 2)
                 {
                     vm.status = 0;
@@ -2459,17 +3066,17 @@ static EvaluateResult run(VM &vm)
 
                 return EVALUATE_RUNTIME_ERROR;
             }
-            Value value = number_val(v1.get_number() + v2.get_number());
-            push(vm, value);
-            break;
+            replace_operands(vm, number_val(v1.get_number() - v2.get_number()));
+            DISPATCH();
         }
-        case OP_SUBTRACT:
+        END_TARGET()
+        TARGET(OP_MULTIPLY)
         {
-            Value v2 = pop(vm);
-            Value v1 = pop(vm);
+            Value &v2 = vm.stack.back();
+            Value &v1 = vm.stack[vm.stack.size() - 2];
             if (!v1.is_number() || !v2.is_number())
             {
-                runtimeError(vm, "Cannot perform operation '-' on values: " + v1.value_repr() + " (" + v1.type_repr() + "), " + v2.value_repr() + " (" + v2.type_repr() + ")");
+                operand_error(vm, "*");
                 if (vm.status == 2)
                 {
                     vm.status = 0;
@@ -2478,17 +3085,17 @@ static EvaluateResult run(VM &vm)
 
                 return EVALUATE_RUNTIME_ERROR;
             }
-            Value value = number_val(v1.get_number() - v2.get_number());
-            push(vm, value);
-            break;
+            replace_operands(vm, number_val(v1.get_number() * v2.get_number()));
+            DISPATCH();
         }
-        case OP_MULTIPLY:
+        END_TARGET()
+        TARGET(OP_DIVIDE)
         {
-            Value v2 = pop(vm);
-            Value v1 = pop(vm);
+            Value &v2 = vm.stack.back();
+            Value &v1 = vm.stack[vm.stack.size() - 2];
             if (!v1.is_number() || !v2.is_number())
             {
-                runtimeError(vm, "Cannot perform operation '*' on values: " + v1.value_repr() + " (" + v1.type_repr() + "), " + v2.value_repr() + " (" + v2.type_repr() + ")");
+                operand_error(vm, "/");
                 if (vm.status == 2)
                 {
                     vm.status = 0;
@@ -2497,17 +3104,17 @@ static EvaluateResult run(VM &vm)
 
                 return EVALUATE_RUNTIME_ERROR;
             }
-            Value value = number_val(v1.get_number() * v2.get_number());
-            push(vm, value);
-            break;
+            replace_operands(vm, number_val(v1.get_number() / v2.get_number()));
+            DISPATCH();
         }
-        case OP_DIVIDE:
+        END_TARGET()
+        TARGET(OP_MOD)
         {
-            Value v2 = pop(vm);
-            Value v1 = pop(vm);
+            Value &v2 = vm.stack.back();
+            Value &v1 = vm.stack[vm.stack.size() - 2];
             if (!v1.is_number() || !v2.is_number())
             {
-                runtimeError(vm, "Cannot perform operation '/' on values: " + v1.value_repr() + " (" + v1.type_repr() + "), " + v2.value_repr() + " (" + v2.type_repr() + ")");
+                operand_error(vm, "%");
                 if (vm.status == 2)
                 {
                     vm.status = 0;
@@ -2516,17 +3123,17 @@ static EvaluateResult run(VM &vm)
 
                 return EVALUATE_RUNTIME_ERROR;
             }
-            Value value = number_val(v1.get_number() / v2.get_number());
-            push(vm, value);
-            break;
+            replace_operands(vm, number_val(fmod(v1.get_number(), v2.get_number())));
+            DISPATCH();
         }
-        case OP_MOD:
+        END_TARGET()
+        TARGET(OP_POW)
         {
-            Value v2 = pop(vm);
-            Value v1 = pop(vm);
+            Value &v2 = vm.stack.back();
+            Value &v1 = vm.stack[vm.stack.size() - 2];
             if (!v1.is_number() || !v2.is_number())
             {
-                runtimeError(vm, "Cannot perform operation '%' on values: " + v1.value_repr() + " (" + v1.type_repr() + "), " + v2.value_repr() + " (" + v2.type_repr() + ")");
+                operand_error(vm, "^");
                 if (vm.status == 2)
                 {
                     vm.status = 0;
@@ -2535,17 +3142,17 @@ static EvaluateResult run(VM &vm)
 
                 return EVALUATE_RUNTIME_ERROR;
             }
-            Value value = number_val(fmod(v1.get_number(), v2.get_number()));
-            push(vm, value);
-            break;
+            replace_operands(vm, number_val(pow(v1.get_number(), v2.get_number())));
+            DISPATCH();
         }
-        case OP_POW:
+        END_TARGET()
+        TARGET(OP_AND)
         {
-            Value v2 = pop(vm);
-            Value v1 = pop(vm);
+            Value &v2 = vm.stack.back();
+            Value &v1 = vm.stack[vm.stack.size() - 2];
             if (!v1.is_number() || !v2.is_number())
             {
-                runtimeError(vm, "Cannot perform operation '^' on values: " + v1.value_repr() + " (" + v1.type_repr() + "), " + v2.value_repr() + " (" + v2.type_repr() + ")");
+                operand_error(vm, "&");
                 if (vm.status == 2)
                 {
                     vm.status = 0;
@@ -2554,17 +3161,17 @@ static EvaluateResult run(VM &vm)
 
                 return EVALUATE_RUNTIME_ERROR;
             }
-            Value value = number_val(pow(v1.get_number(), v2.get_number()));
-            push(vm, value);
-            break;
+            replace_operands(vm, number_val((int)v1.get_number() & (int)v2.get_number()));
+            DISPATCH();
         }
-        case OP_AND:
+        END_TARGET()
+        TARGET(OP_OR)
         {
-            Value v2 = pop(vm);
-            Value v1 = pop(vm);
+            Value &v2 = vm.stack.back();
+            Value &v1 = vm.stack[vm.stack.size() - 2];
             if (!v1.is_number() || !v2.is_number())
             {
-                runtimeError(vm, "Cannot perform operation '&' on values: " + v1.value_repr() + " (" + v1.type_repr() + "), " + v2.value_repr() + " (" + v2.type_repr() + ")");
+                operand_error(vm, "|");
                 if (vm.status == 2)
                 {
                     vm.status = 0;
@@ -2573,17 +3180,43 @@ static EvaluateResult run(VM &vm)
 
                 return EVALUATE_RUNTIME_ERROR;
             }
-            Value value = number_val((int)v1.get_number() & (int)v2.get_number());
-            push(vm, value);
-            break;
+            replace_operands(vm, number_val((int)v1.get_number() | (int)v2.get_number()));
+            DISPATCH();
         }
-        case OP_OR:
+        END_TARGET()
+        TARGET(OP_EQ_EQ)
         {
-            Value v2 = pop(vm);
-            Value v1 = pop(vm);
+        generic_eq_eq:
+            Value &v2 = vm.stack.back();
+            Value &v1 = vm.stack[vm.stack.size() - 2];
+            if (v1.is_number() && v2.is_number())
+            {
+                quicken(frame->ip - 1, OP_EQ_EQ_NUM_NUM);
+            }
+            replace_operands(vm, boolean_val(is_equal(v1, v2)));
+            DISPATCH();
+        }
+        END_TARGET()
+        TARGET(OP_NOT_EQ)
+        {
+        generic_not_eq:
+            Value &v2 = vm.stack.back();
+            Value &v1 = vm.stack[vm.stack.size() - 2];
+            if (v1.is_number() && v2.is_number())
+            {
+                quicken(frame->ip - 1, OP_NOT_EQ_NUM_NUM);
+            }
+            replace_operands(vm, boolean_val(!is_equal(v1, v2)));
+            DISPATCH();
+        }
+        END_TARGET()
+        TARGET(OP_LT_EQ)
+        {
+            Value &v2 = vm.stack.back();
+            Value &v1 = vm.stack[vm.stack.size() - 2];
             if (!v1.is_number() || !v2.is_number())
             {
-                runtimeError(vm, "Cannot perform operation '|' on values: " + v1.value_repr() + " (" + v1.type_repr() + "), " + v2.value_repr() + " (" + v2.type_repr() + ")");
+                operand_error(vm, "<=");
                 if (vm.status == 2)
                 {
                     vm.status = 0;
@@ -2592,33 +3225,55 @@ static EvaluateResult run(VM &vm)
 
                 return EVALUATE_RUNTIME_ERROR;
             }
-            Value value = number_val((int)v1.get_number() | (int)v2.get_number());
-            push(vm, value);
-            break;
+            replace_operands(vm, boolean_val(v1.get_number() <= v2.get_number()));
+            DISPATCH();
         }
-        case OP_EQ_EQ:
+        END_TARGET()
+        TARGET(OP_GT_EQ)
         {
-            Value v2 = pop(vm);
-            Value v1 = pop(vm);
-            Value value = boolean_val(is_equal(v1, v2));
-            push(vm, value);
-            break;
+            Value &v2 = vm.stack.back();
+            Value &v1 = vm.stack[vm.stack.size() - 2];
+            if (!v1.is_number() || !v2.is_number())
+            {
+                operand_error(vm, ">=");
+                if (vm.status == 2)
+                {
+                    vm.status = 0;
+                    break;
+                }
+
+                return EVALUATE_RUNTIME_ERROR;
+            }
+            replace_operands(vm, boolean_val(v1.get_number() >= v2.get_number()));
+            DISPATCH();
         }
-        case OP_NOT_EQ:
+        END_TARGET()
+        TARGET(OP_LT)
         {
-            Value v2 = pop(vm);
-            Value v1 = pop(vm);
-            Value value = boolean_val(!is_equal(v1, v2));
-            push(vm, value);
-            break;
+            Value &v2 = vm.stack.back();
+            Value &v1 = vm.stack[vm.stack.size() - 2];
+            if (!v1.is_number() || !v2.is_number())
+            {
+                operand_error(vm, "<");
+                if (vm.status == 2)
+                {
+                    vm.status = 0;
+                    break;
+                }
+
+                return EVALUATE_RUNTIME_ERROR;
+            }
+            replace_operands(vm, boolean_val(v1.get_number() < v2.get_number()));
+            DISPATCH();
         }
-        case OP_LT_EQ:
+        END_TARGET()
+        TARGET(OP_GT)
         {
-            Value v2 = pop(vm);
-            Value v1 = pop(vm);
+            Value &v2 = vm.stack.back();
+            Value &v1 = vm.stack[vm.stack.size() - 2];
             if (!v1.is_number() || !v2.is_number())
             {
-                runtimeError(vm, "Cannot perform operation '<=' on values: " + v1.value_repr() + " (" + v1.type_repr() + "), " + v2.value_repr() + " (" + v2.type_repr() + ")");
+                operand_error(vm, ">");
                 if (vm.status == 2)
                 {
                     vm.status = 0;
@@ -2627,17 +3282,17 @@ static EvaluateResult run(VM &vm)
 
                 return EVALUATE_RUNTIME_ERROR;
             }
-            Value value = boolean_val(v1.get_number() <= v2.get_number());
-            push(vm, value);
-            break;
+            replace_operands(vm, boolean_val(v1.get_number() > v2.get_number()));
+            DISPATCH();
         }
-        case OP_GT_EQ:
+        END_TARGET()
+        TARGET(OP_RANGE)
         {
-            Value v2 = pop(vm);
-            Value v1 = pop(vm);
+            Value &v2 = vm.stack.back();
+            Value &v1 = vm.stack[vm.stack.size() - 2];
             if (!v1.is_number() || !v2.is_number())
             {
-                runtimeError(vm, "Cannot perform operation '>=' on values: " + v1.value_repr() + " (" + v1.type_repr() + "), " + v2.value_repr() + " (" + v2.type_repr() + ")");
+                operand_error(vm, "..");
                 if (vm.status == 2)
                 {
                     vm.status = 0;
@@ -2646,17 +3301,241 @@ static EvaluateResult run(VM &vm)
 
                 return EVALUATE_RUNTIME_ERROR;
             }
-            Value value = boolean_val(v1.get_number() >= v2.get_number());
-            push(vm, value);
-            break;
+            // The same integers the old list held: i from the truncated
+            // start while i < end
+            double start = std::trunc(v1.get_number());
+            double end = std::ceil(v2.get_number());
+            if (!std::isfinite(start) || !std::isfinite(end) || end - start > INT32_MAX)
+            {
+                runtimeError(vm, "Range is too large: " + v1.value_repr() + ".." + v2.value_repr());
+                if (vm.status == 2)
+                {
+                    vm.status = 0;
+                    break;
+                }
+
+                return EVALUATE_RUNTIME_ERROR;
+            }
+            if (start >= INT32_MIN && start <= INT32_MAX && end >= INT32_MIN && end <= INT32_MAX)
+            {
+                replace_operands(vm, range_val(start, end));
+                DISPATCH();
+            }
+            // Bounds a Range cannot hold still make the list
+            Value list = list_val();
+            for (double i = start; i < end; i++)
+            {
+                list.get_list()->push_back(number_val(i));
+            }
+            replace_operands(vm, std::move(list));
+            DISPATCH();
         }
-        case OP_LT:
+        END_TARGET()
+        // Quickened instructions check that their operands still have the
+        // types seen when they were written, and otherwise turn back into
+        // the generic instruction and run that
+        TARGET(OP_ADD_NUM_NUM)
         {
-            Value v2 = pop(vm);
-            Value v1 = pop(vm);
+            Value &v2 = vm.stack.back();
+            Value &v1 = vm.stack[vm.stack.size() - 2];
+            if (!v1.is_number() || !v2.is_number())
+            {
+                quicken(frame->ip - 1, OP_ADD);
+                goto generic_add;
+            }
+            replace_numbers(vm, v1.get_number() + v2.get_number());
+            DISPATCH();
+        }
+        END_TARGET()
+        TARGET(OP_ADD_STR_STR)
+        {
+            Value &v2 = vm.stack.back();
+            Value &v1 = vm.stack[vm.stack.size() - 2];
+            if (!v1.is_string() || !v2.is_string())
+            {
+                quicken(frame->ip - 1, OP_ADD);
+                goto generic_add;
+            }
+            replace_operands(vm, string_val(v1.get_string() + v2.get_string()));
+            DISPATCH();
+        }
+        END_TARGET()
+        TARGET(OP_EQ_EQ_NUM_NUM)
+        {
+            Value &v2 = vm.stack.back();
+            Value &v1 = vm.stack[vm.stack.size() - 2];
             if (!v1.is_number() || !v2.is_number())
             {
-                runtimeError(vm, "Cannot perform operation '<' on values: " + v1.value_repr() + " (" + v1.type_repr() + "), " + v2.value_repr() + " (" + v2.type_repr() + ")");
+                quicken(frame->ip - 1, OP_EQ_EQ);
+                goto generic_eq_eq;
+            }
+            replace_numbers(vm, v1.get_number() == v2.get_number());
+            DISPATCH();
+        }
+        END_TARGET()
+        TARGET(OP_NOT_EQ_NUM_NUM)
+        {
+            Value &v2 = vm.stack.back();
+            Value &v1 = vm.stack[vm.stack.size() - 2];
+            if (!v1.is_number() || !v2.is_number())
+            {
+                quicken(frame->ip - 1, OP_NOT_EQ);
+                goto generic_not_eq;
+            }
+            replace_numbers(vm, v1.get_number() != v2.get_number());
+            DISPATCH();
+        }
+        END_TARGET()
+        TARGET(OP_ACCESS_LIST_NUM)
+        {
+            Value &index = vm.stack.back();
+            Value &container = vm.stack[vm.stack.size() - 2];
+            if (!container.is_list() || !index.is_number())
+            {
+                quicken(frame->ip - 1, OP_ACCESSOR);
+                goto generic_accessor;
+            }
+            READ_OPERAND();
+            int i = index.get_number();
+            auto &list = *container.get_list();
+            if (i >= (int)list.size() || i < 0)
+            {
+                replace_operands(vm, none_val());
+            }
+            else
+            {
+                Value value = list[i];
+                replace_operands(vm, std::move(value));
+            }
+            DISPATCH();
+        }
+        END_TARGET()
+        TARGET(OP_ACCESS_RANGE_NUM)
+        {
+            Value &index = vm.stack.back();
+            Value &container = vm.stack[vm.stack.size() - 2];
+            if (!container.is_range() || !index.is_number())
+            {
+                quicken(frame->ip - 1, OP_ACCESSOR);
+                goto generic_accessor;
+            }
+            READ_OPERAND();
+            int i = index.get_number();
+            if (i >= container.range_length() || i < 0)
+            {
+                replace_operands(vm, none_val());
+            }
+            else
+            {
+                replace_numbers(vm, (double)(container.range_start() + i));
+            }
+            DISPATCH();
+        }
+        END_TARGET()
+        // Superinstructions keep the bytes of the instructions they stand
+        // for. When the fast path does not apply they step back to their
+        // first operand and run the original first instruction instead.
+        TARGET(OP_INCREMENT_LOCAL)
+        {
+            // LOAD a, LOAD_CONST k, ADD, SET_FORCE a, POP
+            uint8_t *start = frame->ip;
+            Value &slot = vm.stack[READ_OPERAND() + frame->frame_start];
+            if (!slot.is_number() || slot.hooks_id)
+            {
+                frame->ip = start;
+                goto load_local;
+            }
+            frame->ip++;
+            slot = number_val(slot.get_number() + READ_CONSTANT().get_number());
+            frame->ip += 2;
+            READ_OPERAND();
+            frame->ip++;
+            DISPATCH();
+        }
+        END_TARGET()
+        TARGET(OP_LOAD_LOAD)
+        {
+            uint8_t *start = frame->ip;
+            Value &first = vm.stack[READ_OPERAND() + frame->frame_start];
+            frame->ip++;
+            Value &second = vm.stack[READ_OPERAND() + frame->frame_start];
+            if (first.hooks_id || second.hooks_id)
+            {
+                frame->ip = start;
+                goto load_local;
+            }
+            push(vm, first);
+            push(vm, second);
+            DISPATCH();
+        }
+        END_TARGET()
+        TARGET(OP_SET_POP)
+        {
+            uint8_t *start = frame->ip;
+            Value &slot = vm.stack[READ_OPERAND() + frame->frame_start];
+            if (slot.meta.is_const || slot.hooks_id)
+            {
+                frame->ip = start;
+                goto set_local;
+            }
+            frame->ip++;
+            slot = pop(vm);
+            slot.meta.is_const = false;
+            DISPATCH();
+        }
+        END_TARGET()
+        TARGET(OP_ADD_CONST)
+        {
+            uint8_t *start = frame->ip;
+            Value &constant = READ_CONSTANT();
+            Value &top = vm.stack.back();
+            if (!top.is_number())
+            {
+                frame->ip = start;
+                goto load_const;
+            }
+            frame->ip++;
+            top = number_val(top.get_number() + constant.get_number());
+            DISPATCH();
+        }
+        END_TARGET()
+        TARGET(OP_SUBTRACT_CONST)
+        {
+            uint8_t *start = frame->ip;
+            Value &constant = READ_CONSTANT();
+            Value &top = vm.stack.back();
+            if (!top.is_number())
+            {
+                frame->ip = start;
+                goto load_const;
+            }
+            frame->ip++;
+            top = number_val(top.get_number() - constant.get_number());
+            DISPATCH();
+        }
+        END_TARGET()
+        TARGET(OP_MULTIPLY_CONST)
+        {
+            uint8_t *start = frame->ip;
+            Value &constant = READ_CONSTANT();
+            Value &top = vm.stack.back();
+            if (!top.is_number())
+            {
+                frame->ip = start;
+                goto load_const;
+            }
+            frame->ip++;
+            top = number_val(top.get_number() * constant.get_number());
+            DISPATCH();
+        }
+        END_TARGET()
+        TARGET(OP_LT_JUMP)
+        {
+            Value &v2 = vm.stack.back();
+            Value &v1 = vm.stack[vm.stack.size() - 2];
+            if (!v1.is_number() || !v2.is_number())
+            {
+                operand_error(vm, "<");
                 if (vm.status == 2)
                 {
                     vm.status = 0;
@@ -2665,17 +3544,17 @@ static EvaluateResult run(VM &vm)
 
                 return EVALUATE_RUNTIME_ERROR;
             }
-            Value value = boolean_val(v1.get_number() < v2.get_number());
-            push(vm, value);
-            break;
+            compare_and_branch(vm, frame, v1.get_number() < v2.get_number());
+            DISPATCH();
         }
-        case OP_GT:
+        END_TARGET()
+        TARGET(OP_LT_EQ_JUMP)
         {
-            Value v2 = pop(vm);
-            Value v1 = pop(vm);
+            Value &v2 = vm.stack.back();
+            Value &v1 = vm.stack[vm.stack.size() - 2];
             if (!v1.is_number() || !v2.is_number())
             {
-                runtimeError(vm, "Cannot perform operation '>' on values: " + v1.value_repr() + " (" + v1.type_repr() + "), " + v2.value_repr() + " (" + v2.type_repr() + ")");
+                operand_error(vm, "<=");
                 if (vm.status == 2)
                 {
                     vm.status = 0;
@@ -2684,17 +3563,36 @@ static EvaluateResult run(VM &vm)
 
                 return EVALUATE_RUNTIME_ERROR;
             }
-            Value value = boolean_val(v1.get_number() > v2.get_number());
-            push(vm, value);
-            break;
+            compare_and_branch(vm, frame, v1.get_number() <= v2.get_number());
+            DISPATCH();
         }
-        case OP_RANGE:
+        END_TARGET()
+        TARGET(OP_GT_JUMP)
         {
-            Value v2 = pop(vm);
-            Value v1 = pop(vm);
+            Value &v2 = vm.stack.back();
+            Value &v1 = vm.stack[vm.stack.size() - 2];
+            if (!v1.is_number() || !v2.is_number())
+            {
+                operand_error(vm, ">");
+                if (vm.status == 2)
+                {
+                    vm.status = 0;
+                    break;
+                }
+
+                return EVALUATE_RUNTIME_ERROR;
+            }
+            compare_and_branch(vm, frame, v1.get_number() > v2.get_number());
+            DISPATCH();
+        }
+        END_TARGET()
+        TARGET(OP_GT_EQ_JUMP)
+        {
+            Value &v2 = vm.stack.back();
+            Value &v1 = vm.stack[vm.stack.size() - 2];
             if (!v1.is_number() || !v2.is_number())
             {
-                runtimeError(vm, "Cannot perform operation '..' on values: " + v1.value_repr() + " (" + v1.type_repr() + "), " + v2.value_repr() + " (" + v2.type_repr() + ")");
+                operand_error(vm, ">=");
                 if (vm.status == 2)
                 {
                     vm.status = 0;
@@ -2703,21 +3601,54 @@ static EvaluateResult run(VM &vm)
 
                 return EVALUATE_RUNTIME_ERROR;
             }
-            Value value = list_val();
-            auto &list_value = value.get_list();
-            for (int i = v1.get_number(); i < v2.get_number(); i++)
+            compare_and_branch(vm, frame, v1.get_number() >= v2.get_number());
+            DISPATCH();
+        }
+        END_TARGET()
+        TARGET(OP_LOAD_PROPERTY)
+        {
+            uint8_t *start = frame->ip;
+            Value &value = vm.stack[READ_OPERAND() + frame->frame_start];
+            if (value.hooks_id)
             {
-                list_value->push_back(number_val(i));
+                frame->ip = start;
+                goto load_local;
             }
             push(vm, value);
-            break;
+            frame->ip++;
+            goto get_property;
+        }
+        END_TARGET()
+        TARGET(OP_CALL_GLOBAL)
+        {
+            uint8_t *start = frame->ip;
+            Value *global = find_global(vm.globals, READ_OPERAND());
+            if (!global)
+            {
+                frame->ip = start;
+                goto load_global;
+            }
+            push(vm, *global);
+            frame->ip++;
+            goto call_value;
         }
+        END_TARGET()
+#ifdef USE_COMPUTED_GOTO
+        TARGET_UNKNOWN:
+            break;
+#endif
         }
     }
 
 #undef READ_BYTE
 #undef READ_INT
+#undef READ_OPERAND
 #undef READ_CONSTANT
+#undef COUNT_COPIES
+#undef TARGET
+#undef END_TARGET
+#undef DISPATCH
+#undef USE_COMPUTED_GOTO
 }
 
 EvaluateResult evaluate(VM &vm)
@@ -2725,14 +3656,115 @@ EvaluateResult evaluate(VM &vm)
     internal_stack_count++;
     if (internal_stack_count > 200)
     {
+        internal_stack_count--;
         std::cout << "InternalError: Internal stack size limit exceeded";
         return EVALUATE_RUNTIME_ERROR;
     }
+
+    define_builtins(vm);
+
+    CallFrame *frame = &vm.frames.back();
+    frame->ip = frame->function->proto->chunk.code.data();
+    frame->frame_start = vm.stack.size();
+
+    VM *previous_vm = current_vm;
+    current_vm = &vm;
     auto res = run(vm);
+    current_vm = previous_vm;
     internal_stack_count--;
     return res;
 }
 
+// Calls a Vortex function from native code on an existing VM. The call
+// gets a frame on top of whatever the VM is currently running and the run
+// loop hands control back as soon as that frame returns. Errors that the
+// callee does not catch itself come back as an Error object, ready to be
+// returned from a native or raised with runtimeError.
+Value vm_call(VM &vm, Value function, std::vector<Value> &args)
+{
+    if (function.is_native())
+    {
+        return function.get_native()->function(args);
+    }
+
+    if (!function.is_function())
+    {
+        return error_object("Object is not callable: " + function.value_repr() + " (" + function.type_repr() + ")");
+    }
+
+    if (vm.frames.empty())
+    {
+        // A VM that has not run anything yet needs the builtins and a
+        // frame for the callee to return into
+        define_builtins(vm);
+
+        Ref<FunctionObj> base = make_ref<FunctionObj>();
+        base->proto->name = "";
+        base->proto->arity = 0;
+        add_code(base->proto->chunk, OP_EXIT, 0);
+        base->proto->instruction_offsets = instruction_offsets(base->proto->chunk);
+
+        CallFrame base_frame;
+        base_frame.function = base;
+        base_frame.sp = 0;
+        base_frame.ip = base->proto->chunk.code.data();
+        base_frame.frame_start = 0;
+        vm.frames.push_back(base_frame);
+    }
+
+    internal_stack_count++;
+    if (internal_stack_count > 200)
+    {
+        internal_stack_count--;
+        return error_object("Internal stack size limit exceeded", "InternalError");
+    }
+
+    VM *previous_vm = current_vm;
+    int previous_return_depth = vm.return_depth;
+    int previous_status = vm.status;
+    int stack_size = vm.stack.size();
+
+    current_vm = &vm;
+    vm.return_depth = vm.frames.size();
+    vm.callback_error = none_val();
+
+    for (int i = args.size() - 1; i >= 0; i--)
+    {
+        push(vm, args[i]);
+    }
+
+    Value result;
+    bool ok = false;
+    CallFrame *frame = &vm.frames.back();
+
+    if (call_function(vm, function, args.size(), frame) == 0)
+    {
+        // Generators hand back their value without pushing a frame
+        ok = (int)vm.frames.size() == vm.return_depth || run(vm) == EVALUATE_OK;
+    }
+
+    if (ok)
+    {
+        result = pop(vm);
+    }
+    else
+    {
+        result = vm.callback_error.is_none() ? error_object("Error in callback") : vm.callback_error;
+
+        unwind_frames(vm, vm.return_depth);
+        close_values(vm, vm.stack.data() + stack_size);
+        vm.stack.resize(stack_size);
+    }
+
+    vm.callback_error = none_val();
+    vm.status = previous_status;
+    vm.return_depth = previous_return_depth;
+    current_vm = previous_vm;
+    internal_stack_count--;
+
+    return result;
+}
+
 bool is_equal(Value &v1, Value &v2)
 {
     if (v1.type != v2.type)
@@ -2746,7 +3778,17 @@ bool is_equal(Value &v1, Value &v2)
     }
     if (v1.is_string())
     {
-        return v1.get_string() == v2.get_string();
+        StringObj *s1 = v1.as.string.get();
+        StringObj *s2 = v2.as.string.get();
+        if (s1 == s2)
+        {
+            return true;
+        }
+        if ((s1->interned && s2->interned) || s1->get_hash() != s2->get_hash())
+        {
+            return false;
+        }
+        return s1->value == s2->value;
     }
     if (v1.is_boolean())
     {
@@ -2766,231 +3808,293 @@ bool is_equal(Value &v1, Value &v2)
     }
     if (v1.is_pointer())
     {
-        return v1.get_pointer() == v2.get_pointer();
+        return v1.get_pointer() == v2.get_pointer();
+    }
+    if (v1.is_none())
+    {
+        return true;
+    }
+    if (v1.is_range())
+    {
+        // Empty ranges are equal whatever their bounds
+        return v1.range_length() == v2.range_length() && (v1.range_length() == 0 || v1.range_start() == v2.range_start());
+    }
+
+    return false;
+}
+
+bool is_falsey(Value &value)
+{
+    if (value.is_none() || value.is_boolean() && !value.get_boolean())
+    {
+        return true;
+    }
+
+    return false;
+}
+
+void freeVM(VM &vm)
+{
+    //
+}
+
+// Turns the arguments the caller pushed (in reverse, so the first one is on
+// top of the stack) into the callee's parameter slots, in place. Spread
+// arguments are flattened, extra arguments are collected into a capture
+// param and missing ones are filled from the defaults.
+static bool bind_arguments(VM &vm, Value &function, int param_num)
+{
+    auto &function_obj = function.get_function();
+    auto &proto = function_obj->proto;
+    int frame_start = vm.stack.size() - param_num;
+    std::reverse(vm.stack.begin() + frame_start, vm.stack.end());
+
+    bool has_unpack = false;
+    for (int i = frame_start; i < (int)vm.stack.size(); i++)
+    {
+        if (vm.stack[i].meta.unpack)
+        {
+            has_unpack = true;
+            break;
+        }
+    }
+
+    if (has_unpack || proto->has_capture)
+    {
+        std::vector<Value> args;
+        args.reserve(param_num);
+        for (int i = frame_start; i < (int)vm.stack.size(); i++)
+        {
+            Value &arg = vm.stack[i];
+            if (arg.meta.unpack)
+            {
+                for (auto &elem : *arg.get_list())
+                {
+                    args.push_back(elem);
+                }
+            }
+            else
+            {
+                args.push_back(std::move(arg));
+            }
+        }
+        vm.stack.resize(frame_start);
+
+        int fixed = proto->has_capture ? proto->arity - 1 : args.size();
+        for (int i = 0; i < (int)args.size() && i < fixed; i++)
+        {
+            vm.stack.push_back(std::move(args[i]));
+        }
+        if (proto->has_capture && (int)args.size() > fixed)
+        {
+            Value captured = list_val();
+            captured.get_list()->assign(std::make_move_iterator(args.begin() + fixed), std::make_move_iterator(args.end()));
+            vm.stack.push_back(captured);
+        }
+    }
+
+    int supplied = vm.stack.size() - frame_start;
+    int positional_args = proto->arity - proto->defaults;
+
+    if ((supplied < positional_args) || (supplied > proto->arity))
+    {
+        vm.stack.resize(frame_start);
+        runtimeError(vm, "Function '" + proto->name + "' expects " + std::to_string(proto->arity) + " argument(s)");
+        return false;
+    }
+
+    for (int i = frame_start; i < (int)vm.stack.size(); i++)
+    {
+        vm.stack[i].meta.is_const = false;
+    }
+
+    for (int i = supplied; i < proto->arity; i++)
+    {
+        if (proto->has_capture && i == proto->arity - 1)
+        {
+            vm.stack.push_back(list_val());
+            continue;
+        }
+        Value value = function_obj->default_values[i - positional_args];
+        value.meta = Meta();
+        vm.stack.push_back(value);
+    }
+
+    return true;
+}
+
+// Pushes the frame a resume of root runs: the innermost generator root
+// is delegating to through yield from. A delegate that finished is
+// dropped, so the generator waiting on it carries on.
+static bool resume_coroutine(VM &vm, const Ref<FunctionObj> &root, Value *sent, int instruction_index, CallFrame *&frame)
+{
+    // The generators passed on the way also see what was sent, so one
+    // whose delegate finishes on this resume carries on with it
+    FunctionObj *target = root.get();
+    while (target->coroutine->delegate)
+    {
+        if (sent)
+        {
+            target->coroutine->slots[target->proto->arity + 2] = *sent;
+        }
+        if (target->coroutine->delegate->generator_done)
+        {
+            target->coroutine->delegate = nullptr;
+            break;
+        }
+        target = target->coroutine->delegate.get();
     }
-    if (v1.is_none())
+
+    Coroutine &coroutine = *target->coroutine;
+    if (coroutine.running)
     {
-        return true;
+        runtimeError(vm, "Coroutine is already running");
+        return false;
     }
 
-    return false;
-}
+    CallFrame call_frame;
+    call_frame.function = Ref<FunctionObj>(target);
+    call_frame.name = target->proto->import_path;
+    call_frame.frame_start = vm.stack.size();
+    call_frame.sp = call_frame.frame_start;
+    call_frame.ip = coroutine.ip;
+    call_frame.instruction_index = instruction_index;
+    call_frame.resumed = root;
 
-bool is_falsey(Value &value)
-{
-    if (value.is_none() || value.is_boolean() && !value.get_boolean())
+    vm.stack.insert(vm.stack.end(), std::make_move_iterator(coroutine.slots.begin()), std::make_move_iterator(coroutine.slots.end()));
+    coroutine.slots.clear();
+    coroutine.running = true;
+
+    // _value sits right after the parameters and the function slot
+    if (sent)
     {
-        return true;
+        vm.stack[call_frame.frame_start + target->proto->arity + 2] = std::move(*sent);
     }
 
-    return false;
+    vm.frames.push_back(std::move(call_frame));
+    frame = &vm.frames.back();
+    return true;
 }
 
-void freeVM(VM &vm)
+// What a callee's receiver slot starts as. A method may change its
+// receiver even if the caller holds it as a constant.
+static Value receiver_value(Value *object)
 {
-    //
+    if (!object)
+    {
+        return none_val();
+    }
+    Value receiver = std::move(*object);
+    receiver.meta.temp_non_const = true;
+    return receiver;
 }
 
-static int call_function(VM &vm, Value &function, int param_num, CallFrame *&frame, std::shared_ptr<Value> object)
+static int call_function(VM &vm, Value &function, int param_num, CallFrame *&frame, Value *object, bool tail)
 {
-    if (vm.frames.size() > vm.call_stack_limit)
+    if ((int)vm.frames.size() > vm.call_stack_limit)
     {
         runtimeError(vm, "Stack size limit exceeded", "RecursionError");
         return -1;
     }
 
     auto &function_obj = function.get_function();
-    int positional_args = function_obj->arity - function_obj->defaults;
 
-    if (!function_obj->is_generator || (function_obj->is_generator && !function_obj->generator_init))
+    if (!function_obj->proto->is_generator || !function_obj->generator_init)
     {
-        int num_unpacked = 0;
-        int num_captured = 0;
-        int capturing = -1;
-
-        for (int i = 0; i < param_num; i++)
-        {
-            Value arg = pop(vm);
-            arg.meta.is_const = false;
-            if (arg.meta.unpack)
-            {
-                arg.meta.unpack = false;
-                num_unpacked--;
-                for (int j = 0; j < arg.get_list()->size(); j++)
-                {
-                    num_unpacked++;
-                    auto _arg = arg.get_list()->at(j);
-                    Value &constant = function_obj->chunk.constants[i + j];
-                    if (constant.is_list() && constant.meta.packer)
-                    {
-                        capturing = i + j;
-                        constant = copy(constant);
-                        constant.get_list()->clear();
-                        constant.get_list()->push_back(_arg);
-                    }
-                    else
-                    {
-                        if (capturing >= 0)
-                        {
-                            function_obj->chunk.constants[capturing].get_list()->push_back(_arg);
-                            num_captured++;
-                        }
-                        else
-                        {
-                            function_obj->chunk.constants[i + j] = _arg;
-                        }
-                    }
-                }
-            }
-            else
-            {
-                Value &constant = function_obj->chunk.constants[i];
-                if (constant.is_list() && constant.meta.packer)
-                {
-                    capturing = i;
-                    constant = copy(constant);
-                    constant.get_list()->clear();
-                    constant.get_list()->push_back(arg);
-                }
-                else
-                {
-                    if (capturing >= 0)
-                    {
-                        function_obj->chunk.constants[capturing].get_list()->push_back(arg);
-                        num_captured++;
-                    }
-                    else
-                    {
-                        function_obj->chunk.constants[i] = arg;
-                    }
-                }
-            }
-        }
-
-        param_num += num_unpacked - num_captured;
-
-        if ((param_num < positional_args) || (param_num > function_obj->arity))
+        if (!bind_arguments(vm, function, param_num))
         {
-            runtimeError(vm, "Function '" + function_obj->name + "' expects " + std::to_string(function_obj->arity) + " argument(s)");
             return -1;
         }
-
-        if (param_num < function_obj->arity)
-        {
-            // We have defaults we want to inject
-            int default_index = param_num - positional_args;
-            for (int i = param_num; i < function_obj->arity; i++)
-            {
-                Meta meta = function_obj->chunk.constants[i].meta;
-                function_obj->chunk.constants[i] = function_obj->default_values[default_index];
-                function_obj->chunk.constants[i].meta = meta;
-                default_index++;
-            }
-        }
     }
 
     // disassemble_chunk(function_obj->chunk, function_obj->name + "__");
 
-    if (function_obj->is_generator && !function_obj->generator_init)
+    if (function_obj->proto->is_generator && !function_obj->generator_init)
     {
-        auto function_copy = copy(function);
-        auto &function_copy_obj = function_copy.get_function();
-        function_copy_obj->generator_init = true;
-        auto call_frame = std::make_shared<CallFrame>();
-        call_frame->frame_start = vm.stack.size();
-        call_frame->function = function_copy_obj;
-        call_frame->sp = vm.stack.size();
-        call_frame->ip = function_copy_obj->chunk.code.data();
-
-        function_copy_obj->name = function_copy_obj->name + "_" + std::to_string(vm.coro_count++);
-
-        int instruction_index = frame->ip - &frame->function->chunk.code[0];
-        call_frame->instruction_index = instruction_index;
-
-        auto offsets = instruction_offsets(call_frame->function->chunk);
-        call_frame->function->instruction_offsets = offsets;
-
-        vm.gen_frames[function_copy_obj->name] = call_frame;
-
-        push(vm, function_copy);
+        // Each instance owns its suspended frame. The bound arguments, the
+        // generator function, its receiver and _value make up its first
+        // segment.
+        Value instance = copy(function);
+        auto &instance_obj = instance.get_function();
+        instance_obj->generator_init = true;
+        instance_obj->coroutine = std::make_unique<Coroutine>();
+
+        Coroutine &coroutine = *instance_obj->coroutine;
+        int frame_start = vm.stack.size() - function_obj->proto->arity;
+        coroutine.slots.assign(std::make_move_iterator(vm.stack.begin() + frame_start), std::make_move_iterator(vm.stack.end()));
+        coroutine.slots.push_back(function);
+        coroutine.slots.push_back(receiver_value(object));
+        coroutine.slots.push_back(none_val());
+        coroutine.ip = function_obj->proto->chunk.code.data();
+        vm.stack.resize(frame_start);
+
+        push(vm, instance);
         return 0;
     }
-    else if (function_obj->is_generator && function_obj->generator_done)
+    else if (function_obj->proto->is_generator && function_obj->generator_done)
     {
+        for (int i = 0; i < param_num; i++)
+        {
+            pop(vm);
+        }
         Value none = none_val();
         push(vm, none);
         return 0;
     }
-    else if (function_obj->is_generator && function_obj->generator_init)
+    else if (function_obj->proto->is_generator && function_obj->generator_init)
     {
-        auto &call_frame = vm.gen_frames[function_obj->name];
-        call_frame->frame_start = vm.stack.size();
-        call_frame->sp = vm.stack.size();
-
         if (param_num > 1)
         {
+            for (int i = 0; i < param_num; i++)
+            {
+                pop(vm);
+            }
             runtimeError(vm, "Coroutine can only be called with one argument for parameter '_value'");
+            return -1;
         }
 
-        int _value_index = -1;
-
+        Value sent;
         if (param_num == 1)
         {
-            for (int i = 0; i < call_frame->function->chunk.variables.size(); i++)
-            {
-                if (call_frame->function->chunk.variables[i] == "_value")
-                {
-                    _value_index = i;
-                    break;
-                }
-            }
-
-            if (_value_index == -1)
-            {
-                runtimeError(vm, "Missing variable '_value'");
-            }
-
-            call_frame->function->chunk.constants[_value_index] = pop(vm);
-            call_frame->frame_start--;
-            call_frame->sp--;
+            sent = pop(vm);
         }
 
-        for (int i = 0; i < call_frame->gen_stack.size(); i++)
-        {
-            Value &value = call_frame->gen_stack[i];
-            if (i == _value_index)
-            {
-                push(vm, call_frame->function->chunk.constants[_value_index]);
-            }
-            else
-            {
-                push(vm, value);
-            }
-        }
+        int instruction_index = frame->ip - &frame->function->proto->chunk.code[0];
+        return resume_coroutine(vm, function_obj, param_num == 1 ? &sent : nullptr, instruction_index, frame) ? 0 : -1;
+    }
 
-        int instruction_index = frame->ip - &frame->function->chunk.code[0];
-        call_frame->instruction_index = instruction_index;
+    // A tail call hands the callee this frame and its stack window, unless
+    // the frame still has to run something once the callee returns
+    Ref<FunctionProto> &current = frame->function->proto;
+    if (tail && !current->is_generator && !current->is_type_generator && !find_handler(*frame))
+    {
+        int arity = function_obj->proto->arity;
+        close_values(vm, vm.stack.data() + frame->sp);
+        std::move(vm.stack.end() - arity, vm.stack.end(), vm.stack.begin() + frame->frame_start);
+        vm.stack.resize(frame->frame_start + arity);
+
+        frame->function = function_obj;
+        frame->name = function_obj->proto->import_path;
+        frame->ip = function_obj->proto->chunk.code.data();
 
-        vm.frames.push_back(*call_frame);
-        frame = &*call_frame;
+        push(vm, function);
+        push(vm, receiver_value(object));
         return 0;
     }
 
     CallFrame call_frame;
-    call_frame.frame_start = vm.stack.size();
+    call_frame.frame_start = vm.stack.size() - function_obj->proto->arity;
     call_frame.function = function_obj;
-    call_frame.name = function_obj->import_path;
-    if (object)
-    {
-        call_frame.function->object = object;
-    }
-    call_frame.sp = vm.stack.size();
-    call_frame.ip = function_obj->chunk.code.data();
+    call_frame.name = function_obj->proto->import_path;
+    call_frame.sp = call_frame.frame_start;
+    call_frame.ip = function_obj->proto->chunk.code.data();
 
-    int instruction_index = frame->ip - &frame->function->chunk.code[0];
+    int instruction_index = frame->ip - &frame->function->proto->chunk.code[0];
     call_frame.instruction_index = instruction_index;
 
-    vm.frames.push_back(call_frame);
+    push(vm, function);
+    push(vm, receiver_value(object));
+    vm.frames.push_back(std::move(call_frame));
     frame = &vm.frames.back();
 
     return 0;
@@ -3044,7 +4148,7 @@ static Value dis_builtin(std::vector<Value> &args)
     }
 
     std::cout << '\n';
-    disassemble_chunk(function.get_function()->chunk, function.get_function()->name);
+    disassemble_chunk(function.get_function()->proto->chunk, function.get_function()->proto->name);
 
     return none_val();
 }
@@ -3108,6 +4212,50 @@ static Value to_number_builtin(std::vector<Value> &args)
     }
 }
 
+// The list as it was before append, insert or remove changed it. Those
+// only move elements around, so the elements themselves are shared
+static Value list_snapshot(Value &list)
+{
+    Value snapshot = list_val();
+    snapshot.meta = list.meta;
+    *snapshot.get_list() = *list.get_list();
+    return snapshot;
+}
+
+// Runs the onChange hook of a list append, insert or remove changed
+static Value call_list_hook(Value &list, Value &old)
+{
+    ValueHooks hooks = list.get_hooks();
+    auto &ls = list.get_list();
+
+    Value obj = object_val();
+    obj.get_object()->keys = {"old", "current", "name"};
+
+    obj.get_object()->values["old"] = old;
+    obj.get_object()->values["current"] = list;
+    obj.get_object()->values["name"] = string_val(hooks.onChangeHookName);
+
+    // store onChangeHook here
+    auto hook = hooks.onChangeHook;
+    uint32_t value_hooks = obj.get_object()->values["current"].hooks_id;
+    obj.get_object()->values["current"].set_hooks_id(0);
+
+    std::vector<Value> hook_args = {obj};
+    Value result = vm_call(*current_vm, *hook, hook_args);
+
+    obj.get_object()->values["current"].set_hooks_id(value_hooks);
+
+    if (result.is_object() && result.get_object()->type_name == "Error")
+    {
+        return result;
+    }
+
+    obj.get_object()->values["current"].set_hooks_id(list.hooks_id);
+    *ls = *obj.get_object()->values["current"].get_list();
+
+    return list;
+}
+
 static Value insert_builtin(std::vector<Value> &args)
 {
     int arg_count = 3;
@@ -3142,71 +4290,16 @@ static Value insert_builtin(std::vector<Value> &args)
         pos_num = ls->size();
     }
 
-    Value list_copy = copy(list);
-
-    ls->insert(ls->begin() + pos_num, value);
-
-    if (list.hooks.onChangeHook)
+    if (!list.hooks_id || !list.get_hooks().onChangeHook)
     {
-        Value obj = object_val();
-        obj.get_object()->keys = {"old", "current", "name"};
-
-        Value old_pure = copy(list_copy);
-        old_pure.hooks.onChangeHook = nullptr;
-        old_pure.hooks.onAccessHook = nullptr;
-        obj.get_object()->values["old"] = old_pure;
-
-        obj.get_object()->values["current"] = list;
-        obj.get_object()->values["name"] = string_val(list_copy.hooks.onChangeHookName);
-
-        // store onChangeHook here
-        auto hook = list_copy.hooks.onChangeHook;
-        obj.get_object()->values["old"].hooks.onChangeHook = nullptr;
-
-        auto value_hook = obj.get_object()->values["current"].hooks.onChangeHook;
-        obj.get_object()->values["current"].hooks.onChangeHook = nullptr;
-
-        VM func_vm;
-        std::shared_ptr<FunctionObj> main = std::make_shared<FunctionObj>();
-        main->name = "";
-        main->arity = 0;
-        main->chunk = Chunk();
-        CallFrame main_frame;
-        main_frame.function = main;
-        main_frame.sp = 0;
-        main_frame.ip = main->chunk.code.data();
-        main_frame.frame_start = 0;
-        func_vm.frames.push_back(main_frame);
-
-        add_constant(main->chunk, *hook);
-        add_constant(main->chunk, obj);
-
-        add_opcode(main->chunk, OP_LOAD_CONST, 1, 0);
-        add_opcode(main->chunk, OP_LOAD_CONST, 0, 0);
-        add_opcode(main->chunk, OP_CALL, 1, 0);
-        add_code(main->chunk, OP_EXIT, 0);
-
-        auto offsets = instruction_offsets(main_frame.function->chunk);
-        main_frame.function->instruction_offsets = offsets;
-
-        auto status = evaluate(func_vm);
-
-        obj.get_object()->values["old"].hooks.onChangeHook = hook;
-        obj.get_object()->values["current"].hooks.onChangeHook = value_hook;
-
-        if (status != 0)
-        {
-            exit(1);
-        }
-
-        obj.get_object()->values["current"].hooks.onChangeHook = list.hooks.onChangeHook;
-        obj.get_object()->values["current"].hooks.onChangeHookName = list.hooks.onChangeHookName;
-        obj.get_object()->values["current"].hooks.onAccessHook = list.hooks.onAccessHook;
-        obj.get_object()->values["current"].hooks.onAccessHookName = list.hooks.onAccessHookName;
-        *ls = *obj.get_object()->values["current"].get_list();
+        ls->insert(ls->begin() + pos_num, value);
+        return list;
     }
 
-    return list;
+    Value old = list_snapshot(list);
+    ls->insert(ls->begin() + pos_num, value);
+
+    return call_list_hook(list, old);
 }
 
 static Value append_builtin(std::vector<Value> &args)
@@ -3225,72 +4318,18 @@ static Value append_builtin(std::vector<Value> &args)
         return error_object("Function 'append' expects argument 'list' to be a list");
     }
 
-    Value list_copy = copy(list);
-
     auto &ls = list.get_list();
-    ls->push_back(value);
 
-    if (list.hooks.onChangeHook)
+    if (!list.hooks_id || !list.get_hooks().onChangeHook)
     {
-        Value obj = object_val();
-        obj.get_object()->keys = {"old", "current", "name"};
-
-        Value old_pure = copy(list_copy);
-        old_pure.hooks.onChangeHook = nullptr;
-        old_pure.hooks.onAccessHook = nullptr;
-
-        obj.get_object()->values["old"] = list_copy;
-        obj.get_object()->values["current"] = list;
-        obj.get_object()->values["name"] = string_val(list_copy.hooks.onChangeHookName);
-
-        // store onChangeHook here
-        auto hook = list_copy.hooks.onChangeHook;
-        obj.get_object()->values["old"].hooks.onChangeHook = nullptr;
-
-        auto value_hook = obj.get_object()->values["current"].hooks.onChangeHook;
-        obj.get_object()->values["current"].hooks.onChangeHook = nullptr;
-
-        VM func_vm;
-        std::shared_ptr<FunctionObj> main = std::make_shared<FunctionObj>();
-        main->name = "";
-        main->arity = 0;
-        main->chunk = Chunk();
-        CallFrame main_frame;
-        main_frame.function = main;
-        main_frame.sp = 0;
-        main_frame.ip = main->chunk.code.data();
-        main_frame.frame_start = 0;
-        func_vm.frames.push_back(main_frame);
-
-        add_constant(main->chunk, *hook);
-        add_constant(main->chunk, obj);
-
-        add_opcode(main->chunk, OP_LOAD_CONST, 1, 0);
-        add_opcode(main->chunk, OP_LOAD_CONST, 0, 0);
-        add_opcode(main->chunk, OP_CALL, 1, 0);
-        add_code(main->chunk, OP_EXIT, 0);
-
-        auto offsets = instruction_offsets(main_frame.function->chunk);
-        main_frame.function->instruction_offsets = offsets;
-
-        auto status = evaluate(func_vm);
-
-        obj.get_object()->values["old"].hooks.onChangeHook = hook;
-        obj.get_object()->values["current"].hooks.onChangeHook = value_hook;
-
-        if (status != 0)
-        {
-            exit(1);
-        }
-
-        obj.get_object()->values["current"].hooks.onChangeHook = list.hooks.onChangeHook;
-        obj.get_object()->values["current"].hooks.onChangeHookName = list.hooks.onChangeHookName;
-        obj.get_object()->values["current"].hooks.onAccessHook = list.hooks.onAccessHook;
-        obj.get_object()->values["current"].hooks.onAccessHookName = list.hooks.onAccessHookName;
-        *ls = *obj.get_object()->values["current"].get_list();
+        ls->push_back(value);
+        return list;
     }
 
-    return list;
+    Value old = list_snapshot(list);
+    ls->push_back(value);
+
+    return call_list_hook(list, old);
 }
 
 static Value remove_builtin(std::vector<Value> &args)
@@ -3317,79 +4356,21 @@ static Value remove_builtin(std::vector<Value> &args)
     int pos_num = pos.get_number();
     auto &ls = list.get_list();
 
-    Value list_copy = copy(list);
-
     if (pos_num < 0 || pos_num >= ls->size())
     {
         return list;
     }
 
-    if (ls->size() > 0)
+    if (!list.hooks_id || !list.get_hooks().onChangeHook)
     {
         ls->erase(ls->begin() + pos_num);
+        return list;
     }
 
-    if (list.hooks.onChangeHook)
-    {
-        Value obj = object_val();
-        obj.get_object()->keys = {"old", "current", "name"};
-
-        Value old_pure = copy(list_copy);
-        old_pure.hooks.onChangeHook = nullptr;
-        old_pure.hooks.onAccessHook = nullptr;
-
-        obj.get_object()->values["old"] = old_pure;
-        obj.get_object()->values["current"] = list;
-        obj.get_object()->values["name"] = string_val(list_copy.hooks.onChangeHookName);
-
-        // store onChangeHook here
-        auto hook = list_copy.hooks.onChangeHook;
-        obj.get_object()->values["old"].hooks.onChangeHook = nullptr;
-
-        auto value_hook = obj.get_object()->values["current"].hooks.onChangeHook;
-        obj.get_object()->values["current"].hooks.onChangeHook = nullptr;
-
-        VM func_vm;
-        std::shared_ptr<FunctionObj> main = std::make_shared<FunctionObj>();
-        main->name = "";
-        main->arity = 0;
-        main->chunk = Chunk();
-        CallFrame main_frame;
-        main_frame.function = main;
-        main_frame.sp = 0;
-        main_frame.ip = main->chunk.code.data();
-        main_frame.frame_start = 0;
-        func_vm.frames.push_back(main_frame);
-
-        add_constant(main->chunk, *hook);
-        add_constant(main->chunk, obj);
-
-        add_opcode(main->chunk, OP_LOAD_CONST, 1, 0);
-        add_opcode(main->chunk, OP_LOAD_CONST, 0, 0);
-        add_opcode(main->chunk, OP_CALL, 1, 0);
-        add_code(main->chunk, OP_EXIT, 0);
-
-        auto offsets = instruction_offsets(main_frame.function->chunk);
-        main_frame.function->instruction_offsets = offsets;
-
-        auto status = evaluate(func_vm);
-
-        obj.get_object()->values["old"].hooks.onChangeHook = hook;
-        obj.get_object()->values["current"].hooks.onChangeHook = value_hook;
+    Value old = list_snapshot(list);
+    ls->erase(ls->begin() + pos_num);
 
-        if (status != 0)
-        {
-            exit(1);
-        }
-
-        obj.get_object()->values["current"].hooks.onChangeHook = list.hooks.onChangeHook;
-        obj.get_object()->values["current"].hooks.onChangeHookName = list.hooks.onChangeHookName;
-        obj.get_object()->values["current"].hooks.onAccessHook = list.hooks.onAccessHook;
-        obj.get_object()->values["current"].hooks.onAccessHookName = list.hooks.onAccessHookName;
-        *ls = *obj.get_object()->values["current"].get_list();
-    }
-
-    return list;
+    return call_list_hook(list, old);
 }
 
 static Value remove_prop_builtin(std::vector<Value> &args)
@@ -3413,7 +4394,7 @@ static Value remove_prop_builtin(std::vector<Value> &args)
         return error_object("Function 'remove_prop' expects argument 'name' to be a string");
     }
 
-    std::string &_name = name.get_string();
+    const std::string &_name = name.get_string();
     auto &_obj = obj.get_object();
 
     _obj->values.erase(_name);
@@ -3449,6 +4430,10 @@ static Value length_builtin(std::vector<Value> &args)
     {
         return number_val(value.get_string().length());
     }
+    case Range:
+    {
+        return number_val(value.range_length());
+    }
     default:
     {
         return none_val();
@@ -3507,7 +4492,12 @@ static Value type_builtin(std::vector<Value> &args)
     {
         return string_val("None");
     }
+    case Range:
+    {
+        return string_val("Range");
+    }
     }
+    return string_val("None");
 }
 
 static Value info_builtin(std::vector<Value> &args)
@@ -3528,14 +4518,14 @@ static Value info_builtin(std::vector<Value> &args)
     {
         obj->keys = {"name", "arity", "params", "generator", "init", "done"};
         auto &func = value.get_function();
-        obj->values["name"] = string_val(func->name);
-        obj->values["arity"] = number_val(func->arity);
+        obj->values["name"] = string_val(func->proto->name);
+        obj->values["arity"] = number_val(func->proto->arity);
         obj->values["params"] = list_val();
-        for (auto &param : func->params)
+        for (auto &param : func->proto->params)
         {
             obj->values["params"].get_list()->push_back(string_val(param));
         }
-        obj->values["generator"] = boolean_val(func->is_generator);
+        obj->values["generator"] = boolean_val(func->proto->is_generator);
         obj->values["init"] = boolean_val(func->generator_init);
         obj->values["done"] = boolean_val(func->generator_done);
         return info;
@@ -3581,7 +4571,7 @@ static Value id_builtin(std::vector<Value> &args)
 
     Value value = args[0];
 
-    return number_val(value.id);
+    return number_val(value.get_id());
 }
 
 static Value load_lib_builtin(std::vector<Value> &args)
@@ -3686,20 +4676,16 @@ Value copy(Value &value)
     {
     case Function:
     {
-        Value new_func = function_val();
-        new_func.get_function()->arity = value.get_function()->arity;
-        new_func.get_function()->chunk = value.get_function()->chunk;
-        new_func.get_function()->closed_var_indexes = value.get_function()->closed_var_indexes;
+        Value new_func = function_val(value.get_function()->proto);
         new_func.get_function()->closed_vars = value.get_function()->closed_vars;
         new_func.get_function()->default_values = value.get_function()->default_values;
         new_func.get_function()->generator_done = value.get_function()->generator_done;
         new_func.get_function()->generator_init = value.get_function()->generator_init;
-        new_func.get_function()->is_generator = value.get_function()->is_generator;
-        new_func.get_function()->defaults = value.get_function()->defaults;
-        new_func.get_function()->is_type_generator = value.get_function()->is_type_generator;
-        new_func.get_function()->name = value.get_function()->name;
-        new_func.get_function()->object = value.get_function()->object;
-        new_func.hooks = value.hooks;
+        if (value.get_function()->coroutine)
+        {
+            new_func.get_function()->coroutine = std::make_unique<Coroutine>(*value.get_function()->coroutine);
+        }
+        new_func.set_hooks_id(value.hooks_id);
         return new_func;
     }
     case List:
@@ -3710,7 +4696,7 @@ Value copy(Value &value)
         {
             new_list.get_list()->push_back(copy(elem));
         }
-        new_list.hooks = value.hooks;
+        new_list.set_hooks_id(value.hooks_id);
         return new_list;
     }
     case Object:
@@ -3722,11 +4708,12 @@ Value copy(Value &value)
         {
             new_object.get_object()->keys.push_back(key);
         }
-        for (auto prop : value.get_object()->values)
+        new_object.get_object()->values = value.get_object()->values;
+        for (Value &slot : new_object.get_object()->values.slots)
         {
-            new_object.get_object()->values[prop.first] = copy(prop.second);
+            slot = copy(slot);
         }
-        new_object.hooks = value.hooks;
+        new_object.set_hooks_id(value.hooks_id);
         return new_object;
     }
     default:
@@ -3755,7 +4742,9 @@ static Value pure_builtin(std::vector<Value> &args)
     }
 
     Value value = copy(args[0]);
-    value.hooks.onChangeHook = nullptr;
+    ValueHooks hooks = value.get_hooks();
+    hooks.onChangeHook = nullptr;
+    value.set_hooks(hooks);
     return value;
 }
 
@@ -3779,57 +4768,45 @@ static Value sort_builtin(std::vector<Value> &args)
         return value;
     }
 
-    auto &func = function.get_function();
-
     Value new_list = copy(value);
 
-    VM func_vm;
-    std::shared_ptr<FunctionObj> main = std::make_shared<FunctionObj>();
-    main->name = "";
-    main->arity = 0;
-    main->chunk = Chunk();
-    CallFrame main_frame;
-    main_frame.function = main;
-    main_frame.sp = 0;
-    main_frame.ip = main->chunk.code.data();
-    main_frame.frame_start = 0;
-    func_vm.frames.push_back(main_frame);
-
-    add_constant(main->chunk, function);
-    add_constant(main->chunk, new_list.get_list()->at(1));
-    add_constant(main->chunk, new_list.get_list()->at(0));
-
-    add_opcode(main->chunk, OP_LOAD_CONST, 1, 0);
-    add_opcode(main->chunk, OP_LOAD_CONST, 2, 0);
-    add_opcode(main->chunk, OP_LOAD_CONST, 0, 0);
-    add_opcode(main->chunk, OP_CALL, 2, 0);
-    add_code(main->chunk, OP_EXIT, 0);
-
-    auto offsets = instruction_offsets(main_frame.function->chunk);
-    main_frame.function->instruction_offsets = offsets;
+    VM &vm = *current_vm;
+    std::vector<Value> compare_args(2);
+    Value error;
 
+    // Once the comparator fails every remaining comparison reports the
+    // elements as equal so std::sort can finish without reading out of bounds
     std::sort(new_list.get_list()->begin(), new_list.get_list()->end(),
-              [&func_vm, &function](const Value &lhs, const Value &rhs)
+              [&vm, &function, &compare_args, &error](const Value &lhs, const Value &rhs)
               {
-                  auto &frame = func_vm.frames.back();
-                  frame.function->chunk.constants[1] = rhs;
-                  frame.function->chunk.constants[2] = lhs;
+                  if (!error.is_none())
+                  {
+                      return false;
+                  }
 
-                  evaluate(func_vm);
+                  compare_args[0] = lhs;
+                  compare_args[1] = rhs;
+                  Value result = vm_call(vm, function, compare_args);
 
-                  if (func_vm.status != 0)
+                  if (result.is_object() && result.get_object()->type_name == "Error")
                   {
-                      error("Error in sort function");
+                      error = result;
+                      return false;
                   }
 
-                  if (!func_vm.stack.back().is_boolean())
+                  if (!result.is_boolean())
                   {
                       return false;
                   }
 
-                  return func_vm.stack.back().get_boolean();
+                  return result.get_boolean();
               });
 
+    if (!error.is_none())
+    {
+        return error;
+    }
+
     return new_list;
 }
 
@@ -3943,39 +4920,27 @@ static Value future_builtin(std::vector<Value> &args)
         return error_object("Function '__future__' expects argument 'vm' to be a Pointer");
     }
 
-    if (func.get_function()->arity != 0)
+    if (func.get_function()->proto->arity != 0)
     {
         return error_object("Function '__future__' expects argument 'function' to be a Function with 0 parameters");
     }
 
     VM *_vm = (VM *)(vm.get_pointer()->value);
 
+    // The thread shares values with this one, so reference counts stay
+    // atomic and no cycles are collected until it is done with them
+    begin_shared_heap();
     auto _future = std::async(std::launch::async, [vm = std::move(_vm), func = std::move(func)]() mutable
                               {
-        VM func_vm;
-        std::shared_ptr<FunctionObj> main = std::make_shared<FunctionObj>();
-        main->name = "";
-        main->arity = 0;
-        main->chunk = Chunk();
-        CallFrame main_frame;
-        main_frame.function = main;
-        main_frame.sp = 0;
-        main_frame.ip = main->chunk.code.data();
-        main_frame.frame_start = 0;
-        func_vm.frames.push_back(main_frame);
-
-        add_constant(main->chunk, func);
-        add_opcode(main->chunk, OP_LOAD_CONST, 0, 0);
-        add_opcode(main->chunk, OP_CALL, 0, 0);
-
-        add_code(main->chunk, OP_EXIT, 0);
-
-        auto offsets = instruction_offsets(main_frame.function->chunk);
-        main_frame.function->instruction_offsets = offsets;
-
-        evaluate(func_vm);
-
-        return func_vm.stack.back(); })
+        Value result;
+        {
+            VM func_vm;
+            std::vector<Value> args;
+            Value function = std::move(func);
+            result = vm_call(func_vm, function, args);
+        }
+        end_shared_heap();
+        return result; })
                        .share();
 
     auto f = new std::shared_future<Value>(_future);
@@ -4039,4 +5004,99 @@ static Value check_future_builtin(std::vector<Value> &args)
     }
 
     return boolean_val(false);
-}
\ No newline at end of file
+}
+
+static Value collect_builtin(std::vector<Value> &args)
+{
+    if (args.size() != 0)
+    {
+        return error_object("Function '__collect__' expects 0 arguments");
+    }
+
+    return number_val(collect_cycles());
+}
+
+static Value collector_stats_builtin(std::vector<Value> &args)
+{
+    if (args.size() != 0)
+    {
+        return error_object("Function '__collector_stats__' expects 0 arguments");
+    }
+
+    CollectorStats stats = collector_stats();
+
+    Value info = object_val();
+    auto &obj = info.get_object();
+    obj->keys = {"collections", "collected", "tracked", "allocated", "threshold", "growth"};
+    obj->values["collections"] = number_val(stats.collections);
+    obj->values["collected"] = number_val(stats.collected);
+    obj->values["tracked"] = number_val(stats.tracked);
+    obj->values["allocated"] = number_val(stats.allocated);
+    obj->values["threshold"] = number_val(stats.threshold);
+    obj->values["growth"] = number_val(stats.growth);
+    return info;
+}
+
+static Value collector_threshold_builtin(std::vector<Value> &args)
+{
+    int num_required_args = 2;
+
+    if (args.size() != num_required_args)
+    {
+        return error_object("Function '__collector_threshold__' expects " + std::to_string(num_required_args) + " argument(s)");
+    }
+
+    Value threshold = args[0];
+    Value growth = args[1];
+
+    if (!threshold.is_number() || threshold.get_number() < 0)
+    {
+        return error_object("Function '__collector_threshold__' expects argument 'threshold' to be a non-negative Number");
+    }
+
+    if (!growth.is_number() || growth.get_number() < 0)
+    {
+        return error_object("Function '__collector_threshold__' expects argument 'growth' to be a non-negative Number");
+    }
+
+    set_collector_threshold(threshold.get_number(), growth.get_number());
+    return none_val();
+}
+// Lists the VM's global slots. It reads the VM's own GlobalTable, so it
+// lives here rather than in the sys library, which would have to be
+// rebuilt whenever that layout changes.
+static Value global_slots_builtin(std::vector<Value> &args)
+{
+    int num_required_args = 1;
+
+    if (args.size() != num_required_args)
+    {
+        return error_object("Function '__global_slots__' expects " + std::to_string(num_required_args) + " argument(s)");
+    }
+
+    Value vm = args[0];
+
+    if (!vm.is_pointer())
+    {
+        return error_object("Function '__global_slots__' expects argument 'vm' to be a Pointer");
+    }
+
+    VM *_vm = (VM *)(vm.get_pointer()->value);
+
+    Value list = list_val();
+
+    for (int slot = 0; slot < (int)_vm->globals.names.size(); slot++)
+    {
+        if (_vm->globals.names[slot].empty())
+        {
+            continue;
+        }
+        Value obj = object_val();
+        obj.get_object()->values["slot"] = number_val(slot);
+        obj.get_object()->values["name"] = string_val(_vm->globals.names[slot]);
+        obj.get_object()->keys = {"slot", "name"};
+        list.get_list()->push_back(obj);
+    }
+
+    return list;
+}
@@ -33,18 +33,27 @@
 struct CallFrame
 {
     std::string name;
-    std::shared_ptr<FunctionObj> function;
+    Ref<FunctionObj> function;
     uint8_t *ip;
     int frame_start;
     int sp;
     int instruction_index;
-    std::vector<Value> gen_stack;
+    /* The generator the caller resumed, for generator frames */
+    Ref<FunctionObj> resumed;
+};
+
+// Globals indexed by the slot global_slot() gave their name. An empty
+// name marks a slot this table does not define.
+struct GlobalTable
+{
+    std::vector<Value> values;
+    std::vector<std::string> names;
 };
 
 struct CachedImport
 {
     Value import_object;
-    std::unordered_map<std::string, Value> import_globals;
+    GlobalTable import_globals;
 };
 struct VM
 {
@@ -52,19 +61,23 @@ struct VM
     Value *sp;
     /* Possibly change to array with specified MAX_DEPTH */
     std::vector<CallFrame> frames;
-    std::unordered_map<std::string, std::shared_ptr<CallFrame>> gen_frames;
     std::vector<Value *> objects;
-    std::unordered_map<std::string, Value> globals;
+    GlobalTable globals;
     int status = 0;
-    std::vector<std::shared_ptr<Closure>> closed_values;
-    int coro_count = 0;
-    std::vector<int> try_instructions;
+    /* Closures still pointing into the stack, ordered by address */
+    std::vector<std::shared_ptr<Closure>> open_closures;
     int call_stack_limit = 3000;
     std::unordered_map<std::string, CachedImport> import_cache;
+    /* Frame depth vm_call returns at */
+    int return_depth = 0;
+    Value callback_error;
 
     VM()
     {
         stack.reserve(100000);
+        // Natives hold on to frame pointers while they call back into the
+        // VM, so the frame vector must never reallocate
+        frames.reserve(call_stack_limit + 16);
     }
 };
 
@@ -76,16 +89,18 @@ enum EvaluateResult
 };
 
 void push(VM &vm, Value &value);
+void push(VM &vm, Value &&value);
 Value pop(VM &vm);
 Value pop_close(VM &vm);
+void close_values(VM &vm, Value *last);
 
 static void runtimeError(VM &vm, std::string message, std::string error_type = "GenericError", ...);
 static void define_global(VM &vm, std::string name, Value value);
 static void define_native(VM &vm, std::string name, NativeFunction function);
 static EvaluateResult run(VM &vm);
 EvaluateResult evaluate(VM &vm);
+Value vm_call(VM &vm, Value function, std::vector<Value> &args);
 
-static int call_function(VM &vm, Value &function, int param_num, CallFrame *&frame, std::shared_ptr<Value> object = nullptr);
 
 void freeVM(VM &vm);
 
@@ -34,22 +34,23 @@ int main(int argc, char **argv)
         auto ast = parser.nodes;
 
         VM vm;
-        std::shared_ptr<FunctionObj> main = std::make_shared<FunctionObj>();
-        main->name = "";
-        main->arity = 0;
-        main->chunk = Chunk();
+        Ref<FunctionObj> main = make_ref<FunctionObj>();
+        main->proto->name = "";
+        main->proto->arity = 0;
+        main->proto->chunk = Chunk();
         CallFrame main_frame;
         main_frame.name = "source.vtx";
         main_frame.function = main;
         main_frame.sp = 0;
-        main_frame.ip = main->chunk.code.data();
+        main_frame.ip = main->proto->chunk.code.data();
         main_frame.frame_start = 0;
 
-        generate_bytecode(parser.nodes, main_frame.function->chunk, parser.file_name);
-        add_code(main_frame.function->chunk, OP_EXIT);
-        disassemble_chunk(main_frame.function->chunk, "Test");
-        auto offsets = instruction_offsets(main_frame.function->chunk);
-        main_frame.function->instruction_offsets = offsets;
+        generate_bytecode(parser.nodes, main_frame.function->proto->chunk, parser.file_name);
+        add_code(main_frame.function->proto->chunk, OP_EXIT);
+        optimize_chunk(main_frame.function->proto->chunk);
+        disassemble_chunk(main_frame.function->proto->chunk, "Test");
+        auto offsets = instruction_offsets(main_frame.function->proto->chunk);
+        main_frame.function->proto->instruction_offsets = offsets;
         vm.frames.push_back(main_frame);
         evaluate(vm);
 
@@ -104,6 +105,10 @@ int main(int argc, char **argv)
                     import_path = args[i + 1];
                 }
             }
+            else if (arg == "-legacy-parser")
+            {
+                Parser::legacy = true;
+            }
         }
 
         Lexer lexer(path);
@@ -121,23 +126,24 @@ int main(int argc, char **argv)
         auto ast = parser.nodes;
 
         VM vm;
-        std::shared_ptr<FunctionObj> main = std::make_shared<FunctionObj>();
-        main->name = "";
-        main->arity = 0;
-        main->chunk = Chunk();
-        main->chunk.import_path = import_path;
+        Ref<FunctionObj> main = make_ref<FunctionObj>();
+        main->proto->name = "";
+        main->proto->arity = 0;
+        main->proto->chunk = Chunk();
+        main->proto->chunk.import_path = import_path;
         CallFrame main_frame;
         main_frame.name = path;
         main_frame.function = main;
         main_frame.sp = 0;
-        main_frame.ip = main->chunk.code.data();
+        main_frame.ip = main->proto->chunk.code.data();
         main_frame.frame_start = 0;
 
-        generate_bytecode(parser.nodes, main_frame.function->chunk, path);
-        auto offsets = instruction_offsets(main_frame.function->chunk);
-        main_frame.function->instruction_offsets = offsets;
+        generate_bytecode(parser.nodes, main_frame.function->proto->chunk, path);
+        optimize_chunk(main_frame.function->proto->chunk);
+        auto offsets = instruction_offsets(main_frame.function->proto->chunk);
+        main_frame.function->proto->instruction_offsets = offsets;
         vm.frames.push_back(main_frame);
-        add_code(main_frame.function->chunk, OP_EXIT);
+        add_code(main_frame.function->proto->chunk, OP_EXIT);
         evaluate(vm);
 
         exit(0);
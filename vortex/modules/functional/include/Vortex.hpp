@@ -4,12 +4,15 @@
 #include <vector>
 #include <unordered_map>
 #include <string>
+#include <atomic>
+#include <mutex>
+#include <optional>
 #include <iostream>
 #include <variant>
 #include <cstdarg>
 #include <cmath>
 
-enum class ValueType
+enum class ValueType : uint8_t
 {
     Number,
     String,
@@ -20,21 +23,200 @@ enum class ValueType
     Function,
     Native,
     Pointer,
-    None
+    None,
+    Range
 };
 
 struct Value;
 struct Closure;
 
 std::string toString(Value value);
+
+// Heap objects carry their own reference count, so a Value only needs a
+// single pointer to them. Copying a RefCounted never copies the count.
+struct RefCounted
+{
+    std::atomic<int> ref_count{0};
+
+    RefCounted() {}
+    RefCounted(const RefCounted &) {}
+    RefCounted &operator=(const RefCounted &)
+    {
+        return *this;
+    }
+};
+
+template <typename T>
+struct Ref
+{
+    T *ptr = nullptr;
+
+    Ref() {}
+    Ref(std::nullptr_t) {}
+    explicit Ref(T *ptr) : ptr(ptr)
+    {
+        retain();
+    }
+    Ref(const Ref &other) : ptr(other.ptr)
+    {
+        retain();
+    }
+    Ref(Ref &&other) noexcept : ptr(other.ptr)
+    {
+        other.ptr = nullptr;
+    }
+    ~Ref()
+    {
+        release();
+    }
+
+    Ref &operator=(Ref other)
+    {
+        std::swap(ptr, other.ptr);
+        return *this;
+    }
+
+    void retain()
+    {
+        if (ptr)
+        {
+            ptr->ref_count.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void release()
+    {
+        if (ptr && ptr->ref_count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            delete ptr;
+        }
+        ptr = nullptr;
+    }
+
+    T *get() const
+    {
+        return ptr;
+    }
+    T *operator->() const
+    {
+        return ptr;
+    }
+    T &operator*() const
+    {
+        return *ptr;
+    }
+    explicit operator bool() const
+    {
+        return ptr != nullptr;
+    }
+    bool operator==(const Ref &other) const
+    {
+        return ptr == other.ptr;
+    }
+    bool operator!=(const Ref &other) const
+    {
+        return ptr != other.ptr;
+    }
+};
+
+template <typename T, typename... Args>
+Ref<T> make_ref(Args &&...args)
+{
+    return Ref<T>(new T(std::forward<Args>(args)...));
+}
+// Objects that gain the same keys in the same order share a Shape, which
+// maps each key to a slot in the object's value array. Shapes reached by
+// adding keys form a tree rooted at the empty shape and are never freed,
+// so property access sites can cache them by address. An object that
+// outgrows MAX_SHAPE_KEYS, loses a key or gains one computed at runtime
+// gets a dictionary shape of its own instead, which is never cached.
+#define MAX_SHAPE_KEYS 64
+
+struct Shape : RefCounted
+{
+    std::vector<std::string> keys;
+    std::unordered_map<std::string, int> indexes;
+    std::unordered_map<std::string, Ref<Shape>> transitions;
+    bool is_dictionary = false;
+
+    int find(const std::string &key) const
+    {
+        auto it = indexes.find(key);
+        return it == indexes.end() ? -1 : it->second;
+    }
+};
+
+Ref<Shape> empty_shape();
+Ref<Shape> shape_with(Ref<Shape> &shape, const std::string &key);
+
+// Inline cache for one property access site. Each entry packs the address
+// of a tree shape, shifted up 16 bits, with the slot that shape keeps the
+// site's key in, so threads sharing the bytecode never see a torn entry.
+// Object literal sites keep the shape their keys build in the first entry.
+// Method call sites also record where to find the function a call falls
+// back to when the receiver has no such method: the load opcode the name
+// resolved to and its operand.
+#define PROPERTY_CACHE_SIZE 4
+
+struct PropertyCache
+{
+    int name;
+    std::atomic<uint64_t> entries[PROPERTY_CACHE_SIZE];
+    uint8_t fallback_op = 0;
+    int fallback = 0;
+
+    PropertyCache(int name) : name(name)
+    {
+        for (auto &entry : entries)
+        {
+            entry.store(0, std::memory_order_relaxed);
+        }
+    }
+    PropertyCache(const PropertyCache &other) : name(other.name), fallback_op(other.fallback_op), fallback(other.fallback)
+    {
+        for (int i = 0; i < PROPERTY_CACHE_SIZE; i++)
+        {
+            entries[i].store(other.entries[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+    }
+    PropertyCache &operator=(const PropertyCache &other)
+    {
+        name = other.name;
+        fallback_op = other.fallback_op;
+        fallback = other.fallback;
+        for (int i = 0; i < PROPERTY_CACHE_SIZE; i++)
+        {
+            entries[i].store(other.entries[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        return *this;
+    }
+};
+
+struct LineStart
+{
+    int offset;
+    int line;
+};
+
+struct ExceptionHandler
+{
+    int start;
+    int end;
+    int handler;
+    int depth;
+    bool binds_error;
+};
+
 struct Chunk
 {
     std::vector<uint8_t> code;
-    std::vector<int> lines;
+    std::vector<LineStart> lines;
     std::vector<Value> constants;
     std::vector<std::string> variables;
     std::vector<std::string> public_variables;
     std::string import_path;
+    std::vector<PropertyCache> property_caches;
+    std::vector<ExceptionHandler> handlers;
 };
 
 struct ClosedVar
@@ -44,48 +226,214 @@ struct ClosedVar
     bool is_local;
 };
 
-struct FunctionObj
+// Everything about a function that is fixed once it is compiled. All
+// closures created from the same function literal share one prototype.
+struct FunctionProto : RefCounted
 {
     std::string name;
-    int arity;
-    int defaults;
+    int arity = 0;
+    int defaults = 0;
     Chunk chunk;
     std::vector<int> instruction_offsets;
     std::vector<ClosedVar> closed_var_indexes;
-    std::vector<std::shared_ptr<Closure>> closed_vars;
-    std::vector<Value> default_values;
-    std::shared_ptr<Value> object;
     std::vector<std::string> params;
     bool is_generator = false;
-    bool generator_init = false;
-    bool generator_done = false;
     bool is_type_generator = false;
+    bool has_capture = false;
     std::string import_path;
 };
 
-struct TypeObj
+struct Traced;
+
+// Links a container into the cycle collector's list as it is created
+void gc_track(Traced *object);
+
+// Containers (lists, objects, types and functions) can hold references
+// to each other, so reference counting alone never frees a cycle of them.
+// Each one is linked into the list of the collector that tracks it and
+// unlinks itself through untrack when freed, whichever code frees it.
+struct Traced : RefCounted
+{
+    ValueType gc_kind;
+    int gc_refs = 0;
+    Traced *gc_prev = nullptr;
+    Traced *gc_next = nullptr;
+    void (*untrack)(Traced *) = nullptr;
+
+    Traced(ValueType kind) : gc_kind(kind)
+    {
+        gc_track(this);
+    }
+    Traced(const Traced &other) : RefCounted(other), gc_kind(other.gc_kind)
+    {
+        gc_track(this);
+    }
+    Traced &operator=(const Traced &)
+    {
+        return *this;
+    }
+    ~Traced()
+    {
+        if (untrack)
+        {
+            untrack(this);
+        }
+    }
+};
+
+struct FunctionObj;
+
+// A suspended generator instance: the stack slots its frame had live at
+// the last yield and the instruction it resumes at
+struct Coroutine
+{
+    std::vector<Value> slots;
+    uint8_t *ip = nullptr;
+    bool running = false;
+    /* The generator a yield from is waiting on */
+    Ref<FunctionObj> delegate;
+};
+
+// A function value: its prototype plus what each closure owns
+struct FunctionObj : Traced
+{
+    Ref<FunctionProto> proto;
+    std::vector<std::shared_ptr<Closure>> closed_vars;
+    std::vector<Value> default_values;
+    bool generator_init = false;
+    bool generator_done = false;
+    std::unique_ptr<Coroutine> coroutine;
+
+    FunctionObj() : Traced(ValueType::Function), proto(make_ref<FunctionProto>()) {}
+    FunctionObj(Ref<FunctionProto> proto) : Traced(ValueType::Function), proto(proto) {}
+};
+
+// Strings never change once created, so values share one buffer and its
+// hash is computed at most once. Strings the generator emits are
+// interned, so equal ones share a buffer and compare by address.
+struct StringObj : RefCounted
+{
+    const std::string value;
+    std::atomic<size_t> hash{0};
+    bool interned = false;
+
+    StringObj() {}
+    StringObj(std::string value) : value(std::move(value)) {}
+
+    size_t get_hash()
+    {
+        size_t cached = hash.load(std::memory_order_relaxed);
+        if (!cached)
+        {
+            // Never 0, which marks the hash as not computed yet
+            cached = std::hash<std::string>()(value) | 1;
+            hash.store(cached, std::memory_order_relaxed);
+        }
+        return cached;
+    }
+};
+
+struct ListObj : Traced, std::vector<Value>
+{
+    ListObj() : Traced(ValueType::List) {}
+    using std::vector<Value>::operator=;
+};
+
+struct TypeObj : Traced
 {
     std::string name;
     std::unordered_map<std::string, Value> types;
     std::unordered_map<std::string, Value> defaults;
+
+    TypeObj() : Traced(ValueType::Type) {}
 };
 
-struct ObjectObj
+// An object's properties: its shape plus one value per slot. It reads
+// like the map it replaced, so operator[] adds a missing key and
+// iteration yields entries with first and second, in insertion order.
+struct PropertyMap
 {
-    std::shared_ptr<TypeObj> type;
-    std::unordered_map<std::string, Value> values;
+    Ref<Shape> shape;
+    std::vector<Value> slots;
+
+    struct Entry
+    {
+        const std::string &first;
+        Value &second;
+    };
+
+    struct iterator
+    {
+        PropertyMap *map;
+        int index;
+        std::optional<Entry> entry;
+
+        iterator(PropertyMap *map, int index) : map(map), index(index) {}
+
+        Entry &operator*();
+        Entry *operator->()
+        {
+            return &**this;
+        }
+        iterator &operator++()
+        {
+            index++;
+            return *this;
+        }
+        bool operator!=(const iterator &other) const
+        {
+            return index != other.index;
+        }
+    };
+
+    PropertyMap() : shape(empty_shape()) {}
+
+    Value &operator[](const std::string &key);
+    // Adds a key computed at runtime, which seldom recurs, by moving to a
+    // dictionary shape rather than growing the shape tree for good
+    Value &insert_computed(const std::string &key);
+    void erase(const std::string &key);
+
+    int find(const std::string &key) const
+    {
+        return shape->find(key);
+    }
+    size_t count(const std::string &key) const
+    {
+        return shape->find(key) >= 0;
+    }
+    size_t size() const
+    {
+        return shape->keys.size();
+    }
+    iterator begin()
+    {
+        return {this, 0};
+    }
+    iterator end()
+    {
+        return {this, (int)size()};
+    }
+};
+
+struct ObjectObj : Traced
+{
+    Ref<TypeObj> type;
+    PropertyMap values;
     std::vector<std::string> keys;
     std::string type_name;
+
+    ObjectObj() : Traced(ValueType::Object) {}
 };
 
-struct PointerObj
+struct PointerObj : RefCounted
 {
     void *value;
 };
 
 typedef Value (*NativeFunction)(std::vector<Value> &args);
 
-struct NativeFunctionObj
+struct NativeFunctionObj : RefCounted
 {
     std::string name;
     NativeFunction function = nullptr;
@@ -93,10 +441,12 @@ struct NativeFunctionObj
 
 struct Meta
 {
-    bool unpack = false;
-    bool packer = false;
-    bool is_const = false;
-    bool temp_non_const = false;
+    bool unpack : 1;
+    bool packer : 1;
+    bool is_const : 1;
+    bool temp_non_const : 1;
+
+    Meta() : unpack(false), packer(false), is_const(false), temp_non_const(false) {}
 };
 
 struct ValueHooks
@@ -107,107 +457,236 @@ struct ValueHooks
     std::string onAccessHookName;
 };
 
-static long long int v_counter = 0;
+// Each hook set counts the values carrying its index
+void retain_hooks(uint32_t hooks_id);
+void release_hooks(uint32_t hooks_id);
+
+// 16 bytes: the type tag, meta flags and hook index share one word and the
+// payload (a double, a bool or a pointer to a refcounted heap object)
+// lives in the other
 struct Value
 {
     ValueType type;
     Meta meta;
-    ValueHooks hooks;
-    long long int id;
-    std::variant<
-        double,
-        std::string,
-        bool,
-        std::shared_ptr<std::vector<Value>>,
-        std::shared_ptr<FunctionObj>,
-        std::shared_ptr<TypeObj>,
-        std::shared_ptr<ObjectObj>,
-        std::shared_ptr<NativeFunctionObj>,
-        std::shared_ptr<PointerObj>>
-        value;
-
-    Value() : type(ValueType::None)
-    {
-        id = ++v_counter;
-    }
+    uint32_t hooks_id = 0;
+    union Payload
+    {
+        uint64_t bits;
+        double number;
+        bool boolean;
+        RefCounted *object;
+        Ref<StringObj> string;
+        Ref<ListObj> list;
+        Ref<TypeObj> type_obj;
+        Ref<ObjectObj> object_obj;
+        Ref<FunctionObj> function;
+        Ref<NativeFunctionObj> native;
+        Ref<PointerObj> pointer;
+
+        Payload() : bits(0) {}
+        ~Payload() {}
+    } as;
+
+    Value() : type(ValueType::None) {}
     Value(ValueType type) : type(type)
     {
-        id = ++v_counter;
         switch (type)
         {
-        case ValueType::Number:
-            value = 0.0f;
-            break;
         case ValueType::String:
-            value = "";
+            adopt(new StringObj());
             break;
-        case ValueType::Boolean:
-            value = false;
+        case ValueType::List:
+            adopt(new ListObj());
+            break;
+        case ValueType::Type:
+            adopt(new TypeObj());
+            break;
+        case ValueType::Object:
+            adopt(new ObjectObj());
+            break;
+        case ValueType::Function:
+            adopt(new FunctionObj());
+            break;
+        case ValueType::Native:
+            adopt(new NativeFunctionObj());
+            break;
+        case ValueType::Pointer:
+            adopt(new PointerObj());
+            break;
+        default:
+            break;
+        }
+    }
+    Value(const Value &other) : type(other.type), meta(other.meta), hooks_id(other.hooks_id)
+    {
+        as.bits = other.as.bits;
+        retain();
+        if (hooks_id)
+        {
+            retain_hooks(hooks_id);
+        }
+    }
+    Value(Value &&other) noexcept : type(other.type), meta(other.meta), hooks_id(other.hooks_id)
+    {
+        as.bits = other.as.bits;
+        other.type = ValueType::None;
+        other.hooks_id = 0;
+    }
+    ~Value()
+    {
+        release();
+        if (hooks_id)
+        {
+            release_hooks(hooks_id);
+        }
+    }
+
+    Value &operator=(const Value &other)
+    {
+        other.retain();
+        release();
+        if (other.hooks_id)
+        {
+            retain_hooks(other.hooks_id);
+        }
+        if (hooks_id)
+        {
+            release_hooks(hooks_id);
+        }
+        type = other.type;
+        meta = other.meta;
+        hooks_id = other.hooks_id;
+        as.bits = other.as.bits;
+        return *this;
+    }
+    Value &operator=(Value &&other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            if (hooks_id)
+            {
+                release_hooks(hooks_id);
+            }
+            type = other.type;
+            meta = other.meta;
+            hooks_id = other.hooks_id;
+            as.bits = other.as.bits;
+            other.type = ValueType::None;
+            other.hooks_id = 0;
+        }
+        return *this;
+    }
+
+    bool is_heap() const
+    {
+        return type != ValueType::Number && type != ValueType::Boolean && type != ValueType::None && type != ValueType::Range;
+    }
+
+    void adopt(RefCounted *object)
+    {
+        object->ref_count.store(1, std::memory_order_relaxed);
+        as.object = object;
+    }
+
+    void retain() const
+    {
+        if (is_heap())
+        {
+            as.object->ref_count.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void release()
+    {
+        if (is_heap() && as.object->ref_count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            destroy();
+        }
+    }
+
+    void destroy()
+    {
+        switch (type)
+        {
+        case ValueType::String:
+            delete static_cast<StringObj *>(as.object);
             break;
         case ValueType::List:
-            value = std::make_shared<std::vector<Value>>();
+            delete static_cast<ListObj *>(as.object);
             break;
         case ValueType::Type:
-            value = std::make_shared<TypeObj>();
+            delete static_cast<TypeObj *>(as.object);
             break;
         case ValueType::Object:
-            value = std::make_shared<ObjectObj>();
+            delete static_cast<ObjectObj *>(as.object);
             break;
         case ValueType::Function:
-            value = std::make_shared<FunctionObj>();
+            delete static_cast<FunctionObj *>(as.object);
             break;
         case ValueType::Native:
-            value = std::make_shared<NativeFunctionObj>();
+            delete static_cast<NativeFunctionObj *>(as.object);
             break;
         case ValueType::Pointer:
-            value = std::make_shared<PointerObj>();
+            delete static_cast<PointerObj *>(as.object);
             break;
         default:
             break;
         }
     }
 
+    // Identity is the heap address for reference types and the payload
+    // itself for numbers, booleans and None
+    long long int get_id()
+    {
+        if (is_heap())
+        {
+            return (long long int)(uintptr_t)as.object;
+        }
+        return (long long int)(as.bits ^ ((uint64_t)type << 56));
+    }
+
     double &get_number()
     {
-        return std::get<double>(this->value);
+        return as.number;
     }
-    std::string &get_string()
+    const std::string &get_string()
     {
-        return std::get<std::string>(this->value);
+        return as.string->value;
     }
     bool &get_boolean()
     {
-        return std::get<bool>(this->value);
+        return as.boolean;
     }
 
-    std::shared_ptr<std::vector<Value>> &get_list()
+    Ref<ListObj> &get_list()
     {
-        return std::get<std::shared_ptr<std::vector<Value>>>(this->value);
+        return as.list;
     }
 
-    std::shared_ptr<TypeObj> &get_type()
+    Ref<TypeObj> &get_type()
     {
-        return std::get<std::shared_ptr<TypeObj>>(this->value);
+        return as.type_obj;
     }
 
-    std::shared_ptr<ObjectObj> &get_object()
+    Ref<ObjectObj> &get_object()
     {
-        return std::get<std::shared_ptr<ObjectObj>>(this->value);
+        return as.object_obj;
     }
 
-    std::shared_ptr<FunctionObj> &get_function()
+    Ref<FunctionObj> &get_function()
     {
-        return std::get<std::shared_ptr<FunctionObj>>(this->value);
+        return as.function;
     }
 
-    std::shared_ptr<NativeFunctionObj> &get_native()
+    Ref<NativeFunctionObj> &get_native()
     {
-        return std::get<std::shared_ptr<NativeFunctionObj>>(this->value);
+        return as.native;
     }
 
-    std::shared_ptr<PointerObj> &get_pointer()
+    Ref<PointerObj> &get_pointer()
     {
-        return std::get<std::shared_ptr<PointerObj>>(this->value);
+        return as.pointer;
     }
 
     bool is_number()
@@ -278,6 +757,7 @@ struct Value
             return "Unknown";
         }
     }
+
     std::string value_repr()
     {
         return toString(*this);
@@ -353,7 +833,7 @@ std::string toString(Value value)
     }
     case ValueType::Function:
     {
-        return "Function: " + value.get_function()->name;
+        return "Function: " + value.get_function()->proto->name;
     }
     case ValueType::Native:
     {
@@ -385,6 +865,113 @@ struct Closure
     Value *initial_location;
 };
 
+static std::mutex shapes_mutex;
+
+Ref<Shape> empty_shape()
+{
+    static Ref<Shape> root = make_ref<Shape>();
+    return root;
+}
+
+static Ref<Shape> dictionary_with(Ref<Shape> &shape, const std::string &key)
+{
+    // A dictionary shape owned by this object alone can grow in place
+    if (shape->is_dictionary && shape->ref_count.load(std::memory_order_acquire) == 1)
+    {
+        shape->indexes[key] = shape->keys.size();
+        shape->keys.push_back(key);
+        return shape;
+    }
+    Ref<Shape> dictionary = make_ref<Shape>();
+    dictionary->is_dictionary = true;
+    dictionary->keys = shape->keys;
+    dictionary->indexes = shape->indexes;
+    dictionary->indexes[key] = dictionary->keys.size();
+    dictionary->keys.push_back(key);
+    return dictionary;
+}
+
+Ref<Shape> shape_with(Ref<Shape> &shape, const std::string &key)
+{
+    if (shape->is_dictionary || shape->keys.size() >= MAX_SHAPE_KEYS)
+    {
+        return dictionary_with(shape, key);
+    }
+
+    std::lock_guard<std::mutex> lock(shapes_mutex);
+    auto it = shape->transitions.find(key);
+    if (it != shape->transitions.end())
+    {
+        return it->second;
+    }
+
+    Ref<Shape> next = make_ref<Shape>();
+    next->keys = shape->keys;
+    next->indexes = shape->indexes;
+    next->indexes[key] = next->keys.size();
+    next->keys.push_back(key);
+    shape->transitions[key] = next;
+    return next;
+}
+
+Value &PropertyMap::operator[](const std::string &key)
+{
+    int slot = shape->find(key);
+    if (slot < 0)
+    {
+        shape = shape_with(shape, key);
+        slots.emplace_back();
+        slot = slots.size() - 1;
+    }
+    return slots[slot];
+}
+
+Value &PropertyMap::insert_computed(const std::string &key)
+{
+    int slot = shape->find(key);
+    if (slot < 0)
+    {
+        shape = dictionary_with(shape, key);
+        slots.emplace_back();
+        slot = slots.size() - 1;
+    }
+    return slots[slot];
+}
+
+void PropertyMap::erase(const std::string &key)
+{
+    int slot = shape->find(key);
+    if (slot < 0)
+    {
+        return;
+    }
+
+    Ref<Shape> dictionary = make_ref<Shape>();
+    dictionary->is_dictionary = true;
+    for (int i = 0; i < shape->keys.size(); i++)
+    {
+        if (i != slot)
+        {
+            dictionary->indexes[shape->keys[i]] = dictionary->keys.size();
+            dictionary->keys.push_back(shape->keys[i]);
+        }
+    }
+    slots.erase(slots.begin() + slot);
+    shape = dictionary;
+}
+
+PropertyMap::Entry &PropertyMap::iterator::operator*()
+{
+    entry.emplace(Entry{map->shape->keys[index], map->slots[index]});
+    return *entry;
+}
+
+// Containers a module allocates are left out of the VM's cycle
+// collector and freed by reference counting alone
+void gc_track(Traced *object)
+{
+}
+
 Value new_val()
 {
     return Value(ValueType::None);
@@ -393,21 +980,22 @@ Value new_val()
 Value number_val(double value)
 {
     Value val(ValueType::Number);
-    val.value = value;
+    val.as.number = value;
     return val;
 }
 
 Value string_val(std::string value)
 {
-    Value val(ValueType::String);
-    val.value = value;
+    Value val;
+    val.type = ValueType::String;
+    val.adopt(new StringObj(std::move(value)));
     return val;
 }
 
 Value boolean_val(bool value)
 {
     Value val(ValueType::Boolean);
-    val.value = value;
+    val.as.boolean = value;
     return val;
 }
 
@@ -436,6 +1024,14 @@ Value function_val()
     return val;
 }
 
+Value function_val(Ref<FunctionProto> proto)
+{
+    Value val;
+    val.type = ValueType::Function;
+    val.adopt(new FunctionObj(proto));
+    return val;
+}
+
 Value native_val()
 {
     Value val(ValueType::Native);
@@ -463,17 +1059,26 @@ void error(std::string message)
 struct CallFrame
 {
     std::string name;
-    std::shared_ptr<FunctionObj> function;
+    Ref<FunctionObj> function;
     uint8_t *ip;
     int frame_start;
     int sp;
     int instruction_index;
-    std::vector<Value> gen_stack;
+    /* The generator the caller resumed, for generator frames */
+    Ref<FunctionObj> resumed;
+};
+// Globals indexed by the slot global_slot() gave their name. An empty
+// name marks a slot this table does not define.
+struct GlobalTable
+{
+    std::vector<Value> values;
+    std::vector<std::string> names;
 };
+
 struct CachedImport
 {
     Value import_object;
-    std::unordered_map<std::string, Value> import_globals;
+    GlobalTable import_globals;
 };
 struct VM
 {
@@ -481,19 +1086,19 @@ struct VM
     Value *sp;
     /* Possibly change to array with specified MAX_DEPTH */
     std::vector<CallFrame> frames;
-    std::unordered_map<std::string, std::shared_ptr<CallFrame>> gen_frames;
     std::vector<Value *> objects;
-    std::unordered_map<std::string, Value> globals;
+    GlobalTable globals;
     int status = 0;
-    std::vector<std::shared_ptr<Closure>> closed_values;
-    int coro_count = 0;
-    std::vector<int> try_instructions;
+    std::vector<std::shared_ptr<Closure>> open_closures;
     int call_stack_limit = 3000;
     std::unordered_map<std::string, CachedImport> import_cache;
+    int return_depth = 0;
+    Value callback_error;
 
     VM()
     {
         stack.reserve(100000);
+        frames.reserve(call_stack_limit + 16);
     }
 };
 
@@ -508,6 +1113,29 @@ Value error_object(std::string message, std::string error_type = "GenericError")
     return error_obj;
 }
 
+int get_line(Chunk &chunk, int offset)
+{
+    int low = 0;
+    int high = chunk.lines.size() - 1;
+    int line = 0;
+
+    while (low <= high)
+    {
+        int mid = (low + high) / 2;
+        if (chunk.lines[mid].offset <= offset)
+        {
+            line = chunk.lines[mid].line;
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid - 1;
+        }
+    }
+
+    return line;
+}
+
 static void runtimeError(VM &vm, std::string message, ...)
 {
 
@@ -525,14 +1153,14 @@ static void runtimeError(VM &vm, std::string message, ...)
     {
         CallFrame *frame = &vm.frames[i];
         auto &function = frame->function;
-        size_t instruction = frame->ip - function->chunk.code.data() - 1;
-        if (function->name == "error")
+        size_t instruction = frame->ip - function->proto->chunk.code.data() - 1;
+        if (function->proto->name == "error")
         {
             continue;
         }
         fprintf(stderr, "[line %d] in ",
-                function->chunk.lines[instruction]);
-        if (function->name == "")
+                get_line(function->proto->chunk, instruction));
+        if (function->proto->name == "")
         {
             std::string name = frame->name;
             if (name == "")
@@ -543,7 +1171,7 @@ static void runtimeError(VM &vm, std::string message, ...)
         }
         else
         {
-            fprintf(stderr, "%s()\n", function->name.c_str());
+            fprintf(stderr, "%s()\n", function->proto->name.c_str());
         }
     }
 }
\ No newline at end of file
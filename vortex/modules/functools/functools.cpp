@@ -26,6 +26,6 @@ extern "C" Value rename_(std::vector<Value> &args)
     }
 
     Value new_func = function;
-    new_func.get_function()->name = name.get_string();
+    new_func.get_function()->proto->name = name.get_string();
     return new_func;
 }
\ No newline at end of file
@@ -82,7 +82,7 @@ std::string valueToString(Value value, bool quote_strings = false)
     }
     case ValueType::Function:
     {
-        return "Function: " + value.get_function()->name;
+        return "Function: " + value.get_function()->proto->name;
     }
     case ValueType::Native:
     {
@@ -2427,29 +2427,15 @@ void mainLoopWrapper(void *arg)
     // Cast the argument back to the shared pointer type
     auto func = *static_cast<std::shared_ptr<Value> *>(arg);
 
-    // Your lambda function
-    VM func_vm;
-    std::shared_ptr<FunctionObj> main = std::make_shared<FunctionObj>();
-    main->name = "";
-    main->arity = 0;
-    main->chunk = Chunk();
-    CallFrame main_frame;
-    main_frame.function = main;
-    main_frame.sp = 0;
-    main_frame.ip = main->chunk.code.data();
-    main_frame.frame_start = 0;
-    func_vm.frames.push_back(main_frame);
-
-    add_constant(main->chunk, *func);
-    add_opcode(main->chunk, OP_LOAD_CONST, 0, 0);
-    add_opcode(main->chunk, OP_CALL, 0, 0);
-
-    add_code(main->chunk, OP_EXIT, 0);
-
-    auto offsets = instruction_offsets(main_frame.function->chunk);
-    main_frame.function->instruction_offsets = offsets;
-
-    evaluate(func_vm);
+    // One VM serves every frame of the loop
+    static VM func_vm;
+    std::vector<Value> args;
+    Value result = vm_call(func_vm, *func, args);
+
+    if (result.is_object() && result.get_object()->type_name == "Error")
+    {
+        std::cerr << result.get_object()->values["type"].get_string() << ": " << result.get_object()->values["message"].get_string() << std::endl;
+    }
 }
 
 extern "C" Value wasm_main_loop(std::vector<Value> &args)
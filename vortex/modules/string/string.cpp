@@ -22,7 +22,7 @@ extern "C" Value split(std::vector<Value> &args)
         return error_object("Function 'split' expects args 'text', 'delimiter' to be strings");
     }
 
-    std::string &str = text.get_string();
+    const std::string &str = text.get_string();
     std::string delim = delimiter.get_string();
 
     if (delim == "")
@@ -67,17 +67,17 @@ extern "C" Value trim(std::vector<Value> &args)
         return error_object("Function 'chars' expects argument 'text' to be a string");
     }
 
-    Value new_string = string_val(text.get_string());
+    std::string new_string = text.get_string();
 
-    new_string.get_string().erase(new_string.get_string().begin(), std::find_if(new_string.get_string().begin(), new_string.get_string().end(), [](unsigned char ch)
-                                                                                { return !std::isspace(ch); }));
+    new_string.erase(new_string.begin(), std::find_if(new_string.begin(), new_string.end(), [](unsigned char ch)
+                                                      { return !std::isspace(ch); }));
 
-    new_string.get_string().erase(std::find_if(new_string.get_string().rbegin(), new_string.get_string().rend(), [](unsigned char ch)
-                                               { return !std::isspace(ch); })
-                                      .base(),
-                                  new_string.get_string().end());
+    new_string.erase(std::find_if(new_string.rbegin(), new_string.rend(), [](unsigned char ch)
+                                  { return !std::isspace(ch); })
+                         .base(),
+                     new_string.end());
 
-    return new_string;
+    return string_val(std::move(new_string));
 }
 
 extern "C" Value chars(std::vector<Value> &args)
@@ -123,23 +123,22 @@ extern "C" Value replaceAll(std::vector<Value> &args)
         return error_object("Function 'replaceAll' expects " + std::to_string(num_required_args) + " string argument(s)");
     }
 
-    std::string &from = _from.get_string();
-    std::string &to = _to.get_string();
-    std::string &str = _str.get_string();
-
-    Value new_str = string_val(str);
+    const std::string &from = _from.get_string();
+    const std::string &to = _to.get_string();
+    const std::string &str = _str.get_string();
 
     if (from.empty())
     {
-        return new_str;
+        return _str;
     }
 
+    std::string new_str = str;
     size_t start_pos = 0;
-    while ((start_pos = new_str.get_string().find(from, start_pos)) != std::string::npos)
+    while ((start_pos = new_str.find(from, start_pos)) != std::string::npos)
     {
-        new_str.get_string().replace(start_pos, from.length(), to);
+        new_str.replace(start_pos, from.length(), to);
         start_pos += to.length();
     }
 
-    return new_str;
+    return string_val(std::move(new_str));
 }
\ No newline at end of file
@@ -78,10 +78,15 @@ extern "C" Value __globals__(std::vector<Value> &args)
 
     Value object = object_val();
 
-    for (auto value : _vm->globals)
+    for (int slot = 0; slot < _vm->globals.names.size(); slot++)
     {
-        object.get_object()->values[value.first] = value.second;
-        object.get_object()->keys.push_back(value.first);
+        std::string &name = _vm->globals.names[slot];
+        if (name.empty())
+        {
+            continue;
+        }
+        object.get_object()->values[name] = _vm->globals.values[slot];
+        object.get_object()->keys.push_back(name);
     }
 
     return object;
@@ -124,14 +129,14 @@ extern "C" Value __frame__(std::vector<Value> &args)
 
     CallFrame frame = _vm->frames[_vm->frames.size() - _depth];
 
-    size_t instr = frame.ip - frame.function->chunk.code.data() - 1;
+    size_t instr = frame.ip - frame.function->proto->chunk.code.data() - 1;
 
     Value obj = object_val();
 
-    obj.get_object()->values["name"] = string_val(frame.function->name);
+    obj.get_object()->values["name"] = string_val(frame.function->proto->name);
     obj.get_object()->values["level"] = number_val(_vm->frames.size() - _depth);
-    obj.get_object()->values["line"] = number_val(frame.function->chunk.lines[instr]);
-    obj.get_object()->values["path"] = string_val(frame.function->name == "" ? frame.name : frame.function->import_path);
+    obj.get_object()->values["line"] = number_val(get_line(frame.function->proto->chunk, instr));
+    obj.get_object()->values["path"] = string_val(frame.function->proto->name == "" ? frame.name : frame.function->proto->import_path);
     obj.get_object()->values["id"] = number_val(reinterpret_cast<intptr_t>(frame.function.get()));
     obj.get_object()->keys = {"name", "level", "line", "path", "id"};
     return obj;
@@ -69,6 +69,16 @@ static context_ptr on_tls_init()
     return ctx;
 }
 
+// Handlers run from the event loop, so there is no caller to pass an
+// error on to
+static void report_callback_error(Value &result)
+{
+    if (result.is_object() && result.get_object()->type_name == "Error")
+    {
+        std::cerr << result.get_object()->values["type"].get_string() << ": " << result.get_object()->values["message"].get_string() << std::endl;
+    }
+}
+
 extern "C" Value _client_init(std::vector<Value> &args)
 {
     int num_required_args = 0;
@@ -204,39 +214,18 @@ extern "C" Value _client_on_message(std::vector<Value> &args)
         return error_object("Function 'on_message' expects argument 'client' to be a pointer");
     }
 
-    if (func.get_function()->arity != 1)
+    if (func.get_function()->proto->arity != 1)
     {
         return error_object("Function 'on_message' expects argument 'function' to be a Function with 1 parameter");
     }
 
     client *c = (client *)client_ptr.get_pointer()->value;
 
-    auto on_message_func = [func](websocketpp::connection_hdl hdl, message_ptr msg)
+    auto on_message_func = [func, func_vm = std::make_shared<VM>()](websocketpp::connection_hdl hdl, message_ptr msg)
     {
-        VM func_vm;
-        std::shared_ptr<FunctionObj> main = std::make_shared<FunctionObj>();
-        main->name = "";
-        main->arity = 0;
-        main->chunk = Chunk();
-        CallFrame main_frame;
-        main_frame.function = main;
-        main_frame.sp = 0;
-        main_frame.ip = main->chunk.code.data();
-        main_frame.frame_start = 0;
-        func_vm.frames.push_back(main_frame);
-
-        add_constant(main->chunk, func);
-        add_constant(main->chunk, string_val(msg->get_payload()));
-        add_opcode(main->chunk, OP_LOAD_CONST, 1, 0);
-        add_opcode(main->chunk, OP_LOAD_CONST, 0, 0);
-        add_opcode(main->chunk, OP_CALL, 1, 0);
-
-        add_code(main->chunk, OP_EXIT, 0);
-
-        auto offsets = instruction_offsets(main_frame.function->chunk);
-        main_frame.function->instruction_offsets = offsets;
-
-        evaluate(func_vm);
+        std::vector<Value> args = {string_val(msg->get_payload())};
+        Value result = vm_call(*func_vm, func, args);
+        report_callback_error(result);
     };
 
     c->set_message_handler(on_message_func);
@@ -266,37 +255,18 @@ extern "C" Value _client_on_open(std::vector<Value> &args)
         return error_object("Function 'on_open' expects argument 'client' to be a pointer");
     }
 
-    if (func.get_function()->arity != 0)
+    if (func.get_function()->proto->arity != 0)
     {
         return error_object("Function 'on_open' expects argument 'function' to be a Function with 0 parameters");
     }
 
     client *c = (client *)client_ptr.get_pointer()->value;
 
-    auto on_open_func = [func](websocketpp::connection_hdl hdl)
+    auto on_open_func = [func, func_vm = std::make_shared<VM>()](websocketpp::connection_hdl hdl)
     {
-        VM func_vm;
-        std::shared_ptr<FunctionObj> main = std::make_shared<FunctionObj>();
-        main->name = "";
-        main->arity = 0;
-        main->chunk = Chunk();
-        CallFrame main_frame;
-        main_frame.function = main;
-        main_frame.sp = 0;
-        main_frame.ip = main->chunk.code.data();
-        main_frame.frame_start = 0;
-        func_vm.frames.push_back(main_frame);
-
-        add_constant(main->chunk, func);
-        add_opcode(main->chunk, OP_LOAD_CONST, 0, 0);
-        add_opcode(main->chunk, OP_CALL, 0, 0);
-
-        add_code(main->chunk, OP_EXIT, 0);
-
-        auto offsets = instruction_offsets(main_frame.function->chunk);
-        main_frame.function->instruction_offsets = offsets;
-
-        evaluate(func_vm);
+        std::vector<Value> args = {};
+        Value result = vm_call(*func_vm, func, args);
+        report_callback_error(result);
     };
 
     c->set_open_handler(on_open_func);
@@ -326,14 +296,14 @@ extern "C" Value _client_on_close(std::vector<Value> &args)
         return error_object("Function 'on_close' expects argument 'client' to be a pointer");
     }
 
-    if (func.get_function()->arity != 1)
+    if (func.get_function()->proto->arity != 1)
     {
         return error_object("Function 'on_close' expects argument 'function' to be a Function with 1 parameters");
     }
 
     client *c = (client *)client_ptr.get_pointer()->value;
 
-    auto on_close_func = [c, func](websocketpp::connection_hdl hdl)
+    auto on_close_func = [c, func, func_vm = std::make_shared<VM>()](websocketpp::connection_hdl hdl)
     {
         websocketpp::close::status::value status = c->get_con_from_hdl(hdl)->get_local_close_code();
         std::string reason = c->get_con_from_hdl(hdl)->get_local_close_reason();
@@ -343,30 +313,9 @@ extern "C" Value _client_on_close(std::vector<Value> &args)
         close_object.get_object()->values["status"] = number_val(status);
         close_object.get_object()->values["reason"] = string_val(reason);
 
-        VM func_vm;
-        std::shared_ptr<FunctionObj> main = std::make_shared<FunctionObj>();
-        main->name = "";
-        main->arity = 0;
-        main->chunk = Chunk();
-        CallFrame main_frame;
-        main_frame.function = main;
-        main_frame.sp = 0;
-        main_frame.ip = main->chunk.code.data();
-        main_frame.frame_start = 0;
-        func_vm.frames.push_back(main_frame);
-
-        add_constant(main->chunk, func);
-        add_constant(main->chunk, close_object);
-        add_opcode(main->chunk, OP_LOAD_CONST, 1, 0);
-        add_opcode(main->chunk, OP_LOAD_CONST, 0, 0);
-        add_opcode(main->chunk, OP_CALL, 1, 0);
-
-        add_code(main->chunk, OP_EXIT, 0);
-
-        auto offsets = instruction_offsets(main_frame.function->chunk);
-        main_frame.function->instruction_offsets = offsets;
-
-        evaluate(func_vm);
+        std::vector<Value> args = {close_object};
+        Value result = vm_call(*func_vm, func, args);
+        report_callback_error(result);
     };
 
     c->set_close_handler(on_close_func);
@@ -396,14 +345,14 @@ extern "C" Value _client_on_fail(std::vector<Value> &args)
         return error_object("Function 'on_fail' expects argument 'client' to be a pointer");
     }
 
-    if (func.get_function()->arity != 1)
+    if (func.get_function()->proto->arity != 1)
     {
         return error_object("Function 'on_fail' expects argument 'function' to be a Function with 1 parameter");
     }
 
     client *c = (client *)client_ptr.get_pointer()->value;
 
-    auto on_fail_func = [c, func](websocketpp::connection_hdl hdl)
+    auto on_fail_func = [c, func, func_vm = std::make_shared<VM>()](websocketpp::connection_hdl hdl)
     {
         websocketpp::close::status::value status = c->get_con_from_hdl(hdl)->get_local_close_code();
         std::string reason = c->get_con_from_hdl(hdl)->get_local_close_reason();
@@ -413,30 +362,9 @@ extern "C" Value _client_on_fail(std::vector<Value> &args)
         close_object.get_object()->values["status"] = number_val(status);
         close_object.get_object()->values["reason"] = string_val(reason);
 
-        VM func_vm;
-        std::shared_ptr<FunctionObj> main = std::make_shared<FunctionObj>();
-        main->name = "";
-        main->arity = 0;
-        main->chunk = Chunk();
-        CallFrame main_frame;
-        main_frame.function = main;
-        main_frame.sp = 0;
-        main_frame.ip = main->chunk.code.data();
-        main_frame.frame_start = 0;
-        func_vm.frames.push_back(main_frame);
-
-        add_constant(main->chunk, func);
-        add_constant(main->chunk, close_object);
-        add_opcode(main->chunk, OP_LOAD_CONST, 1, 0);
-        add_opcode(main->chunk, OP_LOAD_CONST, 0, 0);
-        add_opcode(main->chunk, OP_CALL, 1, 0);
-
-        add_code(main->chunk, OP_EXIT, 0);
-
-        auto offsets = instruction_offsets(main_frame.function->chunk);
-        main_frame.function->instruction_offsets = offsets;
-
-        evaluate(func_vm);
+        std::vector<Value> args = {close_object};
+        Value result = vm_call(*func_vm, func, args);
+        report_callback_error(result);
     };
 
     c->set_fail_handler(on_fail_func);
@@ -890,7 +818,7 @@ extern "C" Value _server_on_validate(std::vector<Value> &args)
         return error_object("Function 'on_validate' expects argument 'function' to be a Function");
     }
 
-    if (func.get_function()->arity != 2)
+    if (func.get_function()->proto->arity != 2)
     {
         return error_object("Function 'on_validate' expects argument 'function' to be a Function with 2 parameters");
     }
@@ -909,7 +837,7 @@ extern "C" Value _server_on_validate(std::vector<Value> &args)
 
     server *s = (server *)_server->values["server_ptr"].get_pointer()->value;
 
-    auto on_validate_func = [func, s](websocketpp::connection_hdl hdl)
+    auto on_validate_func = [func, s, func_vm = std::make_shared<VM>()](websocketpp::connection_hdl hdl)
     {
         server::connection_ptr con = s->get_con_from_hdl(hdl);
         auto &req = con->get_request();
@@ -934,46 +862,17 @@ extern "C" Value _server_on_validate(std::vector<Value> &args)
         data_obj.get_object()->values["id"] = number_val(data.sessionId);
         data_obj.get_object()->values["name"] = string_val(data.name);
 
-        VM func_vm;
-        std::shared_ptr<FunctionObj> main = std::make_shared<FunctionObj>();
-        main->name = "";
-        main->arity = 0;
-        main->chunk = Chunk();
-        CallFrame main_frame;
-        main_frame.function = main;
-        main_frame.sp = 0;
-        main_frame.ip = main->chunk.code.data();
-        main_frame.frame_start = 0;
-        func_vm.frames.push_back(main_frame);
-
-        add_constant(main->chunk, func);
-        add_constant(main->chunk, data_obj);
-        add_constant(main->chunk, header_object);
-        add_opcode(main->chunk, OP_LOAD_CONST, 2, 0);
-        add_opcode(main->chunk, OP_LOAD_CONST, 1, 0);
-        add_opcode(main->chunk, OP_LOAD_CONST, 0, 0);
-        add_opcode(main->chunk, OP_CALL, 2, 0);
-
-        add_code(main->chunk, OP_EXIT, 0);
-
-        auto offsets = instruction_offsets(main_frame.function->chunk);
-        main_frame.function->instruction_offsets = offsets;
-
-        evaluate(func_vm);
-
-        if (func_vm.stack.size() == 0)
-        {
-            m_servers[s].erase(hdl);
-            return false;
-        }
+        std::vector<Value> args = {data_obj, header_object};
+        Value result = vm_call(*func_vm, func, args);
+        report_callback_error(result);
 
-        if (!func_vm.stack.back().is_boolean())
+        if (!result.is_boolean())
         {
             m_servers[s].erase(hdl);
             return false;
         }
 
-        bool res = func_vm.stack.back().get_boolean();
+        bool res = result.get_boolean();
 
         if (!res)
         {
@@ -1010,7 +909,7 @@ extern "C" Value _server_on_open(std::vector<Value> &args)
         return error_object("Function 'on_open' expects argument 'function' to be a Function");
     }
 
-    if (func.get_function()->arity != 1)
+    if (func.get_function()->proto->arity != 1)
     {
         return error_object("Function 'on_open' expects argument 'function' to be a Function with 1 parameter");
     }
@@ -1029,7 +928,7 @@ extern "C" Value _server_on_open(std::vector<Value> &args)
 
     server *s = (server *)_server->values["server_ptr"].get_pointer()->value;
 
-    auto on_open_func = [func, s](websocketpp::connection_hdl hdl)
+    auto on_open_func = [func, s, func_vm = std::make_shared<VM>()](websocketpp::connection_hdl hdl)
     {
         connection_data data;
 
@@ -1047,30 +946,9 @@ extern "C" Value _server_on_open(std::vector<Value> &args)
         data_obj.get_object()->values["id"] = number_val(data.sessionId);
         data_obj.get_object()->values["name"] = string_val(data.name);
 
-        VM func_vm;
-        std::shared_ptr<FunctionObj> main = std::make_shared<FunctionObj>();
-        main->name = "";
-        main->arity = 0;
-        main->chunk = Chunk();
-        CallFrame main_frame;
-        main_frame.function = main;
-        main_frame.sp = 0;
-        main_frame.ip = main->chunk.code.data();
-        main_frame.frame_start = 0;
-        func_vm.frames.push_back(main_frame);
-
-        add_constant(main->chunk, func);
-        add_constant(main->chunk, data_obj);
-        add_opcode(main->chunk, OP_LOAD_CONST, 1, 0);
-        add_opcode(main->chunk, OP_LOAD_CONST, 0, 0);
-        add_opcode(main->chunk, OP_CALL, 1, 0);
-
-        add_code(main->chunk, OP_EXIT, 0);
-
-        auto offsets = instruction_offsets(main_frame.function->chunk);
-        main_frame.function->instruction_offsets = offsets;
-
-        evaluate(func_vm);
+        std::vector<Value> args = {data_obj};
+        Value result = vm_call(*func_vm, func, args);
+        report_callback_error(result);
     };
 
     s->set_open_handler(on_open_func);
@@ -1100,7 +978,7 @@ extern "C" Value _server_on_message(std::vector<Value> &args)
         return error_object("Function 'on_message' expects argument 'server' to be an object");
     }
 
-    if (func.get_function()->arity != 1)
+    if (func.get_function()->proto->arity != 1)
     {
         return error_object("Function 'on_message' expects argument 'function' to be a Function with 1 parameter");
     }
@@ -1119,40 +997,19 @@ extern "C" Value _server_on_message(std::vector<Value> &args)
 
     server *s = (server *)_server->values["server_ptr"].get_pointer()->value;
 
-    auto on_message_func = [s, func](websocketpp::connection_hdl hdl, message_ptr msg)
+    auto on_message_func = [s, func, func_vm = std::make_shared<VM>()](websocketpp::connection_hdl hdl, message_ptr msg)
     {
         connection_data &data = m_servers[s][hdl];
 
-        VM func_vm;
-        std::shared_ptr<FunctionObj> main = std::make_shared<FunctionObj>();
-        main->name = "";
-        main->arity = 0;
-        main->chunk = Chunk();
-        CallFrame main_frame;
-        main_frame.function = main;
-        main_frame.sp = 0;
-        main_frame.ip = main->chunk.code.data();
-        main_frame.frame_start = 0;
-        func_vm.frames.push_back(main_frame);
-
         Value payload = object_val();
         payload.get_object()->keys = {"id", "name", "data"};
         payload.get_object()->values["id"] = number_val(data.sessionId);
         payload.get_object()->values["name"] = string_val(data.name);
         payload.get_object()->values["data"] = string_val(msg->get_payload());
 
-        add_constant(main->chunk, func);
-        add_constant(main->chunk, payload);
-        add_opcode(main->chunk, OP_LOAD_CONST, 1, 0);
-        add_opcode(main->chunk, OP_LOAD_CONST, 0, 0);
-        add_opcode(main->chunk, OP_CALL, 1, 0);
-
-        add_code(main->chunk, OP_EXIT, 0);
-
-        auto offsets = instruction_offsets(main_frame.function->chunk);
-        main_frame.function->instruction_offsets = offsets;
-
-        evaluate(func_vm);
+        std::vector<Value> args = {payload};
+        Value result = vm_call(*func_vm, func, args);
+        report_callback_error(result);
     };
 
     s->set_message_handler(on_message_func);
@@ -1182,7 +1039,7 @@ extern "C" Value _server_on_fail(std::vector<Value> &args)
         return error_object("Function 'on_fail' expects argument 'function' to be a Function");
     }
 
-    if (func.get_function()->arity != 1)
+    if (func.get_function()->proto->arity != 1)
     {
         return error_object("Function 'on_fail' expects argument 'function' to be a Function with 1 parameter");
     }
@@ -1201,7 +1058,7 @@ extern "C" Value _server_on_fail(std::vector<Value> &args)
 
     server *s = (server *)_server->values["server_ptr"].get_pointer()->value;
 
-    auto on_fail_func = [s, func](websocketpp::connection_hdl hdl)
+    auto on_fail_func = [s, func, func_vm = std::make_shared<VM>()](websocketpp::connection_hdl hdl)
     {
         connection_data &data = m_servers[s][hdl];
 
@@ -1212,30 +1069,9 @@ extern "C" Value _server_on_fail(std::vector<Value> &args)
 
         m_servers[s].erase(hdl);
 
-        VM func_vm;
-        std::shared_ptr<FunctionObj> main = std::make_shared<FunctionObj>();
-        main->name = "";
-        main->arity = 0;
-        main->chunk = Chunk();
-        CallFrame main_frame;
-        main_frame.function = main;
-        main_frame.sp = 0;
-        main_frame.ip = main->chunk.code.data();
-        main_frame.frame_start = 0;
-        func_vm.frames.push_back(main_frame);
-
-        add_constant(main->chunk, func);
-        add_constant(main->chunk, data_obj);
-        add_opcode(main->chunk, OP_LOAD_CONST, 1, 0);
-        add_opcode(main->chunk, OP_LOAD_CONST, 0, 0);
-        add_opcode(main->chunk, OP_CALL, 1, 0);
-
-        add_code(main->chunk, OP_EXIT, 0);
-
-        auto offsets = instruction_offsets(main_frame.function->chunk);
-        main_frame.function->instruction_offsets = offsets;
-
-        evaluate(func_vm);
+        std::vector<Value> args = {data_obj};
+        Value result = vm_call(*func_vm, func, args);
+        report_callback_error(result);
     };
 
     s->set_fail_handler(on_fail_func);
@@ -1265,7 +1101,7 @@ extern "C" Value _server_on_close(std::vector<Value> &args)
         return error_object("Function 'on_close' expects argument 'function' to be a Function");
     }
 
-    if (func.get_function()->arity != 1)
+    if (func.get_function()->proto->arity != 1)
     {
         return error_object("Function 'on_close' expects argument 'function' to be a Function with 1 parameter");
     }
@@ -1284,7 +1120,7 @@ extern "C" Value _server_on_close(std::vector<Value> &args)
 
     server *s = (server *)_server->values["server_ptr"].get_pointer()->value;
 
-    auto on_close_func = [s, func](websocketpp::connection_hdl hdl)
+    auto on_close_func = [s, func, func_vm = std::make_shared<VM>()](websocketpp::connection_hdl hdl)
     {
         connection_data &data = m_servers[s][hdl];
 
@@ -1298,30 +1134,9 @@ extern "C" Value _server_on_close(std::vector<Value> &args)
 
         m_servers[s].erase(hdl);
 
-        VM func_vm;
-        std::shared_ptr<FunctionObj> main = std::make_shared<FunctionObj>();
-        main->name = "";
-        main->arity = 0;
-        main->chunk = Chunk();
-        CallFrame main_frame;
-        main_frame.function = main;
-        main_frame.sp = 0;
-        main_frame.ip = main->chunk.code.data();
-        main_frame.frame_start = 0;
-        func_vm.frames.push_back(main_frame);
-
-        add_constant(main->chunk, func);
-        add_constant(main->chunk, data_obj);
-        add_opcode(main->chunk, OP_LOAD_CONST, 1, 0);
-        add_opcode(main->chunk, OP_LOAD_CONST, 0, 0);
-        add_opcode(main->chunk, OP_CALL, 1, 0);
-
-        add_code(main->chunk, OP_EXIT, 0);
-
-        auto offsets = instruction_offsets(main_frame.function->chunk);
-        main_frame.function->instruction_offsets = offsets;
-
-        evaluate(func_vm);
+        std::vector<Value> args = {data_obj};
+        Value result = vm_call(*func_vm, func, args);
+        report_callback_error(result);
     };
 
     s->set_close_handler(on_close_func);